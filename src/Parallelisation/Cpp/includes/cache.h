@@ -0,0 +1,200 @@
+// Content-addressed result cache for run_slim: SLiM is deterministic for a given script, parameters and seed, so a run
+// that has been done before can pass on its stored outputs instead of running again
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "parse.h"
+#include "sweep.h"
+
+// The cache is a directory with one subdirectory of outputs per run, named by the run's key, and an index of
+// key,bytes,last used rows. Entries are only added whole (written under a temporary name, then renamed), and the least
+// recently used are evicted once the cache grows past its size limit. Several run_slim processes can share a cache:
+// the index is only changed under a lock on index.lock
+class ResultCache {
+public:
+    ResultCache(const string &dir, uint64_t maxBytes, const string &script, const string &slim)
+        : _dir(dir), _maxBytes(maxBytes) {
+        std::filesystem::create_directories(_dir);
+        std::ifstream in(script, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Can't read " + script + " to key the result cache");
+        string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        _scriptHash = Hash128().add(contents).add(slim);
+    }
+
+    // The key for a run: a hash of the script, SLiM, every -d definition and the seed. A saved burn-in is keyed by its
+    // contents rather than where it is, so the same burn-in hits the cache wherever a sweep keeps it
+    string key(const vector<string> &comboArgs, const string &seed) const {
+        Hash128 h = _scriptHash;
+        for (const string &arg : comboArgs) {
+            if (arg.rfind("burninFile=", 0) == 0) {
+                string file = arg.substr(arg.find('=') + 1);
+                if (file.size() > 1 && file.front() == '\'')
+                    file = file.substr(1, file.size() - 2);
+                std::ifstream in(file, std::ios::binary);
+                h.add("burninFile=").add(string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()));
+            }
+            else {
+                h.add(arg);
+            }
+        }
+        return h.add("-s").add(seed).hex();
+    }
+
+    // On a hit, add the stored outputs to those in the working directory and mark the entry as used.
+    // The index stays locked throughout, so the entry can't be evicted while it's read
+    bool fetch(const string &key) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        fs::path entry = _dir / key;
+        if (!fs::is_directory(entry, ec))
+            return false;
+        Lock lock(_dir / "index.lock");
+        if (!fs::is_directory(entry, ec))
+            return false;
+        vector<fs::path> files;
+        uint64_t bytes = 0;
+        for (const fs::directory_entry &file : fs::directory_iterator(entry, ec)) {
+            files.push_back(file.path());
+            bytes += file.file_size(ec);
+        }
+        appendOutputs(files);
+        std::ofstream(_dir / "index.csv", std::ios::app) << key << "," << bytes << "," << now() << "\n";
+        return true;
+    }
+
+    // Keep a finished run's outputs (every file in dir), then evict entries until the cache fits its size. The cache
+    // is only an optimisation, so a run that can't be stored (e.g. the cache is full or read-only) is left out with a
+    // warning
+    void store(const string &key, const std::filesystem::path &dir) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        fs::path entry = _dir / key;
+        fs::path part = _dir / (key + ".part" + std::to_string(getpid()));
+        fs::remove_all(part, ec);
+        fs::create_directories(part, ec);
+        uint64_t bytes = 0;
+        if (!ec) {
+            for (const fs::directory_entry &file : fs::directory_iterator(dir, ec)) {
+                std::error_code skip;
+                if (!file.is_regular_file(skip))
+                    continue;
+                if (!fs::copy_file(file.path(), part / file.path().filename(), ec))
+                    break;
+                bytes += file.file_size(skip);
+            }
+        }
+        if (ec) {
+            std::cerr << "Couldn't store a run in the result cache " << _dir << ": " << ec.message() << std::endl;
+            fs::remove_all(part, ec);
+            return;
+        }
+        fs::rename(part, entry, ec);
+        if (ec) {
+            // Another process stored the same run first
+            fs::remove_all(part, ec);
+            return;
+        }
+
+        Lock lock(_dir / "index.lock");
+        std::ofstream(_dir / "index.csv", std::ios::app) << key << "," << bytes << "," << now() << "\n";
+        evict();
+    }
+
+private:
+    // 128-bit FNV-1a: stable across builds and machines, unlike std::hash, and wide enough that collisions between
+    // runs aren't a concern. Fields are terminated so ("ab", "c") and ("a", "bc") hash differently
+    struct Hash128 {
+        unsigned __int128 h = (unsigned __int128)0x6c62272e07bb0142ULL << 64 | 0x62b821756295c58dULL;
+
+        Hash128 &add(const string &field) {
+            const unsigned __int128 prime = (unsigned __int128)1 << 88 | 0x13b;
+            for (unsigned char c : field) {
+                h ^= c;
+                h *= prime;
+            }
+            h ^= 0xff;
+            h *= prime;
+            return *this;
+        }
+
+        string hex() const {
+            char buf[33];
+            std::snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)(h >> 64), (unsigned long long)h);
+            return buf;
+        }
+    };
+
+    // An exclusive lock on a file, for as long as it's in scope
+    struct Lock {
+        int fd;
+        explicit Lock(const std::filesystem::path &file) : fd(::open(file.c_str(), O_CREAT | O_RDWR, 0644)) {
+            if (fd >= 0)
+                flock(fd, LOCK_EX);
+        }
+        ~Lock() {
+            if (fd >= 0)
+                ::close(fd);
+        }
+    };
+
+    static long long now() {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // With the index locked: read it (later rows for a key replace earlier ones), drop the least recently used entries
+    // until the rest fit, and write it back compacted
+    void evict() {
+        namespace fs = std::filesystem;
+        struct Entry { uint64_t bytes; long long used; };
+        std::map<string, Entry> entries;
+        {
+            std::ifstream in(_dir / "index.csv");
+            string line;
+            while (std::getline(in, line)) {
+                vector<string> fields = splitLine(line.c_str());
+                if (fields.size() == 3)
+                    entries[fields[0]] = {std::stoull(fields[1]), std::stoll(fields[2])};
+            }
+        }
+
+        uint64_t total = 0;
+        vector<std::pair<long long, string>> byAge;
+        for (const auto &e : entries) {
+            total += e.second.bytes;
+            byAge.emplace_back(e.second.used, e.first);
+        }
+        std::sort(byAge.begin(), byAge.end());
+        std::error_code ec;
+        for (size_t i = 0; i < byAge.size() && total > _maxBytes; ++i) {
+            fs::remove_all(_dir / byAge[i].second, ec);
+            total -= entries[byAge[i].second].bytes;
+            entries.erase(byAge[i].second);
+        }
+
+        fs::path tmp = _dir / ("index.csv.part" + std::to_string(getpid()));
+        {
+            std::ofstream out(tmp);
+            for (const auto &e : entries)
+                out << e.first << "," << e.second.bytes << "," << e.second.used << "\n";
+        }
+        fs::rename(tmp, _dir / "index.csv", ec);
+    }
+
+    std::filesystem::path _dir;
+    uint64_t _maxBytes;
+    Hash128 _scriptHash;
+};
@@ -0,0 +1,277 @@
+// Checkpoint/restart for run_slim: each run works in a node-local directory of its own, and its checkpoints are copied
+// to shared storage in the background, so a run cut short by the walltime carries on from its last checkpoint next time
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "sweep.h"
+
+// The SLiM script's side is in Chp5-1_1T.slim: given checkpointEvery and checkpointFile, every so often it writes
+// checkpointFile_GEN.pop, then checkpointFile itself, which holds GEN, the sim values and how many lines each output
+// had. If checkpointFile exists when it starts, it resumes from it, cutting the outputs back to those lengths.
+//
+// A run's shared directory holds its latest complete checkpoint, and its outputs as of then or later. Outputs only grow
+// between checkpoints, so after the first copy only what's been added to them is sent. Once the run finishes, the
+// directory holds a copy of its outputs and a done marker instead, so a relaunch can pass on the outputs of runs that
+// finished without running them again
+class Checkpoints {
+public:
+    Checkpoints(const string &sharedDir, const string &localDir, long every)
+        : _shared(sharedDir), _local(localDir), _every(every) {
+        std::filesystem::create_directories(_shared);
+        std::filesystem::create_directories(_local);
+        _copier = std::thread([this]() { copyLoop(); });
+    }
+
+    ~Checkpoints() {
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _copier.join();
+    }
+
+    // Run SLiM with checkpoints, resuming from the run's shared checkpoint if it has one.
+    // Once it's done, its outputs are appended to those in the working directory, and kept in outputsDir(key).
+    // key names the run, e.g. combo_seed. Returns whether it finished. A run whose files can't be copied counts as
+    // not finished, and its last checkpoint is kept for the next attempt
+    bool run(const vector<string> &comboArgs, const string &key, const string &seed, const string &script,
+             const string &slim) {
+        namespace fs = std::filesystem;
+        const fs::path shared = _shared / key;
+        const fs::path local = _local / key;
+        std::error_code ec;
+
+        if (fs::exists(shared / "done", ec)) {
+            appendOutputs(outputs(shared / "outputs"));
+            return true;
+        }
+
+        fs::remove_all(local, ec);
+        fs::create_directories(local, ec);
+        if (ec) {
+            failed(key, "can't make " + local.string(), ec);
+            return false;
+        }
+        // The checkpoint being resumed from is already in shared storage. Its outputs are copied whole the first time
+        // round, as the resumed run cuts them back before writing more
+        Copied resumed;
+        if (fs::exists(shared / STATE, ec)) {
+            for (const fs::directory_entry &entry : fs::directory_iterator(shared, ec))
+                if (entry.is_regular_file(ec) && entry.path().extension() != ".part"
+                    && !fs::copy_file(entry.path(), local / entry.path().filename(), ec))
+                    break;
+            if (ec) {
+                failed(key, "can't copy its checkpoint from " + shared.string(), ec);
+                fs::remove_all(local, ec);
+                return false;
+            }
+            std::ifstream state(shared / STATE);
+            std::getline(state, resumed.gen);
+        }
+
+        vector<string> args = comboArgs;
+        args.emplace_back("-d");
+        args.emplace_back("checkpointEvery=" + std::to_string(_every));
+        args.emplace_back("-d");
+        args.emplace_back("checkpointFile='" + (local / STATE).string() + "'");
+
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            _copied[key] = resumed;
+            _active.insert(key);
+        }
+        bool finished = runSLiM(args, seed, script, slim, local.string());
+        {
+            // Wait for the copier to finish with the run before its files go
+            std::unique_lock<std::mutex> lock(_m);
+            _cv.wait(lock, [&]() { return _copying != key; });
+            _active.erase(key);
+            _copied.erase(key);
+        }
+
+        if (!finished) {
+            std::cerr << "Run " << key << " didn't finish, its last checkpoint is kept in " << shared << std::endl;
+            fs::remove_all(local, ec);
+            return false;
+        }
+
+        // Keep the outputs where a relaunch can find them, then drop the checkpoint
+        fs::create_directories(shared / "outputs", ec);
+        for (const fs::path &file : outputs(local))
+            if (ec || !fs::copy_file(file, shared / "outputs" / file.filename(), fs::copy_options::overwrite_existing, ec))
+                break;
+        if (!ec && !std::ofstream(shared / "done"))
+            ec = std::make_error_code(std::errc::io_error);
+        if (ec) {
+            failed(key, "can't keep its outputs in " + (shared / "outputs").string(), ec);
+            fs::remove_all(local, ec);
+            return false;
+        }
+        for (const fs::directory_entry &entry : fs::directory_iterator(shared, ec))
+            if (entry.is_regular_file(ec) && entry.path().filename() != "done")
+                fs::remove(entry.path(), ec);
+
+        appendOutputs(outputs(local));
+        fs::remove_all(local, ec);
+        return true;
+    }
+
+    std::filesystem::path outputsDir(const string &key) const { return _shared / key / "outputs"; }
+
+private:
+    static constexpr const char *STATE = "checkpoint";
+
+    static void failed(const string &key, const string &what, const std::error_code &ec) {
+        std::cerr << "Run " << key << " failed, " << what << ": " << ec.message() << std::endl;
+    }
+
+    // A run's outputs: every file in its directory that isn't part of a checkpoint
+    static vector<std::filesystem::path> outputs(const std::filesystem::path &dir) {
+        vector<std::filesystem::path> files;
+        std::error_code ec;
+        for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(dir, ec))
+            if (entry.is_regular_file(ec) && entry.path().filename().string().rfind(STATE, 0) != 0)
+                files.push_back(entry.path());
+        return files;
+    }
+
+    // Copy a file so it only appears under its name once it's whole
+    static bool copyWhole(const std::filesystem::path &from, const std::filesystem::path &to) {
+        std::error_code ec;
+        std::filesystem::path part = to.string() + ".part";
+        std::filesystem::copy_file(from, part, std::filesystem::copy_options::overwrite_existing, ec);
+        if (!ec)
+            std::filesystem::rename(part, to, ec);
+        return !ec;
+    }
+
+    // What the copier has sent to shared storage for a run in this attempt: the generation of its latest checkpoint,
+    // and how many bytes of each output
+    struct Copied {
+        string gen;
+        std::map<string, uintmax_t> sizes;
+    };
+
+    // Bring an output in shared storage up to date. Only the bytes added since the last copy are appended, unless the
+    // shared copy isn't the one made in this attempt, in which case it's copied whole. Records the size sent
+    static bool syncOutput(const std::filesystem::path &from, const std::filesystem::path &to, Copied &copied) {
+        std::error_code ec;
+        const string name = from.filename().string();
+        auto sent = copied.sizes.find(name);
+        uintmax_t shared = std::filesystem::file_size(to, ec);
+        if (ec || sent == copied.sizes.end() || sent->second != shared) {
+            if (!copyWhole(from, to))
+                return false;
+            copied.sizes[name] = std::filesystem::file_size(to, ec);
+            return !ec;
+        }
+
+        if (std::filesystem::file_size(from, ec) == shared && !ec)
+            return true;
+        std::ifstream in(from, std::ios::binary);
+        if (!in.seekg(shared))
+            return false;
+        std::ofstream out(to, std::ios::binary | std::ios::app);
+        out << in.rdbuf();
+        out.close();
+        uintmax_t size = std::filesystem::file_size(to, ec);
+        if (!out || ec)
+            return false;
+        sent->second = size;
+        return true;
+    }
+
+    // Copy a run's latest checkpoint to shared storage if it hasn't been already: its files and the outputs first,
+    // then the state file that points to them, then clear out the checkpoint before. The state written is the one read
+    // at the start, not the file as it is by the end, which may point to a checkpoint SLiM wrote during the copy. If
+    // SLiM has moved on and removed the files mid-copy, this is left for the next round. Returns whether a checkpoint
+    // was copied
+    bool syncRun(const string &key, Copied &copied) {
+        namespace fs = std::filesystem;
+        const fs::path local = _local / key;
+        const fs::path shared = _shared / key;
+
+        string text;
+        {
+            std::ifstream state(local / STATE, std::ios::binary);
+            text.assign(std::istreambuf_iterator<char>(state), std::istreambuf_iterator<char>());
+        }
+        const string gen = text.substr(0, text.find('\n'));
+        if (gen.empty() || gen == copied.gen)
+            return false;
+        const string prefix = string(STATE) + "_" + gen + ".";
+
+        fs::create_directories(shared);
+        std::error_code ec;
+        for (const fs::directory_entry &entry : fs::directory_iterator(local, ec))
+            if (entry.path().filename().string().rfind(prefix, 0) == 0 && !copyWhole(entry.path(), shared / entry.path().filename()))
+                return false;
+        for (const fs::path &file : outputs(local))
+            if (!syncOutput(file, shared / file.filename(), copied))
+                return false;
+        {
+            std::ofstream part(shared / (string(STATE) + ".part"), std::ios::binary | std::ios::trunc);
+            part << text;
+            part.close();
+            if (!part)
+                return false;
+        }
+        fs::rename(shared / (string(STATE) + ".part"), shared / STATE, ec);
+        if (ec)
+            return false;
+        for (const fs::directory_entry &entry : fs::directory_iterator(shared, ec)) {
+            string name = entry.path().filename().string();
+            if (name.rfind(STATE, 0) == 0 && name != STATE && name.rfind(prefix, 0) != 0)
+                fs::remove(entry.path(), ec);
+        }
+        copied.gen = gen;
+        return true;
+    }
+
+    // Every few seconds, copy new checkpoints from the node to shared storage, one run at a time
+    void copyLoop() {
+        std::unique_lock<std::mutex> lock(_m);
+        while (!_stop) {
+            std::set<string> active = _active;
+            for (const string &key : active) {
+                if (_stop || !_active.count(key))
+                    continue;
+                _copying = key;
+                Copied copied = _copied[key];
+                lock.unlock();
+                bool synced = syncRun(key, copied);
+                lock.lock();
+                if (synced)
+                    _copied[key] = copied;
+                _copying.clear();
+                _cv.notify_all();
+            }
+            _cv.wait_for(lock, std::chrono::seconds(5), [&]() { return _stop; });
+        }
+    }
+
+    std::filesystem::path _shared;
+    std::filesystem::path _local;
+    long _every;
+
+    std::mutex _m;
+    std::condition_variable _cv;
+    std::set<string> _active;               // Runs going now
+    std::map<string, Copied> _copied;       // What's been copied for each run
+    string _copying;                        // Run the copier is working on
+    bool _stop = false;
+    std::thread _copier;
+};
@@ -0,0 +1,158 @@
+// Mergeable summary statistics, so SLiM outputs can be summarised in parallel pieces and the pieces combined after
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Count, mean, variance, minimum and maximum of a stream of values. Values are added with Welford's update, which stays
+// accurate when the variance is small relative to the mean, and two summaries are combined with Chan et al.'s formula,
+// so a summary of pieces is the same as a summary of the whole
+struct Moments {
+    uint64_t n = 0;
+    double mean = 0.0;
+    double m2 = 0.0;    // Sum of squared differences from the mean
+    double min = INFINITY;
+    double max = -INFINITY;
+
+    void add(double x) {
+        ++n;
+        double delta = x - mean;
+        mean += delta / n;
+        m2 += delta * (x - mean);
+        min = std::min(min, x);
+        max = std::max(max, x);
+    }
+
+    void merge(const Moments &other) {
+        if (other.n == 0)
+            return;
+        if (n == 0) {
+            *this = other;
+            return;
+        }
+        uint64_t total = n + other.n;
+        double delta = other.mean - mean;
+        mean += delta * other.n / total;
+        m2 += other.m2 + delta * delta * ((double)n * other.n / total);
+        n = total;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    // Sample variance, with n - 1
+    double variance() const { return n > 1 ? m2 / (n - 1) : NAN; }
+    double sd() const { return std::sqrt(variance()); }
+    double se() const { return std::sqrt(variance() / n); }
+};
+
+// A t-digest (Dunning & Ertl): a mergeable sketch of a distribution for estimating its quantiles in bounded memory.
+// Values are clustered into centroids (mean, weight), with clusters kept small near the tails, so extreme quantiles are
+// estimated as well as the median. Each compression keeps about compression / 2 centroids, whatever the number of
+// values, and new values wait in a buffer so they're sorted and merged in batches
+class TDigest {
+public:
+    explicit TDigest(double compression = 100) : _compression(compression) {}
+
+    void add(double x, double weight = 1.0) {
+        _buffer.push_back({x, weight});
+        _min = std::min(_min, x);
+        _max = std::max(_max, x);
+        if (_buffer.size() >= 4 * _compression)
+            compress();
+    }
+
+    void merge(const TDigest &other) {
+        _buffer.insert(_buffer.end(), other._centroids.begin(), other._centroids.end());
+        _buffer.insert(_buffer.end(), other._buffer.begin(), other._buffer.end());
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+        compress();
+    }
+
+    // Merge the buffer into the centroids. A centroid can grow until it spans one unit of the scale function
+    // k(q) = compression / 2pi * asin(2q - 1), which is steep near q = 0 and 1, so centroids there stay small
+    void compress() {
+        if (_buffer.empty())
+            return;
+        _buffer.insert(_buffer.end(), _centroids.begin(), _centroids.end());
+        std::sort(_buffer.begin(), _buffer.end(), [](const Centroid &a, const Centroid &b) { return a.mean < b.mean; });
+        double total = 0.0;
+        for (const Centroid &c : _buffer)
+            total += c.weight;
+
+        _centroids.clear();
+        _centroids.push_back(_buffer[0]);
+        double before = 0.0;    // Weight of the centroids before the last
+        double limit = total * qLimit(0.0);
+        for (size_t i = 1; i < _buffer.size(); ++i) {
+            Centroid &last = _centroids.back();
+            const Centroid &c = _buffer[i];
+            if (before + last.weight + c.weight <= limit) {
+                last.weight += c.weight;
+                last.mean += (c.mean - last.mean) * c.weight / last.weight;
+            }
+            else {
+                before += last.weight;
+                limit = total * qLimit(before / total);
+                _centroids.push_back(c);
+            }
+        }
+        _total = total;
+        _buffer.clear();
+    }
+
+    // Interpolates between centroid centres, and out to the smallest and largest values at either end
+    double quantile(double q) {
+        compress();
+        if (_centroids.empty())
+            return NAN;
+        if (_centroids.size() == 1)
+            return _centroids[0].mean;
+        q = std::min(std::max(q, 0.0), 1.0);
+        const double index = q * _total;
+
+        const Centroid &first = _centroids.front();
+        if (index < first.weight / 2)
+            return _min + (first.mean - _min) * index / (first.weight / 2);
+
+        double cumulative = 0.0;
+        for (size_t i = 0; i + 1 < _centroids.size(); ++i) {
+            const Centroid &a = _centroids[i], &b = _centroids[i + 1];
+            double centreA = cumulative + a.weight / 2;
+            double centreB = cumulative + a.weight + b.weight / 2;
+            if (index < centreB)
+                return a.mean + (b.mean - a.mean) * (index - centreA) / (centreB - centreA);
+            cumulative += a.weight;
+        }
+
+        const Centroid &last = _centroids.back();
+        double fromEnd = _total - index;
+        return _max - (_max - last.mean) * fromEnd / (last.weight / 2);
+    }
+
+    size_t size() const { return _centroids.size(); }
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    // The quantile one unit of k past q
+    double qLimit(double q) const {
+        const double pi = 3.14159265358979323846;
+        double k = _compression / (2 * pi) * std::asin(2 * q - 1) + 1;
+        if (k >= _compression / 4)
+            return 1.0;
+        return (std::sin(2 * pi * k / _compression) + 1) / 2;
+    }
+
+    double _compression;
+    std::vector<Centroid> _centroids;
+    std::vector<Centroid> _buffer;
+    double _total = 0.0;
+    double _min = INFINITY;
+    double _max = -INFINITY;
+};
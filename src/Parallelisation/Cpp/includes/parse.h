@@ -0,0 +1,67 @@
+// Parsing shared by run_slim and the tools: splitting csv lines and option lists, and reading sizes like 20G
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Split a csv line on commas, stripping any double quotes around fields (e.g. "Low" -> Low), as in combos files
+inline std::vector<std::string> splitLine(const char *line) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (const char *c = line; *c; ++c) {
+        if (*c == '"')
+            quoted = !quoted;
+        else if (*c == ',' && !quoted)
+            fields.emplace_back();
+        else if (*c != ' ' || quoted)
+            fields.back() += *c;
+    }
+    return fields;
+}
+
+// Split a line of SLiM output on commas in place, without copying: SLiM doesn't quote its fields. Stops at the end
+// of the line or a \r
+inline void splitFields(const char *line, std::vector<std::string_view> &fields) {
+    fields.clear();
+    const char *start = line;
+    for (const char *c = line; ; ++c) {
+        if (*c == ',' || *c == '\0' || *c == '\r') {
+            fields.emplace_back(start, c - start);
+            if (*c != ',')
+                break;
+            start = c + 1;
+        }
+    }
+}
+
+// Split an option's comma delimited list (e.g. -p "Ne,rec"), leaving out empty items
+inline std::vector<std::string> splitList(const std::string &list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+// Parse a size like 500M or 20G into bytes
+inline uint64_t parseSize(const std::string &size) {
+    size_t end = 0;
+    double value = std::stod(size, &end);
+    std::string unit = size.substr(end);
+    const std::string units = "KMGT";
+    uint64_t scale = 1;
+    if (!unit.empty()) {
+        size_t u = units.find(std::toupper(unit[0]));
+        if (u == std::string::npos)
+            throw std::invalid_argument("Can't read the size " + size);
+        scale = uint64_t(1) << (10 * (u + 1));
+    }
+    return value * scale;
+}
@@ -0,0 +1,121 @@
+// Replicate statistics for run_slim's sequential mode: how precisely each combo's summary is known from the seeds run
+// so far, read back from the SLiM output file as runs finish
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "sweep.h"
+
+// Two-sided 95% t quantiles for 1 to 30 degrees of freedom; past 30, the normal quantile is close enough
+inline double tQuantile95(size_t df) {
+    static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df == 0)
+        return INFINITY;
+    return df <= 30 ? t[df - 1] : 1.960;
+}
+
+// A combo's estimate: its mean over seeds and the full width of its 95% confidence interval
+struct Estimate {
+    size_t n = 0;
+    double mean = NAN;
+    double width = INFINITY;
+};
+
+// Reads a headerless SLiM output (generation, seed, modelindex, ...) as it grows: each update() only reads the lines
+// appended since the last, so checking a combo doesn't mean rereading the whole file. A seed's value is the one at
+// generation gen, or at the latest generation it has written when gen is NaN
+class ReplicateResults {
+public:
+    ReplicateResults(const string &filename, size_t yCol, double gen = NAN) : _filename(filename), _yCol(yCol), _gen(gen) {}
+
+    void update() {
+        std::ifstream in(_filename, std::ios::binary);
+        if (!in)
+            return;
+        in.seekg(0, std::ios::end);
+        std::streamoff size = in.tellg();
+        if (size <= _offset)
+            return;
+        string buffer(size - _offset, '\0');
+        in.seekg(_offset);
+        in.read(&buffer[0], buffer.size());
+
+        // Only whole lines: SLiM may be halfway through writing the last one
+        size_t start = 0;
+        for (size_t end; (end = buffer.find('\n', start)) != string::npos; start = end + 1) {
+            buffer[end] = '\0';
+            addLine(&buffer[start]);
+        }
+        _offset += start;
+    }
+
+    // Over the seeds that reached the combo's latest generation, so runs that died early don't skew it
+    Estimate estimate(long modelindex) const {
+        Estimate e;
+        auto it = _values.find(modelindex);
+        if (it == _values.end())
+            return e;
+        double last = -INFINITY;
+        for (const auto &seed : it->second)
+            last = std::max(last, seed.second.first);
+
+        // Welford's algorithm, for a variance that stays accurate when it's small relative to the mean
+        double mean = 0.0, m2 = 0.0;
+        for (const auto &seed : it->second) {
+            if (seed.second.first != last)
+                continue;
+            double delta = seed.second.second - mean;
+            mean += delta / ++e.n;
+            m2 += delta * (seed.second.second - mean);
+        }
+        e.mean = mean;
+        if (e.n > 1)
+            e.width = 2.0 * tQuantile95(e.n - 1) * std::sqrt(m2 / (e.n - 1) / e.n);
+        return e;
+    }
+
+private:
+    // Pull the 1-based column col out of a line without splitting the whole line
+    static const char *column(const char *line, size_t col) {
+        for (size_t c = 1; c < col && line; ++c) {
+            line = std::strchr(line, ',');
+            if (line)
+                ++line;
+        }
+        return line;
+    }
+
+    static bool number(const char *field, double &value) {
+        if (!field)
+            return false;
+        const char *end = field + std::strcspn(field, ",\r");
+        auto res = std::from_chars(field, end, value);
+        return res.ec == std::errc() && res.ptr == end;
+    }
+
+    void addLine(const char *line) {
+        double generation, model, y;
+        const char *seed = column(line, 2);
+        if (!number(line, generation) || !number(column(line, 3), model) || !number(column(line, _yCol), y))
+            return;     // Headers, blank lines and short rows from other phases of the model
+        if (!std::isnan(_gen) && generation != _gen)
+            return;
+        std::pair<double, double> &value = _values[long(model)][string(seed, std::strcspn(seed, ","))];
+        if (generation >= value.first)
+            value = {generation, y};
+    }
+
+    string _filename;
+    size_t _yCol;
+    double _gen;
+    std::streamoff _offset = 0;
+    std::unordered_map<long, std::map<string, std::pair<double, double>>> _values;  // modelindex -> seed -> (generation, value)
+};
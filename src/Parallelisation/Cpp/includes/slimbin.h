@@ -0,0 +1,380 @@
+// Compact binary table format for seeds and parameter combos
+//
+// Layout (all integers little-endian):
+//   FileHeader      64 bytes: magic, version, column count, row count, record size, data offset
+//   ColumnDesc[n]   48 bytes each: name, offset within a record, width in bytes, type
+//   records         nrows fixed-width records, starting at data_offset
+//
+// Records are fixed width so row i lives at data_offset + i * record_size, which lets a
+// reader mmap the file and pull any seed or combo out directly without parsing text.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/mman.h>
+#include "slimformat.h"
+
+namespace slimbin {
+
+    const char MAGIC[8] = {'S', 'L', 'I', 'M', 'B', 'I', 'N', '\0'};
+    const uint32_t VERSION = 1;
+    const size_t NAME_LEN = 36;
+
+    enum ColType : uint8_t {
+        U32 = 1,
+        U64 = 2,
+        I64 = 3,
+        F64 = 4,
+        STR = 5     // Fixed width, zero padded
+    };
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t ncols;
+        uint64_t nrows;
+        uint32_t record_size;
+        uint32_t data_offset;
+        char reserved[32];
+    };
+    static_assert(sizeof(FileHeader) == 64, "FileHeader must be 64 bytes");
+
+    struct ColumnDesc {
+        char name[NAME_LEN];
+        uint32_t offset;
+        uint32_t width;
+        uint8_t type;
+        char reserved[3];
+    };
+    static_assert(sizeof(ColumnDesc) == 48, "ColumnDesc must be 48 bytes");
+
+    struct Column {
+        std::string name;
+        ColType type;
+        uint32_t width = 0;     // Only used for STR columns, numeric widths come from the type
+        uint32_t offset = 0;
+    };
+
+    inline uint32_t typeWidth(ColType type, uint32_t strWidth) {
+        switch (type) {
+            case U32: return 4;
+            case U64: case I64: case F64: return 8;
+            case STR: return strWidth;
+        }
+        throw std::runtime_error("slimbin: unknown column type");
+    }
+
+    // Check the first bytes of a file for the magic string, so callers can accept either CSV or binary input
+    inline bool isBinary(const std::string &filename) {
+        char magic[8] = {0};
+        FILE *f = std::fopen(filename.c_str(), "rb");
+        if (!f)
+            return false;
+        size_t got = std::fread(magic, 1, sizeof(magic), f);
+        std::fclose(f);
+        return got == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(magic)) == 0;
+    }
+
+    // Streams fixed-width records to disk, then patches the row count into the header on close().
+    // With append set, records are added to the end of an existing table with the same columns.
+    // Every write is checked, so a full disk is an error rather than a table with the wrong rows in it
+    class Writer {
+    public:
+        Writer(const std::string &filename, std::vector<Column> columns, bool append = false)
+            : _filename(filename), _columns(std::move(columns)) {
+            uint32_t offset = 0;
+            for (Column &col : _columns) {
+                if (col.name.size() >= NAME_LEN)
+                    throw std::runtime_error("slimbin: column name too long: " + col.name);
+                col.width = typeWidth(col.type, col.width);
+                col.offset = offset;
+                offset += col.width;
+            }
+            _recordSize = (offset + 7) & ~7u; // Keep records 8 byte aligned
+            _record.assign(_recordSize, 0);
+
+            if (append && isBinary(filename)) {
+                openAppend(filename);
+                return;
+            }
+
+            _file = std::fopen(filename.c_str(), "wb");
+            if (!_file)
+                throw std::runtime_error("slimbin: can't open " + filename + " for writing");
+
+            FileHeader header = {};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.ncols = _columns.size();
+            header.record_size = _recordSize;
+            header.data_offset = (sizeof(FileHeader) + _columns.size() * sizeof(ColumnDesc) + 7) & ~size_t(7);
+            write(&header, sizeof(header));
+
+            for (const Column &col : _columns) {
+                ColumnDesc desc = {};
+                std::memcpy(desc.name, col.name.data(), col.name.size());
+                desc.offset = col.offset;
+                desc.width = col.width;
+                desc.type = col.type;
+                write(&desc, sizeof(desc));
+            }
+            static const char pad[8] = {0};
+            long written = sizeof(FileHeader) + _columns.size() * sizeof(ColumnDesc);
+            write(pad, header.data_offset - written);
+        }
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        // Errors can only be reported by calling close() before the writer goes
+        ~Writer() {
+            try {
+                close();
+            }
+            catch (const std::exception &) {
+            }
+        }
+
+        void set(size_t col, uint64_t value) {
+            const Column &c = _columns[col];
+            if (c.type == U32) {
+                uint32_t v = value;
+                std::memcpy(&_record[c.offset], &v, 4);
+            }
+            else if (c.type == F64) {
+                set(col, double(value));
+            }
+            else {
+                std::memcpy(&_record[c.offset], &value, 8);
+            }
+        }
+
+        void set(size_t col, int64_t value) {
+            if (_columns[col].type == F64)
+                set(col, double(value));
+            else
+                set(col, uint64_t(value));
+        }
+
+        void set(size_t col, double value) {
+            std::memcpy(&_record[_columns[col].offset], &value, 8);
+        }
+
+        void set(size_t col, std::string_view value) {
+            const Column &c = _columns[col];
+            if (value.size() > c.width)
+                throw std::runtime_error("slimbin: value '" + std::string(value) + "' is wider than column " + c.name);
+            std::memset(&_record[c.offset], 0, c.width);
+            std::memcpy(&_record[c.offset], value.data(), value.size());
+        }
+
+        void endRow() {
+            write(_record.data(), _recordSize);
+            std::fill(_record.begin(), _record.end(), 0);
+            ++_nrows;
+        }
+
+        void close() {
+            if (!_file)
+                return;
+            // nrows lives at byte 16 of the header
+            if (std::fseek(_file, offsetof(FileHeader, nrows), SEEK_SET) != 0)
+                fail();
+            write(&_nrows, sizeof(_nrows));
+            FILE *file = _file;
+            _file = nullptr;
+            if (std::fclose(file) != 0)
+                throw std::runtime_error("slimbin: failed writing " + _filename);
+        }
+
+    private:
+        // Check an existing table has the same layout as ours, then position at its end
+        void openAppend(const std::string &filename) {
+            _file = std::fopen(filename.c_str(), "r+b");
+            if (!_file)
+                throw std::runtime_error("slimbin: can't open " + filename + " for appending");
+
+            FileHeader header;
+            bool same = std::fread(&header, sizeof(header), 1, _file) == 1
+                && header.version == VERSION && header.ncols == _columns.size() && header.record_size == _recordSize;
+            for (size_t i = 0; same && i < _columns.size(); ++i) {
+                ColumnDesc desc;
+                same = std::fread(&desc, sizeof(desc), 1, _file) == 1
+                    && _columns[i].name == std::string(desc.name, strnlen(desc.name, NAME_LEN))
+                    && desc.type == _columns[i].type && desc.width == _columns[i].width;
+            }
+            if (!same) {
+                std::fclose(_file);
+                _file = nullptr;
+                throw std::runtime_error("slimbin: can't append to " + filename + ", its columns don't match");
+            }
+
+            _nrows = header.nrows;
+            if (std::fseek(_file, header.data_offset + _nrows * _recordSize, SEEK_SET) != 0)
+                fail();
+        }
+
+        void write(const void *data, size_t size) {
+            if (std::fwrite(data, 1, size, _file) != size)
+                fail();
+        }
+
+        // Close the file and give up on it
+        [[noreturn]] void fail() {
+            std::fclose(_file);
+            _file = nullptr;
+            throw std::runtime_error("slimbin: failed writing " + _filename);
+        }
+
+        std::string _filename;
+        std::vector<Column> _columns;
+        std::vector<char> _record;
+        uint32_t _recordSize = 0;
+        uint64_t _nrows = 0;
+        FILE *_file = nullptr;
+    };
+
+    // Read-only view of a binary table: the file is mmapped and values are read straight out of the mapping
+    class Reader {
+    public:
+        explicit Reader(const std::string &filename) : _map(filename, "slimbin") {
+            if (_map.size() < sizeof(FileHeader))
+                throw std::runtime_error("slimbin: " + filename + " is too small to be a binary table");
+            _base = _map.data();
+
+            std::memcpy(&_header, _base, sizeof(FileHeader));
+            if (std::memcmp(_header.magic, MAGIC, sizeof(MAGIC)) != 0 || _header.version != VERSION)
+                throw std::runtime_error("slimbin: " + filename + " is not a version " + std::to_string(VERSION) + " binary table");
+            if (_header.data_offset + _header.nrows * _header.record_size > _map.size())
+                throw std::runtime_error("slimbin: " + filename + " is truncated");
+
+            for (uint32_t i = 0; i < _header.ncols; ++i) {
+                ColumnDesc desc;
+                std::memcpy(&desc, _base + sizeof(FileHeader) + i * sizeof(ColumnDesc), sizeof(desc));
+                Column col;
+                col.name = std::string(desc.name, strnlen(desc.name, NAME_LEN));
+                col.type = ColType(desc.type);
+                col.width = desc.width;
+                col.offset = desc.offset;
+                _columns.emplace_back(col);
+            }
+            _data = _base + _header.data_offset;
+            _map.advise(MADV_SEQUENTIAL);
+        }
+
+        size_t rows() const { return _header.nrows; }
+        size_t cols() const { return _columns.size(); }
+        const Column &column(size_t col) const { return _columns[col]; }
+
+        // Index of a named column, or -1 if it doesn't exist
+        int find(const std::string &name) const {
+            for (size_t i = 0; i < _columns.size(); ++i)
+                if (_columns[i].name == name)
+                    return i;
+            return -1;
+        }
+
+        const char *record(size_t row) const { return _data + row * _header.record_size; }
+
+        uint64_t getU64(size_t row, size_t col) const {
+            const Column &c = _columns[col];
+            if (c.type == U32) {
+                uint32_t v;
+                std::memcpy(&v, record(row) + c.offset, 4);
+                return v;
+            }
+            uint64_t v;
+            std::memcpy(&v, record(row) + c.offset, 8);
+            return v;
+        }
+
+        double getF64(size_t row, size_t col) const {
+            const Column &c = _columns[col];
+            if (c.type == F64) {
+                double v;
+                std::memcpy(&v, record(row) + c.offset, 8);
+                return v;
+            }
+            if (c.type == I64)
+                return double(int64_t(getU64(row, col)));
+            return double(getU64(row, col));
+        }
+
+        std::string_view getStr(size_t row, size_t col) const {
+            const Column &c = _columns[col];
+            const char *p = record(row) + c.offset;
+            return std::string_view(p, strnlen(p, c.width));
+        }
+
+        // Write the value as text into buf (at least 32 bytes for numeric columns), returns the length. Doubles are
+        // written as they usually are in a .csv: always with a point or an exponent, so SLiM reads a whole one like 1.0
+        // as a float rather than an integer, and with a short exponent (1e-8 rather than 1e-08)
+        size_t format(size_t row, size_t col, char *buf, size_t len) const {
+            const Column &c = _columns[col];
+            std::to_chars_result res;
+            switch (c.type) {
+                case U32:
+                case U64:
+                    res = std::to_chars(buf, buf + len, getU64(row, col));
+                    break;
+                case I64:
+                    res = std::to_chars(buf, buf + len, int64_t(getU64(row, col)));
+                    break;
+                case F64: {
+                    double v = getF64(row, col);
+                    res = std::to_chars(buf, buf + len, v);
+                    if (res.ec != std::errc() || !std::isfinite(v))
+                        break;
+                    char *e = static_cast<char *>(std::memchr(buf, 'e', res.ptr - buf));
+                    if (e) {
+                        char *digits = e + 1;
+                        if (*digits == '-')
+                            ++digits;
+                        char *from = digits;
+                        while (*from == '+' || (*from == '0' && from + 1 < res.ptr))
+                            ++from;
+                        std::memmove(digits, from, res.ptr - from);
+                        res.ptr -= from - digits;
+                    }
+                    else if (!std::memchr(buf, '.', res.ptr - buf) && res.ptr + 2 <= buf + len) {
+                        std::memcpy(res.ptr, ".0", 2);
+                        res.ptr += 2;
+                    }
+                    break;
+                }
+                case STR: {
+                    std::string_view s = getStr(row, col);
+                    size_t n = std::min(s.size(), len);
+                    std::memcpy(buf, s.data(), n);
+                    return n;
+                }
+                default:
+                    return 0;
+            }
+            return res.ptr - buf;
+        }
+
+        std::string toString(size_t row, size_t col) const {
+            if (_columns[col].type == STR)
+                return std::string(getStr(row, col));
+            char buf[32];
+            return std::string(buf, format(row, col, buf, sizeof(buf)));
+        }
+
+    private:
+        slimformat::MappedFile _map;
+        const char *_base = nullptr;
+        const char *_data = nullptr;
+        FileHeader _header;
+        std::vector<Column> _columns;
+    };
+}
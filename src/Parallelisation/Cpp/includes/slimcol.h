@@ -0,0 +1,461 @@
+// Columnar binary format for SLiM outputs, so analyses can read the columns they need without reparsing text
+//
+// Layout (all integers little-endian):
+//   FileHeader        64 bytes: magic, version, column count, row count, chunk count, rows per chunk, directory offset
+//   blocks            one block per column per chunk of rows, each 8 byte aligned
+//   ColumnDesc[n]     48 bytes each, at directory offset: name
+//   ChunkDesc[c][n]   40 bytes each, chunk by chunk: block offset and size, rows, encoding, minimum and maximum
+//
+// Each block picks its own encoding from the values in it: whole numbers are stored plainly or as zigzag varint
+// deltas from the previous value, whichever is smaller (generation and position barely change from row to row, so
+// their deltas take a byte or two), other numbers as doubles with NA as NaN, and anything else as a dictionary of the
+// distinct strings plus one narrow code per row. The minimum and maximum of each numeric block let a reader skip
+// chunks that can't match a range without touching them.
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "slimformat.h"
+
+namespace slimcol {
+
+    const char MAGIC[8] = {'S', 'L', 'I', 'M', 'C', 'O', 'L', '\0'};
+    const uint32_t VERSION = 1;
+    const size_t NAME_LEN = 40;
+
+    enum Encoding : uint8_t {
+        I64_PLAIN = 1,
+        I64_DELTA = 2,  // Zigzag varint deltas
+        F64_PLAIN = 3,  // NA as NaN
+        DICT = 4        // Distinct strings, then a 1, 2 or 4 byte code per row
+    };
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t ncols;
+        uint64_t nrows;
+        uint64_t nchunks;
+        uint32_t chunk_rows;
+        uint32_t reserved0;
+        uint64_t dir_offset;    // 0 until the writer is closed
+        char reserved[16];
+    };
+    static_assert(sizeof(FileHeader) == 64, "FileHeader must be 64 bytes");
+
+    struct ColumnDesc {
+        char name[NAME_LEN];
+        char reserved[8];
+    };
+    static_assert(sizeof(ColumnDesc) == 48, "ColumnDesc must be 48 bytes");
+
+    struct ChunkDesc {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t rows;
+        uint8_t encoding;
+        char reserved[3];
+        double min;             // Over the numbers in the block; NaN if there are none or it's a dictionary
+        double max;
+    };
+    static_assert(sizeof(ChunkDesc) == 40, "ChunkDesc must be 40 bytes");
+
+    // Check the first bytes of a file for the magic string, so callers can accept either CSV or columnar input
+    inline bool isColumnar(const std::string &filename) {
+        char magic[8] = {0};
+        FILE *f = std::fopen(filename.c_str(), "rb");
+        if (!f)
+            return false;
+        size_t got = std::fread(magic, 1, sizeof(magic), f);
+        std::fclose(f);
+        return got == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(magic)) == 0;
+    }
+
+    inline bool isNA(std::string_view value) {
+        return value.empty() || value == "NA" || value == "NaN" || value == "nan";
+    }
+
+    using slimformat::putVarint;
+    using slimformat::getVarint;
+    using slimformat::zigzag;
+    using slimformat::unzigzag;
+
+    // One column's values for one chunk, as text, until the chunk is encoded
+    struct ColumnBuffer {
+        std::string text;
+        std::vector<uint32_t> ends;
+
+        size_t size() const { return ends.size(); }
+        std::string_view operator[](size_t i) const {
+            size_t begin = i ? ends[i - 1] : 0;
+            return std::string_view(text.data() + begin, ends[i] - begin);
+        }
+        void clear() {
+            text.clear();
+            ends.clear();
+        }
+    };
+
+    // Encode a chunk of one column in the narrowest encoding that holds every value
+    inline std::string encode(const ColumnBuffer &values, ChunkDesc &desc) {
+        const size_t n = values.size();
+        std::string block;
+        desc.rows = n;
+        desc.min = NAN;
+        desc.max = NAN;
+
+        std::vector<int64_t> ints(n);
+        bool isInt = true;
+        for (size_t i = 0; i < n && isInt; ++i) {
+            std::string_view v = values[i];
+            auto res = std::from_chars(v.data(), v.data() + v.size(), ints[i]);
+            isInt = res.ec == std::errc() && res.ptr == v.data() + v.size();
+        }
+        if (isInt) {
+            int64_t prev = 0;
+            for (int64_t v : ints) {
+                putVarint(block, zigzag(int64_t(uint64_t(v) - uint64_t(prev))));
+                prev = v;
+            }
+            if (block.size() < n * 8) {
+                desc.encoding = I64_DELTA;
+            }
+            else {
+                desc.encoding = I64_PLAIN;
+                block.assign(reinterpret_cast<const char *>(ints.data()), n * 8);
+            }
+            if (n > 0) {
+                auto mm = std::minmax_element(ints.begin(), ints.end());
+                desc.min = *mm.first;
+                desc.max = *mm.second;
+            }
+            return block;
+        }
+
+        std::vector<double> doubles(n);
+        bool isFloat = true;
+        for (size_t i = 0; i < n && isFloat; ++i) {
+            std::string_view v = values[i];
+            if (isNA(v)) {
+                doubles[i] = NAN;
+                continue;
+            }
+            auto res = std::from_chars(v.data(), v.data() + v.size(), doubles[i]);
+            isFloat = res.ec == std::errc() && res.ptr == v.data() + v.size();
+        }
+        if (isFloat) {
+            desc.encoding = F64_PLAIN;
+            block.assign(reinterpret_cast<const char *>(doubles.data()), n * 8);
+            for (double v : doubles) {
+                if (std::isnan(v))
+                    continue;
+                desc.min = std::isnan(desc.min) ? v : std::min(desc.min, v);
+                desc.max = std::isnan(desc.max) ? v : std::max(desc.max, v);
+            }
+            return block;
+        }
+
+        desc.encoding = DICT;
+        std::unordered_map<std::string_view, uint32_t> codes;
+        std::vector<std::string_view> dict;
+        std::vector<uint32_t> rowCodes(n);
+        for (size_t i = 0; i < n; ++i) {
+            auto it = codes.emplace(values[i], dict.size());
+            if (it.second)
+                dict.push_back(values[i]);
+            rowCodes[i] = it.first->second;
+        }
+        uint32_t count = dict.size();
+        block.append(reinterpret_cast<const char *>(&count), 4);
+        for (std::string_view s : dict) {
+            putVarint(block, s.size());
+            block.append(s.data(), s.size());
+        }
+        unsigned char width = count <= 0x100 ? 1 : count <= 0x10000 ? 2 : 4;
+        block += char(width);
+        for (uint32_t code : rowCodes)
+            block.append(reinterpret_cast<const char *>(&code), width);
+        return block;
+    }
+
+    // Streams rows into chunks, encoding each chunk's columns in parallel as it fills, then writes the directory and
+    // patches the header on close(). The file is written under a temporary name (filename.tmp) and only replaces
+    // filename once close() has finished it
+    class Writer {
+    public:
+        Writer(const std::string &filename, std::vector<std::string> names, uint32_t chunkRows = 65536)
+            : _filename(filename), _names(std::move(names)), _chunkRows(chunkRows), _buffers(_names.size()) {
+            for (const std::string &name : _names)
+                if (name.size() >= NAME_LEN)
+                    throw std::runtime_error("slimcol: column name too long: " + name);
+            if (_chunkRows == 0)
+                throw std::runtime_error("slimcol: chunks need at least one row");
+
+            _file = std::fopen((filename + ".tmp").c_str(), "wb");
+            if (!_file)
+                throw std::runtime_error("slimcol: can't open " + filename + ".tmp for writing");
+            FileHeader header = {};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.ncols = _names.size();
+            header.chunk_rows = _chunkRows;
+            std::fwrite(&header, sizeof(header), 1, _file);
+            _offset = sizeof(header);
+        }
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        // Destroyed without close(), e.g. by an exception, the rows so far are thrown away and filename is left as it was
+        ~Writer() {
+            if (_file) {
+                std::fclose(_file);
+                std::remove((_filename + ".tmp").c_str());
+            }
+        }
+
+        void addRow(const std::vector<std::string_view> &fields) {
+            if (fields.size() != _names.size())
+                throw std::runtime_error("slimcol: row " + std::to_string(_nrows + 1) + " has " + std::to_string(fields.size())
+                                         + " columns, expected " + std::to_string(_names.size()));
+            for (size_t c = 0; c < fields.size(); ++c) {
+                _buffers[c].text.append(fields[c].data(), fields[c].size());
+                _buffers[c].ends.push_back(_buffers[c].text.size());
+            }
+            ++_nrows;
+            if (_buffers[0].size() == _chunkRows)
+                flushChunk();
+        }
+
+        size_t rows() const { return _nrows; }
+
+        void close() {
+            if (!_file)
+                return;
+            flushChunk();
+            FileHeader header = {};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.ncols = _names.size();
+            header.nrows = _nrows;
+            header.nchunks = _chunks.size() / std::max<size_t>(_names.size(), 1);
+            header.chunk_rows = _chunkRows;
+            header.dir_offset = _offset;
+            for (const std::string &name : _names) {
+                ColumnDesc desc = {};
+                std::memcpy(desc.name, name.data(), name.size());
+                std::fwrite(&desc, sizeof(desc), 1, _file);
+            }
+            std::fwrite(_chunks.data(), sizeof(ChunkDesc), _chunks.size(), _file);
+            std::fseek(_file, 0, SEEK_SET);
+            std::fwrite(&header, sizeof(header), 1, _file);
+            bool failed = std::ferror(_file);
+            failed = std::fclose(_file) != 0 || failed;
+            _file = nullptr;
+            const std::string tmp = _filename + ".tmp";
+            if (failed || std::rename(tmp.c_str(), _filename.c_str()) != 0) {
+                std::remove(tmp.c_str());
+                throw std::runtime_error("slimcol: failed writing " + _filename);
+            }
+        }
+
+    private:
+        void flushChunk() {
+            if (_names.empty() || _buffers[0].size() == 0)
+                return;
+            const size_t ncols = _names.size();
+            std::vector<std::string> blocks(ncols);
+            std::vector<ChunkDesc> descs(ncols, ChunkDesc{});
+            #pragma omp parallel for schedule(dynamic)
+            for (size_t c = 0; c < ncols; ++c)
+                blocks[c] = encode(_buffers[c], descs[c]);
+
+            static const char pad[8] = {0};
+            for (size_t c = 0; c < ncols; ++c) {
+                descs[c].offset = _offset;
+                descs[c].size = blocks[c].size();
+                std::fwrite(blocks[c].data(), 1, blocks[c].size(), _file);
+                size_t padding = (8 - blocks[c].size() % 8) % 8;
+                std::fwrite(pad, 1, padding, _file);
+                _offset += blocks[c].size() + padding;
+                _chunks.push_back(descs[c]);
+                _buffers[c].clear();
+            }
+        }
+
+        std::string _filename;
+        std::vector<std::string> _names;
+        uint32_t _chunkRows;
+        std::vector<ColumnBuffer> _buffers;
+        std::vector<ChunkDesc> _chunks;
+        uint64_t _nrows = 0;
+        uint64_t _offset = 0;
+        FILE *_file = nullptr;
+    };
+
+    // One column of one chunk, decoded. Dictionary strings point into the reader's mapping
+    struct Chunk {
+        Encoding encoding = I64_PLAIN;
+        size_t rows = 0;
+        std::vector<int64_t> ints;
+        std::vector<double> doubles;
+        std::vector<std::string_view> dict;
+        std::vector<uint32_t> codes;
+
+        bool numeric() const { return encoding != DICT; }
+
+        // NaN for NA and for dictionary strings
+        double number(size_t i) const {
+            switch (encoding) {
+                case I64_PLAIN: case I64_DELTA: return double(ints[i]);
+                case F64_PLAIN: return doubles[i];
+                default: return NAN;
+            }
+        }
+
+        // Append the value as text to out. NaN is written as NA, as SLiM does
+        void format(size_t i, std::string &out) const {
+            char buf[32];
+            std::to_chars_result res;
+            switch (encoding) {
+                case I64_PLAIN: case I64_DELTA:
+                    res = std::to_chars(buf, buf + sizeof(buf), ints[i]);
+                    break;
+                case F64_PLAIN:
+                    if (std::isnan(doubles[i])) {
+                        out += "NA";
+                        return;
+                    }
+                    res = std::to_chars(buf, buf + sizeof(buf), doubles[i]);
+                    break;
+                default: {
+                    std::string_view s = dict[codes[i]];
+                    out.append(s.data(), s.size());
+                    return;
+                }
+            }
+            out.append(buf, res.ptr - buf);
+        }
+    };
+
+    // Read-only view of a columnar file: the file is mmapped, and only the blocks of the columns and chunks asked for
+    // are decoded
+    class Reader {
+    public:
+        explicit Reader(const std::string &filename) : _map(filename, "slimcol") {
+            if (_map.size() < sizeof(FileHeader))
+                throw std::runtime_error("slimcol: " + filename + " is too small to be a columnar file");
+            _base = _map.data();
+
+            std::memcpy(&_header, _base, sizeof(FileHeader));
+            if (std::memcmp(_header.magic, MAGIC, sizeof(MAGIC)) != 0 || _header.version != VERSION)
+                throw std::runtime_error("slimcol: " + filename + " is not a version " + std::to_string(VERSION) + " columnar file");
+            size_t dirSize = _header.ncols * sizeof(ColumnDesc) + _header.nchunks * _header.ncols * sizeof(ChunkDesc);
+            if (_header.dir_offset == 0 || _header.dir_offset + dirSize > _map.size())
+                throw std::runtime_error("slimcol: " + filename + " is truncated");
+
+            const char *dir = _base + _header.dir_offset;
+            for (uint32_t i = 0; i < _header.ncols; ++i) {
+                ColumnDesc desc;
+                std::memcpy(&desc, dir + i * sizeof(ColumnDesc), sizeof(desc));
+                _names.emplace_back(desc.name, strnlen(desc.name, NAME_LEN));
+            }
+            _chunks.resize(_header.nchunks * _header.ncols);
+            std::memcpy(_chunks.data(), dir + _header.ncols * sizeof(ColumnDesc), _chunks.size() * sizeof(ChunkDesc));
+            for (const ChunkDesc &desc : _chunks) {
+                if (desc.offset + desc.size > _header.dir_offset)
+                    throw std::runtime_error("slimcol: " + filename + " has a block past its end");
+                if (desc.encoding < I64_PLAIN || desc.encoding > DICT)
+                    throw std::runtime_error("slimcol: " + filename + " has a block with unknown encoding " + std::to_string(desc.encoding));
+            }
+        }
+
+        size_t rows() const { return _header.nrows; }
+        size_t cols() const { return _names.size(); }
+        size_t chunks() const { return _header.nchunks; }
+        const std::string &name(size_t col) const { return _names[col]; }
+
+        // Index of a named column, or -1 if it doesn't exist
+        int find(const std::string &name) const {
+            for (size_t i = 0; i < _names.size(); ++i)
+                if (_names[i] == name)
+                    return i;
+            return -1;
+        }
+
+        const ChunkDesc &chunk(size_t col, size_t c) const { return _chunks[c * _names.size() + col]; }
+        size_t chunkRows(size_t c) const { return _names.empty() ? 0 : chunk(0, c).rows; }
+        size_t chunkStart(size_t c) const { return c * _header.chunk_rows; }
+
+        // Whether a chunk may have a value of col in [lo, hi]. Dictionary blocks always may; a numeric block may only
+        // if its range overlaps, so a block of only NA never does
+        bool mayContain(size_t col, size_t c, double lo, double hi) const {
+            const ChunkDesc &desc = chunk(col, c);
+            if (desc.encoding == DICT)
+                return true;
+            return !(desc.max < lo || desc.min > hi) && !std::isnan(desc.min);
+        }
+
+        // Decode col of chunk c into out, reusing its storage
+        void read(size_t col, size_t c, Chunk &out) const {
+            const ChunkDesc &desc = chunk(col, c);
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(_base + desc.offset);
+            out.encoding = Encoding(desc.encoding);
+            out.rows = desc.rows;
+            switch (out.encoding) {
+                case I64_PLAIN:
+                    out.ints.resize(desc.rows);
+                    std::memcpy(out.ints.data(), p, desc.rows * 8);
+                    break;
+                case I64_DELTA: {
+                    out.ints.resize(desc.rows);
+                    int64_t prev = 0;
+                    for (uint32_t i = 0; i < desc.rows; ++i) {
+                        prev = int64_t(uint64_t(prev) + uint64_t(unzigzag(getVarint(p))));
+                        out.ints[i] = prev;
+                    }
+                    break;
+                }
+                case F64_PLAIN:
+                    out.doubles.resize(desc.rows);
+                    std::memcpy(out.doubles.data(), p, desc.rows * 8);
+                    break;
+                case DICT: {
+                    uint32_t count;
+                    std::memcpy(&count, p, 4);
+                    p += 4;
+                    out.dict.resize(count);
+                    for (uint32_t i = 0; i < count; ++i) {
+                        size_t len = getVarint(p);
+                        out.dict[i] = std::string_view(reinterpret_cast<const char *>(p), len);
+                        p += len;
+                    }
+                    unsigned char width = *p++;
+                    out.codes.assign(desc.rows, 0);
+                    for (uint32_t i = 0; i < desc.rows; ++i, p += width)
+                        std::memcpy(&out.codes[i], p, width);
+                    break;
+                }
+                default:
+                    throw std::runtime_error("slimcol: unknown encoding " + std::to_string(desc.encoding));
+            }
+        }
+
+    private:
+        slimformat::MappedFile _map;
+        const char *_base = nullptr;
+        FileHeader _header;
+        std::vector<std::string> _names;
+        std::vector<ChunkDesc> _chunks;
+    };
+}
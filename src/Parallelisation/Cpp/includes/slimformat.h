@@ -0,0 +1,181 @@
+// Shared by the binary formats of SLiM outputs (slimbin.h, slimcol.h and slimtraj.h) and the tools that read the
+// model's outputs: mapping a file to read it in place, the variable length integer coders, and the columns of each of
+// the model's outputs
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The binary formats are little-endian and are read in place");
+
+namespace slimformat {
+
+    // Read-only memory mapping of a whole file. The mapping is released when the MappedFile goes, so a reader that
+    // finds something wrong with a file can throw from its constructor without leaking it. An empty file isn't mapped
+    // at all, and data() is null
+    class MappedFile {
+    public:
+        // format names the caller in error messages, e.g. "slimbin: can't open FILE"
+        MappedFile(const std::string &filename, const std::string &format) {
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error(format + ": can't open " + filename);
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                ::close(fd);
+                throw std::runtime_error(format + ": can't stat " + filename);
+            }
+            _size = st.st_size;
+            if (_size == 0) {
+                ::close(fd);
+                return;
+            }
+            void *map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (map == MAP_FAILED)
+                throw std::runtime_error(format + ": can't mmap " + filename);
+            _base = static_cast<const char *>(map);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile() {
+            if (_base)
+                munmap(const_cast<char *>(_base), _size);
+        }
+
+        const char *data() const { return _base; }
+        size_t size() const { return _size; }
+
+        void advise(int advice) const {
+            if (_base)
+                madvise(const_cast<char *>(_base), _size, advice);
+        }
+
+    private:
+        const char *_base = nullptr;
+        size_t _size = 0;
+    };
+
+    // LEB128 varints: 7 bits a byte, low bits first
+    inline void putVarint(std::string &out, uint64_t v) {
+        while (v >= 0x80) {
+            out += char(v | 0x80);
+            v >>= 7;
+        }
+        out += char(v);
+    }
+
+    inline uint64_t getVarint(const unsigned char *&p) {
+        uint64_t v = 0;
+        for (int shift = 0; ; shift += 7) {
+            unsigned char b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+    }
+
+    // Zigzag maps small negative numbers to small unsigned ones, so deltas either way fit in a byte or two of varint
+    inline uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+    inline int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+    inline void putDouble(std::string &out, double v) { out.append(reinterpret_cast<const char *>(&v), 8); }
+
+    inline double getDouble(const unsigned char *&p) {
+        double v;
+        std::memcpy(&v, p, 8);
+        p += 8;
+        return v;
+    }
+
+    // Column names of the model's outputs, which have no header. Not every row of an output has the same columns: the
+    // means output writes different ones in each phase of the model, so a preset lists every layout its rows can have
+    struct Preset {
+        std::string name;
+        std::vector<std::vector<std::string>> layouts;
+    };
+
+    const std::vector<Preset> PRESETS = {
+        { "means",      { { "generation", "seed", "modelindex", "meanH", "VA", "phenomean", "dist", "w" },             // End of the burn-in
+                          { "generation", "seed", "modelindex", "meanH", "VA", "phenomean", "dist", "w", "delta" },    // Stabilising period
+                          { "generation", "seed", "modelindex", "meanH", "VA", "phenomean", "dist", "w", "deltaPheno",
+                            "deltaw" },                                                                                 // Test period
+                          { "generation", "seed", "modelindex", "meanH", "VA", "phenomean", "w" },                      // Directional selection
+                          { "generation", "seed", "modelindex", "meanH", "VA", "phenomean" } } },                       // Drift
+        { "burnin",     { { "generation", "seed", "modelindex", "meanH", "VA", "phenomean" } } },
+        { "burnend",    { { "generation", "seed", "modelindex", "meanH" } } },
+        { "opt",        { { "seed", "modelindex", "opt" } } },
+        { "muts",       { { "generation", "seed", "modelindex", "mutType", "id", "position", "originGen", "value", "chi",
+                            "freq", "count", "fixGen" } } }
+    };
+
+    // The preset called name, or with no name, the one whose output filename is named after (e.g. out_slim1T_muts.csv).
+    // Null if there's none
+    inline const Preset *findPreset(const std::string &name, const std::string &filename) {
+        for (const Preset &preset : PRESETS)
+            if (name.empty() ? filename.find("_" + preset.name + ".") != std::string::npos : name == preset.name)
+                return &preset;
+        return nullptr;
+    }
+
+    // Column of a file with rows of several layouts that holds each row's width, so they can be told apart
+    const std::string WIDTH_COLUMN = "ncols";
+
+    // Where the fields of a row go among a file's columns, for each width of row the file can have. Columns a row
+    // doesn't have are NA
+    struct Layout {
+        std::vector<std::string> columns;
+        std::map<size_t, std::vector<size_t>> fields;   // Row width -> the column of each field
+
+        bool mixed() const { return fields.size() > 1; }
+
+        // The widths rows can have, for error messages: "6, 7 or 8"
+        std::string widths() const {
+            std::string list;
+            size_t i = 0;
+            for (const auto &width : fields)
+                list += (i++ == 0 ? "" : i == fields.size() ? " or " : ", ") + std::to_string(width.first);
+            return list;
+        }
+    };
+
+    // A preset's columns are those of all its layouts, in the order they first appear, then the width column if it
+    // has more than one
+    inline Layout presetLayout(const Preset &preset) {
+        Layout layout;
+        for (const std::vector<std::string> &names : preset.layouts) {
+            std::vector<size_t> &cols = layout.fields[names.size()];
+            for (const std::string &name : names) {
+                size_t c = std::find(layout.columns.begin(), layout.columns.end(), name) - layout.columns.begin();
+                if (c == layout.columns.size())
+                    layout.columns.push_back(name);
+                cols.push_back(c);
+            }
+        }
+        if (layout.mixed())
+            layout.columns.push_back(WIDTH_COLUMN);
+        return layout;
+    }
+
+    // Rows of one width, each field in its own column
+    inline Layout plainLayout(std::vector<std::string> columns) {
+        Layout layout;
+        layout.columns = std::move(columns);
+        std::vector<size_t> &cols = layout.fields[layout.columns.size()];
+        for (size_t c = 0; c < layout.columns.size(); ++c)
+            cols.push_back(c);
+        return layout;
+    }
+}
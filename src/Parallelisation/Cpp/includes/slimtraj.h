@@ -0,0 +1,310 @@
+// Compact format for allele frequency trajectories from the model's mutation output
+//
+// The mutation output repeats every mutation's id, position and effect at every sampled generation, when only its
+// frequency has changed. Here each run (seed, modelindex) stores its mutations once, and each sampled generation only
+// the copy counts of the mutations present, as the change from the mutation's last count. A frequency is its count over
+// the number of genomes sampled, so the counts are exact quantised frequencies, and drift means most changes fit in
+// a byte.
+//
+// Layout (all integers little-endian):
+//   FileHeader        64 bytes: magic, version, run count, row count, index offset
+//   run blocks        one per run:
+//                       per mutation: zigzag varint id delta, varint type, zigzag varint position and origin
+//                                     generation, 8 byte effect, varint fixation generation + 1 (0 for NA)
+//                       per snapshot: zigzag varint generation delta, varint genomes, 8 byte chi scale,
+//                                     varint mutations present, then per mutation present:
+//                                     varint index gap, zigzag varint count delta
+//   RunIndex[n]       48 bytes each, at index offset: seed, modelindex, block offset and size, mutation and snapshot
+//                     counts
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "slimformat.h"
+
+namespace slimtraj {
+
+    const char MAGIC[8] = {'S', 'L', 'I', 'M', 'T', 'R', 'J', '\0'};
+    const uint32_t VERSION = 1;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved0;
+        uint64_t nruns;
+        uint64_t nrows;         // Rows of the mutation output this came from
+        uint64_t index_offset;  // 0 until the writer is closed
+        char reserved[24];
+    };
+    static_assert(sizeof(FileHeader) == 64, "FileHeader must be 64 bytes");
+
+    struct RunIndex {
+        int64_t seed;
+        int64_t modelindex;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t nmuts;
+        uint32_t nsnaps;
+        char reserved[8];
+    };
+    static_assert(sizeof(RunIndex) == 48, "RunIndex must be 48 bytes");
+
+    const int64_t NA = INT64_MIN;
+
+    struct Mutation {
+        int64_t id;
+        int64_t type;
+        int64_t position;
+        int64_t originGen;
+        double value;
+        int64_t fixGen = NA;
+    };
+
+    // A sampled generation. The model writes each mutation's chi as its effect times sqrt(1 / (2 * dist)), with dist
+    // that generation's distance from the optimum, so one scale per snapshot gives back every chi
+    struct Snapshot {
+        int64_t generation;
+        uint32_t genomes;
+        double chiScale;
+    };
+
+    // One run's trajectories: counts are mutation by mutation, so each mutation's trajectory is contiguous
+    struct Run {
+        int64_t seed = 0;
+        int64_t modelindex = 0;
+        std::vector<Mutation> mutations;
+        std::vector<Snapshot> snapshots;
+        std::vector<int32_t> counts;    // counts[m * snapshots.size() + s], -1 where the mutation isn't present
+
+        int32_t count(size_t m, size_t s) const { return counts[m * snapshots.size() + s]; }
+        const int32_t *trajectory(size_t m) const { return &counts[m * snapshots.size()]; }
+
+        // NaN where the mutation isn't present
+        double freq(size_t m, size_t s) const {
+            int32_t c = count(m, s);
+            return c < 0 ? NAN : double(c) / snapshots[s].genomes;
+        }
+        double chi(size_t m, size_t s) const { return mutations[m].value * snapshots[s].chiScale; }
+
+        // The fixation generation as the model writes it: only once the mutation has fixed
+        int64_t fixGen(size_t m, size_t s) const {
+            int64_t fixed = mutations[m].fixGen;
+            return fixed != NA && fixed <= snapshots[s].generation ? fixed : NA;
+        }
+
+        size_t rows() const {
+            return counts.size() - std::count(counts.begin(), counts.end(), -1);
+        }
+    };
+
+    using slimformat::putVarint;
+    using slimformat::getVarint;
+    using slimformat::zigzag;
+    using slimformat::unzigzag;
+    using slimformat::putDouble;
+    using slimformat::getDouble;
+
+    inline std::string encode(const Run &run) {
+        std::string block;
+        int64_t prev = 0;
+        for (const Mutation &mut : run.mutations) {
+            putVarint(block, zigzag(mut.id - prev));
+            prev = mut.id;
+            putVarint(block, mut.type);
+            putVarint(block, zigzag(mut.position));
+            putVarint(block, zigzag(mut.originGen));
+            putDouble(block, mut.value);
+            putVarint(block, mut.fixGen == NA ? 0 : uint64_t(mut.fixGen) + 1);
+        }
+
+        const size_t nsnaps = run.snapshots.size();
+        std::vector<int32_t> last(run.mutations.size(), 0);
+        prev = 0;
+        for (size_t s = 0; s < nsnaps; ++s) {
+            const Snapshot &snap = run.snapshots[s];
+            putVarint(block, zigzag(snap.generation - prev));
+            prev = snap.generation;
+            putVarint(block, snap.genomes);
+            putDouble(block, snap.chiScale);
+
+            size_t present = 0;
+            for (size_t m = 0; m < run.mutations.size(); ++m)
+                present += run.counts[m * nsnaps + s] >= 0;
+            putVarint(block, present);
+            int64_t lastM = -1;
+            for (size_t m = 0; m < run.mutations.size(); ++m) {
+                int32_t c = run.counts[m * nsnaps + s];
+                if (c < 0)
+                    continue;
+                putVarint(block, m - lastM);
+                putVarint(block, zigzag(int64_t(c) - last[m]));
+                lastM = m;
+                last[m] = c;
+            }
+        }
+        return block;
+    }
+
+    // Streams run blocks to disk, then writes the index and patches the header on close(). As with slimcol::Writer,
+    // filename is only replaced once close() has finished the file
+    class Writer {
+    public:
+        explicit Writer(const std::string &filename) : _filename(filename) {
+            _file = std::fopen((filename + ".tmp").c_str(), "wb");
+            if (!_file)
+                throw std::runtime_error("slimtraj: can't open " + filename + ".tmp for writing");
+            FileHeader header = {};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            std::fwrite(&header, sizeof(header), 1, _file);
+            _offset = sizeof(header);
+        }
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        ~Writer() {
+            if (_file) {
+                std::fclose(_file);
+                std::remove((_filename + ".tmp").c_str());
+            }
+        }
+
+        void addRun(const Run &run) {
+            if (run.counts.size() != run.mutations.size() * run.snapshots.size())
+                throw std::runtime_error("slimtraj: run has " + std::to_string(run.counts.size()) + " counts, expected "
+                                         + std::to_string(run.mutations.size() * run.snapshots.size()));
+            std::string block = encode(run);
+            RunIndex entry = {};
+            entry.seed = run.seed;
+            entry.modelindex = run.modelindex;
+            entry.offset = _offset;
+            entry.size = block.size();
+            entry.nmuts = run.mutations.size();
+            entry.nsnaps = run.snapshots.size();
+            std::fwrite(block.data(), 1, block.size(), _file);
+            _offset += block.size();
+            _index.push_back(entry);
+            _nrows += run.rows();
+        }
+
+        size_t rows() const { return _nrows; }
+
+        void close() {
+            if (!_file)
+                return;
+            FileHeader header = {};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.nruns = _index.size();
+            header.nrows = _nrows;
+            header.index_offset = _offset;
+            std::fwrite(_index.data(), sizeof(RunIndex), _index.size(), _file);
+            std::fseek(_file, 0, SEEK_SET);
+            std::fwrite(&header, sizeof(header), 1, _file);
+            bool failed = std::ferror(_file);
+            failed = std::fclose(_file) != 0 || failed;
+            _file = nullptr;
+            const std::string tmp = _filename + ".tmp";
+            if (failed || std::rename(tmp.c_str(), _filename.c_str()) != 0) {
+                std::remove(tmp.c_str());
+                throw std::runtime_error("slimtraj: failed writing " + _filename);
+            }
+        }
+
+    private:
+        std::string _filename;
+        std::vector<RunIndex> _index;
+        uint64_t _offset = 0;
+        uint64_t _nrows = 0;
+        FILE *_file = nullptr;
+    };
+
+    // Read-only view of a trajectory file: the file is mmapped, and runs are decoded one at a time
+    class Reader {
+    public:
+        explicit Reader(const std::string &filename) : _map(filename, "slimtraj") {
+            if (_map.size() < sizeof(FileHeader))
+                throw std::runtime_error("slimtraj: " + filename + " is too small to be a trajectory file");
+            _base = _map.data();
+
+            std::memcpy(&_header, _base, sizeof(FileHeader));
+            if (std::memcmp(_header.magic, MAGIC, sizeof(MAGIC)) != 0 || _header.version != VERSION)
+                throw std::runtime_error("slimtraj: " + filename + " is not a version " + std::to_string(VERSION) + " trajectory file");
+            if (_header.index_offset == 0 || _header.index_offset + _header.nruns * sizeof(RunIndex) > _map.size())
+                throw std::runtime_error("slimtraj: " + filename + " is truncated");
+            _index.resize(_header.nruns);
+            std::memcpy(_index.data(), _base + _header.index_offset, _index.size() * sizeof(RunIndex));
+            for (const RunIndex &entry : _index)
+                if (entry.offset + entry.size > _header.index_offset)
+                    throw std::runtime_error("slimtraj: " + filename + " has a run past its end");
+        }
+
+        size_t runs() const { return _index.size(); }
+        size_t rows() const { return _header.nrows; }
+        const RunIndex &run(size_t i) const { return _index[i]; }
+
+        // Index of a run, or -1 if it isn't in the file
+        long find(int64_t modelindex, int64_t seed) const {
+            for (size_t i = 0; i < _index.size(); ++i)
+                if (_index[i].modelindex == modelindex && _index[i].seed == seed)
+                    return i;
+            return -1;
+        }
+
+        // Decode run i into out, reusing its storage
+        void read(size_t i, Run &out) const {
+            const RunIndex &entry = _index[i];
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(_base + entry.offset);
+            out.seed = entry.seed;
+            out.modelindex = entry.modelindex;
+            out.mutations.resize(entry.nmuts);
+            out.snapshots.resize(entry.nsnaps);
+            out.counts.assign(size_t(entry.nmuts) * entry.nsnaps, -1);
+
+            int64_t prev = 0;
+            for (Mutation &mut : out.mutations) {
+                mut.id = prev + unzigzag(getVarint(p));
+                prev = mut.id;
+                mut.type = getVarint(p);
+                mut.position = unzigzag(getVarint(p));
+                mut.originGen = unzigzag(getVarint(p));
+                mut.value = getDouble(p);
+                uint64_t fixed = getVarint(p);
+                mut.fixGen = fixed == 0 ? NA : int64_t(fixed - 1);
+            }
+
+            std::vector<int32_t> last(entry.nmuts, 0);
+            prev = 0;
+            for (uint32_t s = 0; s < entry.nsnaps; ++s) {
+                Snapshot &snap = out.snapshots[s];
+                snap.generation = prev + unzigzag(getVarint(p));
+                prev = snap.generation;
+                snap.genomes = getVarint(p);
+                snap.chiScale = getDouble(p);
+                uint64_t present = getVarint(p);
+                size_t m = size_t(-1);
+                for (uint64_t k = 0; k < present; ++k) {
+                    m += getVarint(p);
+                    if (m >= entry.nmuts)
+                        throw std::runtime_error("slimtraj: run " + std::to_string(i) + " is corrupt");
+                    last[m] += int32_t(unzigzag(getVarint(p)));
+                    out.counts[m * entry.nsnaps + s] = last[m];
+                }
+            }
+        }
+
+    private:
+        slimformat::MappedFile _map;
+        const char *_base = nullptr;
+        FileHeader _header;
+        std::vector<RunIndex> _index;
+    };
+}
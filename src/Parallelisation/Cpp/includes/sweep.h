@@ -0,0 +1,286 @@
+// Seeds, combos and SLiM launching shared by run_slim and mpi_run_slim
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "csv.h"
+#include "slimbin.h"
+#include "parse.h"
+
+using std::vector; using std::string;
+
+extern char **environ;
+
+
+inline bool isNumber(const string &value) {
+    char *end = nullptr;
+    std::strtod(value.c_str(), &end);
+    return !value.empty() && *end == '\0';
+}
+
+// Seeds and combos to run: each can be a .csv or a binary table (see includes/slimbin.h).
+// Binary tables are mmapped and their values are formatted when a job launches, so there's no parsing at startup
+struct Sweep {
+    vector<string> csvSeeds;
+    vector<string> comboNames;
+    vector<bool> comboQuoted;           // Columns that hold strings, which need quoting for SLiM
+    vector<vector<string>> csvCombos;
+    std::unique_ptr<slimbin::Reader> binSeeds;
+    std::unique_ptr<slimbin::Reader> binCombos;
+
+    size_t nSeeds() const { return binSeeds ? binSeeds->rows() : csvSeeds.size(); }
+    size_t nCombos() const { return binCombos ? binCombos->rows() : csvCombos.size(); }
+
+    string seed(size_t i) const {
+        return binSeeds ? binSeeds->toString(i, 0) : csvSeeds[i];
+    }
+
+    vector<bool> comboUsed;             // Columns to pass to SLiM (all of them unless -p picks some)
+
+    // The modelindex a combo's runs are passed, and write in their outputs: the combos' own modelindex column if they
+    // have one, or else the combo's 1-based row number
+    string modelIndex(size_t j) const {
+        for (size_t c = 0; c < comboNames.size(); ++c)
+            if (comboNames[c] == "modelindex")
+                return binCombos ? binCombos->toString(j, c) : csvCombos[j][c];
+        return std::to_string(j + 1);
+    }
+
+    // The -d definitions for a single combo: every column becomes a SLiM constant of the same name, and modelIndex() is
+    // passed as modelindex, so outputs can be traced to their row.
+    // Strings are wrapped in single quotes so SLiM reads them as string literals
+    vector<string> comboArgs(size_t j) const {
+        vector<string> args;
+        bool hasIndex = false;
+        for (size_t c = 0; c < comboNames.size(); ++c) {
+            const string &name = comboNames[c];
+            if (!comboUsed[c])
+                continue;
+            hasIndex = hasIndex || name == "modelindex";
+            string value;
+            if (binCombos)
+                value = comboQuoted[c] ? string(binCombos->getStr(j, c)) : binCombos->toString(j, c);
+            else
+                value = csvCombos[j][c];
+            args.emplace_back("-d");
+            args.emplace_back(comboQuoted[c] ? name + "='" + value + "'" : name + "=" + value);
+        }
+        if (!hasIndex) {
+            args.emplace_back("-d");
+            args.emplace_back("modelindex=" + modelIndex(j));
+        }
+        return args;
+    }
+};
+
+inline void loadSeeds(Sweep &sweep, const string &filename) {
+    if (slimbin::isBinary(filename)) {
+        sweep.binSeeds = std::make_unique<slimbin::Reader>(filename);
+        return;
+    }
+    io::CSVReader<1> seeds(filename);
+    seeds.read_header(io::ignore_extra_column, "Seed");
+    int64_t curSeed;
+    // For each row in the file, fill variables with that row's values
+    while (seeds.read_row(curSeed)) {
+        sweep.csvSeeds.emplace_back(std::to_string(curSeed)); // Stick it into a vector of all seeds
+    }
+}
+
+// (Re)load the combos, replacing any already loaded
+inline void loadCombos(Sweep &sweep, const string &filename) {
+    sweep.comboNames.clear();
+    sweep.comboQuoted.clear();
+    sweep.comboUsed.clear();
+    sweep.csvCombos.clear();
+    sweep.binCombos.reset();
+
+    if (slimbin::isBinary(filename)) {
+        sweep.binCombos = std::make_unique<slimbin::Reader>(filename);
+        for (size_t c = 0; c < sweep.binCombos->cols(); ++c) {
+            sweep.comboNames.emplace_back(sweep.binCombos->column(c).name);
+            sweep.comboQuoted.push_back(sweep.binCombos->column(c).type == slimbin::STR);
+        }
+        sweep.comboUsed.assign(sweep.comboNames.size(), true);
+        return;
+    }
+
+    // Any number of columns, named by the header: a column is quoted as a string if any of its values isn't a number
+    io::LineReader combos(filename);
+    char *line = combos.next_line();
+    if (!line)
+        throw std::runtime_error(filename + " is empty");
+    sweep.comboNames = splitLine(line);
+    sweep.comboQuoted.assign(sweep.comboNames.size(), false);
+    sweep.comboUsed.assign(sweep.comboNames.size(), true);
+
+    while ((line = combos.next_line())) {
+        if (!*line)
+            continue;
+        vector<string> row = splitLine(line);
+        if (row.size() != sweep.comboNames.size())
+            throw std::runtime_error(filename + ":" + std::to_string(combos.get_file_line()) + " has the wrong number of columns");
+        for (size_t c = 0; c < row.size(); ++c)
+            if (!isNumber(row[c]))
+                sweep.comboQuoted[c] = true;
+        sweep.csvCombos.emplace_back(std::move(row));
+    }
+}
+
+// Only pass the listed columns (delimited by commas) to SLiM
+inline void selectColumns(Sweep &sweep, const string &list) {
+    vector<string> names = splitLine(list.c_str());
+    for (size_t c = 0; c < sweep.comboNames.size(); ++c)
+        sweep.comboUsed[c] = std::find(names.begin(), names.end(), sweep.comboNames[c]) != names.end();
+    for (const string &name : names)
+        if (std::find(sweep.comboNames.begin(), sweep.comboNames.end(), name) == sweep.comboNames.end())
+            throw std::runtime_error("No combos column named " + name);
+}
+
+// Runs for one task of a packed job: the (combo, seed) rows of a slimrungen manifest (task,combo,seed, 1-based).
+// If the manifest has an index (MANIFEST.idx, from slimrungen), only the task's own rows are read
+inline vector<std::pair<long, long>> loadManifest(const string &filename, long task, const Sweep &sweep) {
+    vector<std::pair<long, long>> runs;
+    auto addRun = [&](long combo, long seed) {
+        if (combo < 1 || combo > (long)sweep.nCombos() || seed < 1 || seed > (long)sweep.nSeeds())
+            throw std::runtime_error(filename + " refers to a combo or seed that isn't in the sweep");
+        runs.emplace_back(combo - 1, seed - 1);
+    };
+
+    const string indexFile = filename + ".idx";
+    if (slimbin::isBinary(indexFile)) {
+        slimbin::Reader index(indexFile);
+        if (task < 1 || task > (long)index.rows())
+            return runs;
+        if ((long)index.getU64(task - 1, 0) != task)
+            throw std::runtime_error(indexFile + " is out of order");
+
+        FILE *file = std::fopen(filename.c_str(), "rb");
+        if (!file || std::fseek(file, index.getU64(task - 1, 1), SEEK_SET) != 0) {
+            if (file)
+                std::fclose(file);
+            throw std::runtime_error("Can't read " + filename);
+        }
+        io::LineReader rows(filename, file);
+        for (uint64_t r = index.getU64(task - 1, 2); r > 0; --r) {
+            char *line = rows.next_line();
+            long t = 0, combo = 0, seed = 0;
+            if (!line || std::sscanf(line, "%ld,%ld,%ld", &t, &combo, &seed) != 3 || t != task)
+                throw std::runtime_error(indexFile + " doesn't match " + filename);
+            addRun(combo, seed);
+        }
+        return runs;
+    }
+
+    io::CSVReader<3> manifest(filename);
+    manifest.read_header(io::ignore_extra_column, "task", "combo", "seed");
+    long t, combo, seed;
+    while (manifest.read_row(t, combo, seed)) {
+        if (t == task)
+            addRun(combo, seed);
+    }
+    return runs;
+}
+
+// Two-stage sweeps (slimrungen -D): combos that only differ in their selection parameters branch from the same burn-in.
+// The plan is a .csv of combo,burnin rows (both 1-based), and this returns the 0-based burn-in of every combo
+inline vector<long> loadBurninPlan(const string &filename, const Sweep &sweep) {
+    io::CSVReader<2> plan(filename);
+    plan.read_header(io::ignore_extra_column, "combo", "burnin");
+    vector<long> burnins(sweep.nCombos(), -1);
+    long combo, burnin;
+    while (plan.read_row(combo, burnin)) {
+        if (combo < 1 || combo > (long)sweep.nCombos() || burnin < 1)
+            throw std::runtime_error(filename + " refers to a combo that isn't in the sweep");
+        burnins[combo - 1] = burnin - 1;
+    }
+    if (std::find(burnins.begin(), burnins.end(), -1) != burnins.end())
+        throw std::runtime_error(filename + " doesn't have a burn-in for every combo");
+    return burnins;
+}
+
+// Where the population at the end of a burn-in is saved, for one seed
+inline string burninFile(const string &dir, long burnin, const string &seed) {
+    return dir + "/burnin" + std::to_string(burnin + 1) + "_" + seed + ".txt";
+}
+
+// A burn-in only run: the parameters of one of the combos that branch from it, numbered by the burn-in rather than the
+// combo (so its burn-in output rows can be told apart), saving its population to file
+inline vector<string> burninArgs(const Sweep &sweep, size_t combo, long burnin, const string &file) {
+    vector<string> args = sweep.comboArgs(combo);
+    for (size_t a = 1; a < args.size(); a += 2) {
+        if (args[a].rfind("modelindex=", 0) == 0) {
+            args.erase(args.begin() + a - 1, args.begin() + a + 1);
+            break;
+        }
+    }
+    vector<string> extra = {"-d", "modelindex=" + std::to_string(burnin + 1), "-d", "burninOnly=T",
+                                  "-d", "burninFile='" + file + "'"};
+    args.insert(args.end(), extra.begin(), extra.end());
+    return args;
+}
+
+// Expand a leading ~ the way the shell would, since SLiM is started directly rather than through one
+inline string expandHome(const string &path) {
+    const char *home = std::getenv("HOME");
+    if (home && (path == "~" || path.rfind("~/", 0) == 0))
+        return home + path.substr(1);
+    return path;
+}
+
+// Runs that work in a directory of their own (for checkpoints or the result cache) add their outputs to those in
+// the working directory when they finish, one run at a time
+inline void appendOutputs(const vector<std::filesystem::path> &files) {
+    static std::mutex m;
+    std::lock_guard<std::mutex> lock(m);
+    for (const std::filesystem::path &file : files) {
+        std::ifstream in(file, std::ios::binary);
+        std::ofstream out(file.filename(), std::ios::binary | std::ios::app);
+        out << in.rdbuf();
+    }
+}
+
+// Feed in a single combo and a single seed at a time: the parallelised for loop will do this.
+// SLiM is spawned directly with its arguments, so there's no shell to start or quoting to get through for every run.
+// Runs in dir if one is given. Returns whether SLiM finished successfully
+inline bool runSLiM(const vector<string> &comboArgs, const string &seed, const string &script, const string &slim,
+                    const string &dir = "") {
+    vector<string> args = {slim, "-s", seed};
+    args.insert(args.end(), comboArgs.begin(), comboArgs.end());
+    args.push_back(script);
+
+    vector<char*> argv;
+    for (string &arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (!dir.empty())
+        posix_spawn_file_actions_addchdir_np(&actions, dir.c_str());
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, slim.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0) {
+        std::cerr << "Couldn't start " << slim << ": " << std::strerror(err) << std::endl;
+        return false;
+    }
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
@@ -0,0 +1,2 @@
+#!/bin/bash
+mpicxx -std=c++17 -fopenmp -pthread -o mpi_run_slim mpi_run_slim.cpp
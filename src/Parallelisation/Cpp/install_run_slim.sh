@@ -1,2 +1,2 @@
 #!/bin/bash
-g++ -fopenmp -o run_slim run_slim.cpp
+g++ -std=c++17 -fopenmp -pthread -o run_slim run_slim.cpp
@@ -0,0 +1,320 @@
+#include "includes/sweep.h" // Seeds, combos and launching SLiM, shared with run_slim
+#include <mpi.h>
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <getopt.h>
+#include "omp.h"
+
+#define THREAD_NUM 4 // Runs per node
+
+#define TAG_REQUEST 1
+#define TAG_WORK 2
+
+
+// Every run of the sweep has an index: seeds by combos in the same order run_slim goes through them,
+// or the rows of one task of a manifest
+struct RunList {
+    const Sweep &sweep;
+    vector<std::pair<long, long>> manifest;     // (combo, seed), when running from a manifest
+
+    long size() const { return manifest.empty() ? sweep.nSeeds() * sweep.nCombos() : manifest.size(); }
+    long combo(long r) const { return manifest.empty() ? r % sweep.nCombos() : manifest[r].first; }
+    long seed(long r) const { return manifest.empty() ? r / sweep.nCombos() : manifest[r].second; }
+};
+
+// Runs waiting on a node, and the threads that work through them
+struct LocalQueue {
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<long> runs;
+    int idle = 0;
+    bool noMore = false;
+};
+
+// A thread of the node's process pool: takes runs from the local queue until it's empty and there are no more to come
+void workLoop(LocalQueue &local, const RunList &list, const string &script, const string &slim) {
+    std::unique_lock<std::mutex> lock(local.m);
+    while (true) {
+        if (!local.runs.empty()) {
+            long r = local.runs.front();
+            local.runs.pop_front();
+            lock.unlock();
+            runSLiM(list.sweep.comboArgs(list.combo(r)), list.sweep.seed(list.seed(r)), script, slim);
+            lock.lock();
+        }
+        else if (local.noMore) {
+            return;
+        }
+        else {
+            ++local.idle;
+            local.cv.notify_all();
+            local.cv.wait(lock);
+            --local.idle;
+        }
+    }
+}
+
+// Rank 0 hands out runs from a single counter. Other ranks ask for more whenever they have idle threads, and chunks
+// shrink as the sweep runs down, so nodes finish close together however long each run takes.
+// Rank 0's own threads take runs straight from the counter, while its main thread answers requests
+void master(LocalQueue &local, const RunList &list, int nRanks, int threads) {
+    long next = 0;
+    const long total = list.size();
+    int active = nRanks - 1;
+
+    auto take = [&](long wanted) {
+        long remaining = total - next;
+        long chunk = std::min({wanted, remaining, std::max(1L, remaining / (2L * nRanks * threads))});
+        long begin = next;
+        next += chunk;
+        return std::make_pair(begin, next);
+    };
+
+    std::unique_lock<std::mutex> lock(local.m);
+    while (active > 0 || !local.noMore) {
+        // Keep this node's threads busy
+        if (!local.noMore && local.idle > 0 && local.runs.empty()) {
+            auto range = take(local.idle);
+            for (long r = range.first; r < range.second; ++r)
+                local.runs.push_back(r);
+            local.noMore = next == total;
+            local.cv.notify_all();
+        }
+
+        // Answer a worker's request, checking in on the local threads every so often
+        int flag = 0;
+        MPI_Status status;
+        if (active > 0)
+            MPI_Iprobe(MPI_ANY_SOURCE, TAG_REQUEST, MPI_COMM_WORLD, &flag, &status);
+        if (!flag) {
+            local.cv.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+        long wanted;
+        MPI_Recv(&wanted, 1, MPI_LONG, status.MPI_SOURCE, TAG_REQUEST, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        auto range = take(wanted);
+        long reply[2] = {range.first, range.second};
+        MPI_Send(reply, 2, MPI_LONG, status.MPI_SOURCE, TAG_WORK, MPI_COMM_WORLD);
+        if (reply[0] == reply[1])
+            --active;
+    }
+}
+
+// Other ranks ask rank 0 for runs whenever they have idle threads and nothing queued for them
+void worker(LocalQueue &local) {
+    std::unique_lock<std::mutex> lock(local.m);
+    while (!local.noMore) {
+        local.cv.wait(lock, [&]() { return local.idle > 0 && local.runs.empty(); });
+        long wanted = local.idle;
+        lock.unlock();
+        long range[2];
+        MPI_Send(&wanted, 1, MPI_LONG, 0, TAG_REQUEST, MPI_COMM_WORLD);
+        MPI_Recv(range, 2, MPI_LONG, 0, TAG_WORK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        lock.lock();
+        for (long r = range[0]; r < range[1]; ++r)
+            local.runs.push_back(r);
+        local.noMore = range[0] == range[1];
+        local.cv.notify_all();
+    }
+}
+
+// Node-local outputs are copied to a shard per rank, named OUTPUT.shardRANK, for shardmerge to put back together
+void stageOutputs(const string &files, const string &shardDir, int rank) {
+    namespace fs = std::filesystem;
+    fs::create_directories(shardDir);
+    for (const string &file : splitLine(files.c_str())) {
+        if (!fs::exists(file))
+            continue;
+        fs::path shard = fs::path(shardDir) / (fs::path(file).filename().string() + ".shard" + std::to_string(rank));
+        fs::copy_file(file, shard, fs::copy_options::overwrite_existing);
+    }
+}
+
+void doHelp(char* appname) {
+    std::fprintf(stdout,
+    "mpi_run_slim: run SLiM over every combination of seeds and parameter combos across many nodes.\n"
+    "Start one rank per node with mpiexec: rank 0 hands out runs from a shared queue, and every rank\n"
+    "(rank 0 included) keeps a pool of SLiM runs going on its node.\n"
+    "\n"
+    "Usage: mpiexec -n NODES --map-by ppr:1:node %s [OPTION]...\n"
+    "Example: mpiexec -n 20 --map-by ppr:1:node %s -s ./seeds.bin -c ./combos.bin -t 24\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-s FILEPATH    Seeds file, either a .csv with a Seed column or a binary table from seedgenerator -b.\n"
+    "               Defaults to ./seeds.csv.\n"
+    "\n"
+    "-c FILEPATH    Combos file, either a .csv with a header or a binary table from combo2bin.\n"
+    "               Every column is passed to SLiM as -d name=value, along with the row number as modelindex.\n"
+    "               Defaults to ./combos.csv.\n"
+    "\n"
+    "-x FILEPATH    SLiM script to run. Defaults to ~/Desktop/example_script.slim.\n"
+    "\n"
+    "-t N           Number of SLiM runs to have going at once on each node. Defaults to %d.\n"
+    "\n"
+    "-p LIST        Only pass these combos columns to SLiM, delimited by commas. Defaults to every column.\n"
+    "\n"
+    "-m FILEPATH    Only run the combo and seed rows listed for one task in this manifest (from slimrungen -k).\n"
+    "\n"
+    "-k N           The task to run from the manifest. Defaults to 1.\n"
+    "\n"
+    "-S FILEPATH    SLiM executable to run. Defaults to slim, found on the PATH.\n"
+    "\n"
+    "-o DIRECTORY   Once a node is done, copy its outputs to shards in this directory, named OUTPUT.shardRANK.\n"
+    "\n"
+    "-f LIST        The output files to copy with -o, delimited by commas.\n"
+    "               Example: -f \"out_slim1T_means.csv,out_slim1T_muts.csv\"\n"
+    "\n",
+    appname,
+    appname,
+    THREAD_NUM
+    );
+}
+
+int main(int argc, char* argv[]) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, nRanks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+    if (provided < MPI_THREAD_FUNNELED) {
+        std::cerr << "mpi_run_slim needs an MPI library with thread support (MPI_THREAD_FUNNELED)" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    const struct option longopts[] =
+    {
+        { "seeds",          required_argument,  0,  's' },
+        { "combos",         required_argument,  0,  'c' },
+        { "script",         required_argument,  0,  'x' },
+        { "threads",        required_argument,  0,  't' },
+        { "parameters",     required_argument,  0,  'p' },
+        { "manifest",       required_argument,  0,  'm' },
+        { "task",           required_argument,  0,  'k' },
+        { "slim",           required_argument,  0,  'S' },
+        { "shard-dir",      required_argument,  0,  'o' },
+        { "files",          required_argument,  0,  'f' },
+        { "help",           no_argument,        0,  'h' },
+        {0,0,0,0}
+    };
+
+    string seedsFile = "./seeds.csv";
+    string combosFile = "./combos.csv";
+    string script = "~/Desktop/example_script.slim";
+    int threads = THREAD_NUM;
+    string columns;
+    string manifestFile;
+    long task = 1;
+    string slim = "slim";
+    string shardDir;
+    string files;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1) {
+        options = getopt_long(argc, argv, "s:c:x:t:p:m:k:S:o:f:h", longopts, &optionindex);
+
+        switch (options) {
+            case 's':
+                seedsFile = optarg;
+                continue;
+
+            case 'c':
+                combosFile = optarg;
+                continue;
+
+            case 'x':
+                script = optarg;
+                continue;
+
+            case 't':
+                threads = std::stoi(optarg);
+                continue;
+
+            case 'p':
+                columns = optarg;
+                continue;
+
+            case 'm':
+                manifestFile = optarg;
+                continue;
+
+            case 'k':
+                task = std::stol(optarg);
+                continue;
+
+            case 'S':
+                slim = optarg;
+                continue;
+
+            case 'o':
+                shardDir = optarg;
+                continue;
+
+            case 'f':
+                files = optarg;
+                continue;
+
+            case 'h':
+                if (rank == 0)
+                    doHelp(argv[0]);
+                MPI_Finalize();
+                return 0;
+
+            case -1:
+                break;
+        }
+    }
+
+    // Every rank reads the seeds and combos itself, so only run indices need to go over the network
+    Sweep sweep;
+    RunList list{sweep, {}};
+    script = expandHome(script);
+    slim = expandHome(slim);
+    try {
+        loadSeeds(sweep, seedsFile);
+        loadCombos(sweep, combosFile);
+        if (!columns.empty())
+            selectColumns(sweep, columns);
+        if (!manifestFile.empty())
+            list.manifest = loadManifest(manifestFile, task, sweep);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Rank " << rank << ": " << e.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // One thread talks to the other ranks, and the rest keep SLiM runs going
+    LocalQueue local;
+    #pragma omp parallel num_threads(threads + 1)
+    {
+        if (omp_get_thread_num() == 0) {
+            if (rank == 0)
+                master(local, list, nRanks, threads);
+            else
+                worker(local);
+        }
+        else {
+            workLoop(local, list, script, slim);
+        }
+    }
+
+    if (!shardDir.empty()) {
+        try {
+            stageOutputs(files, shardDir, rank);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Rank " << rank << ": " << e.what() << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    MPI_Finalize();
+    return 0;
+}
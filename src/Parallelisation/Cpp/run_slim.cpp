@@ -1,58 +1,595 @@
-#include "includes/csv.h" // https://github.com/awdeorio/csvstream
+#include "includes/sweep.h" // Seeds, combos and launching SLiM, shared with mpi_run_slim
+#include "includes/checkpoint.h"
+#include "includes/cache.h"
+#include "includes/replicates.h"
 #include "stdlib.h"
 #include <iostream>
 #include <utility>
 #include <vector>
 #include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <getopt.h>
+#include <filesystem>
+#include <functional>
+#include <charconv>
+#include <stdexcept>
 #include "omp.h"
 #include <map>
 
-using std::vector; using std::string;
-
 #define THREAD_NUM 4 //omp_get_thread_num(); // Max CPUs on machine
 
 
-// Escaped " and ' are so the command line doesn't freak out with quotations in the middle of the line for string input
-// Feed in a single row of the combos.csv and a single seed at a time: the parallelised for loop will do this
-void runSLiM(std::pair<float, string> combo, string seed) {
-    float param1 = combo.first;     // Access the pair's first value, which is param1
-    string param2 = combo.second;
-    string callLine = "slim -s " + seed + " -d param1=" + std::to_string(param1) + " -d \"param2=\'" + param2 + "\'\" ~/Desktop/example_script.slim";
-    std::system(callLine.c_str());
+// A single SLiM run, with its arguments formatted when it's queued so the combos can be reloaded while jobs run
+struct Job {
+    string seed;
+    vector<string> comboArgs;
+    string key;     // combo_seed, naming its directory for checkpoints
+};
+
+// Adaptive mode: jobs come from a queue, and whenever it runs dry the adapt command (e.g. adaptgen) is called to
+// append new combos to the combos file from the results so far. Runs still in flight carry on while it works,
+// and the new combos are queued with every seed. Stops after the given number of rounds, or once a round adds nothing
+void runAdaptive(Sweep &sweep, const string &combosFile, const std::function<void(const Job &)> &launch, int threads,
+                 const string &adaptCmd, int rounds, const string &columns) {
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Job> queue;
+    size_t queuedCombos = 0;
+    int running = 0;
+    int round = 0;
+    bool refilling = false;
+    bool finished = false;
+
+    auto enqueue = [&]() {
+        for (size_t j = queuedCombos; j < sweep.nCombos(); ++j)
+            for (size_t i = 0; i < sweep.nSeeds(); ++i)
+                queue.push_back({sweep.seed(i), sweep.comboArgs(j), std::to_string(j + 1) + "_" + sweep.seed(i)});
+        queuedCombos = sweep.nCombos();
+    };
+    enqueue();
+
+    #pragma omp parallel num_threads(threads)
+    {
+        std::unique_lock<std::mutex> lock(m);
+        while (!finished) {
+            if (!queue.empty()) {
+                Job job = std::move(queue.front());
+                queue.pop_front();
+                ++running;
+                lock.unlock();
+                launch(job);
+                lock.lock();
+                --running;
+                cv.notify_all();
+            }
+            else if (!refilling && round < rounds) {
+                refilling = true;
+                ++round;
+                lock.unlock();
+                int status = std::system(adaptCmd.c_str());
+                lock.lock();
+                try {
+                    if (status == 0) {
+                        loadCombos(sweep, combosFile);
+                        if (!columns.empty())
+                            selectColumns(sweep, columns);
+                    }
+                }
+                catch (const std::exception &e) {
+                    std::cerr << e.what() << std::endl;
+                }
+                size_t before = queuedCombos;
+                enqueue();
+                std::cout << "Adaptive round " << round << ": " << queuedCombos - before << " new combos" << std::endl;
+                refilling = false;
+                if (queue.empty() && running == 0)
+                    finished = true;
+                cv.notify_all();
+            }
+            else if (!refilling && running == 0) {
+                finished = true;
+                cv.notify_all();
+            }
+            else {
+                cv.wait(lock);
+            }
+        }
+    }
+}
+
+// Sequential mode: each combo gets its seeds in batches, in seeds file order. Once a combo's batch has finished, its
+// summary is read back from the results file, and it only gets another batch while its 95% confidence interval is
+// wider than the target, so the cores go to the combos that are still uncertain. A combo stops early once it's
+// precise enough, or once it has run every seed. Combos are looked up in the results by the modelindex their runs
+// were passed, so the combos' own modelindex column works as well as row numbers
+void runSequential(const Sweep &sweep, const std::function<void(size_t, size_t)> &launch, int threads,
+                   ReplicateResults &results, size_t batch, double target) {
+    struct Run { size_t combo, seed; };
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Run> queue;
+    vector<size_t> nextSeed(sweep.nCombos(), 0);
+    vector<size_t> pending(sweep.nCombos(), 0);
+    int running = 0;
+    size_t saved = 0;
+
+    vector<long> models(sweep.nCombos());
+    for (size_t j = 0; j < sweep.nCombos(); ++j) {
+        string index = sweep.modelIndex(j);
+        auto res = std::from_chars(index.data(), index.data() + index.size(), models[j]);
+        if (res.ec != std::errc() || res.ptr != index.data() + index.size())
+            throw std::runtime_error("Sequential mode (-w) needs whole number modelindexes, combo " +
+                                     std::to_string(j + 1) + " has " + index);
+    }
+
+    auto enqueue = [&](size_t combo) {
+        size_t end = std::min(nextSeed[combo] + batch, sweep.nSeeds());
+        for (; nextSeed[combo] < end; ++nextSeed[combo], ++pending[combo])
+            queue.push_back({combo, nextSeed[combo]});
+    };
+    for (size_t j = 0; j < sweep.nCombos(); ++j)
+        enqueue(j);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        std::unique_lock<std::mutex> lock(m);
+        while (!queue.empty() || running > 0) {
+            if (queue.empty()) {
+                cv.wait(lock);
+                continue;
+            }
+            Run run = queue.front();
+            queue.pop_front();
+            ++running;
+            lock.unlock();
+            launch(run.combo, run.seed);
+            lock.lock();
+            --running;
+
+            if (--pending[run.combo] == 0) {
+                results.update();
+                Estimate e = results.estimate(models[run.combo]);
+                if (e.width > target && nextSeed[run.combo] < sweep.nSeeds()) {
+                    enqueue(run.combo);
+                }
+                else {
+                    saved += sweep.nSeeds() - nextSeed[run.combo];
+                    std::cout << "Combo " << models[run.combo] << ": " << e.n << " seeds, mean " << e.mean
+                              << ", 95% CI width " << e.width << (e.width > target ? " (out of seeds)" : "") << std::endl;
+                }
+            }
+            cv.notify_all();
+        }
+    }
+    std::cout << "Sequential mode skipped " << saved << " of " << sweep.nSeeds() * sweep.nCombos() << " runs" << std::endl;
+}
+
+// Two-stage sweeps: a branch run starts from its combo's saved burn-in, if its burn-in has run. Without one it runs
+// the burn-in itself, so a failed burn-in costs time rather than results
+vector<string> branchArgs(const Sweep &sweep, size_t combo, size_t seed, const vector<long> &burnins,
+                          const string &burninDir) {
+    vector<string> args = sweep.comboArgs(combo);
+    if (burnins.empty())
+        return args;
+    string file = burninFile(burninDir, burnins[combo], sweep.seed(seed));
+    if (std::filesystem::exists(file)) {
+        args.emplace_back("-d");
+        args.emplace_back("burninFile='" + file + "'");
+    }
+    else {
+        #pragma omp critical
+        std::cerr << "No burn-in at " << file << ", running combo " << combo + 1 << " from the start" << std::endl;
+    }
+    return args;
+}
+
+// The first stage of a two-stage sweep: one burn-in per seed for each set of burn-in parameters,
+// run with the parameters of the first combo that branches from it
+void runBurnins(const Sweep &sweep, const vector<long> &burnins, const string &burninDir, const string &script,
+                const string &slim) {
+    std::map<long, size_t> firstCombo;
+    for (size_t j = burnins.size(); j-- > 0;)
+        firstCombo[burnins[j]] = j;
+    vector<std::pair<long, size_t>> groups(firstCombo.begin(), firstCombo.end());
+
+    std::filesystem::create_directories(burninDir);
+    const long nSeeds = sweep.nSeeds();
+    const long nGroups = groups.size();
+
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (long i=0; i < nSeeds; ++i) {
+        for (long b=0; b < nGroups; ++b) {
+            string file = burninFile(burninDir, groups[b].first, sweep.seed(i));
+            runSLiM(burninArgs(sweep, groups[b].second, groups[b].first, file), sweep.seed(i), script, slim);
+        }
+    }
 }
 
+// Run SLiM through the result cache: outputs come from the cache if the run has been done before. Otherwise it runs,
+// with checkpoints if there are any, or in a directory of its own under localDir, and its outputs are stored
+void runCached(ResultCache &cache, Checkpoints *checkpoints, const vector<string> &args, const string &runKey,
+               const string &seed, const string &script, const string &slim, const string &localDir) {
+    namespace fs = std::filesystem;
+    const string key = cache.key(args, seed);
+    if (cache.fetch(key))
+        return;
+
+    if (checkpoints) {
+        if (checkpoints->run(args, runKey, seed, script, slim))
+            cache.store(key, checkpoints->outputsDir(runKey));
+        return;
+    }
+
+    std::error_code ec;
+    fs::path dir = fs::path(localDir) / ("run_" + key);
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Couldn't make " << dir << " to run in: " << ec.message() << std::endl;
+        return;
+    }
+    if (runSLiM(args, seed, script, slim, dir.string())) {
+        cache.store(key, dir);
+        vector<fs::path> files;
+        for (const fs::directory_entry &entry : fs::directory_iterator(dir, ec))
+            files.push_back(entry.path());
+        appendOutputs(files);
+    }
+    fs::remove_all(dir, ec);
+}
+
+void doHelp(char* appname) {
+    std::fprintf(stdout,
+    "run_slim: run SLiM over every combination of seeds and parameter combos in parallel.\n"
+    "\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -s ./seeds.bin -c ./combos.bin -t 24\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-s FILEPATH    Seeds file, either a .csv with a Seed column or a binary table from seedgenerator -b.\n"
+    "               Defaults to ./seeds.csv.\n"
+    "\n"
+    "-c FILEPATH    Combos file, either a .csv with a header or a binary table from combo2bin.\n"
+    "               Every column is passed to SLiM as -d name=value, along with the row number as modelindex.\n"
+    "               Defaults to ./combos.csv.\n"
+    "\n"
+    "-x FILEPATH    SLiM script to run. Defaults to ~/Desktop/example_script.slim.\n"
+    "\n"
+    "-t N           Number of SLiM runs to have going at once. Defaults to %d.\n"
+    "\n"
+    "-a COMMAND     Adaptive mode: whenever the job queue runs dry, run COMMAND, which should append new combos\n"
+    "               to the combos file (e.g. adaptgen), and queue them with every seed.\n"
+    "               Example: -a \"adaptgen -i ./combos.csv -r ./out_slim1T_means.csv -n 20\"\n"
+    "               Works with -C and -R, but not with -m, -B or -I.\n"
+    "\n"
+    "-r N           Maximum number of adaptive rounds. Defaults to 10.\n"
+    "\n"
+    "-p LIST        Only pass these combos columns to SLiM, delimited by commas. Defaults to every column.\n"
+    "               Example: -p \"Ne,rec\"\n"
+    "\n"
+    "-m FILEPATH    Run one task of a packed job: only the combo and seed rows listed for the task in this manifest\n"
+    "               (from slimrungen -k). Use with -k.\n"
+    "\n"
+    "-k N           The task to run from the manifest, e.g. -k $PBS_ARRAY_INDEX. Defaults to 1.\n"
+    "\n"
+    "-S FILEPATH    SLiM executable to run. Defaults to slim, found on the PATH.\n"
+    "\n"
+    "-B FILEPATH    Two-stage sweep: the burn-in each combo branches from, as combo,burnin rows (from slimrungen -D).\n"
+    "               Each run starts from its burn-in's saved population, passed to SLiM as burninFile.\n"
+    "\n"
+    "-D DIRECTORY   Where the burn-in populations are saved for -B. Defaults to ./burnins.\n"
+    "\n"
+    "-I             Run the burn-ins of a two-stage sweep instead of the branches: one per seed for each burn-in in\n"
+    "               the -B plan, saved to the -D directory with burninOnly=T.\n"
+    "\n"
+    "-C DIRECTORY   Checkpoint runs, keeping their latest checkpoints in this shared directory. Each run works in a\n"
+    "               directory of its own under -L, and is passed checkpointEvery and checkpointFile. New checkpoints\n"
+    "               are copied to DIRECTORY in the background. Rerun with the same DIRECTORY after a walltime kill:\n"
+    "               unfinished runs resume from their last checkpoint, and finished runs only have their outputs copied.\n"
+    "               Use one DIRECTORY per sweep.\n"
+    "\n"
+    "-G N           Generations between checkpoints for -C. Defaults to 1000.\n"
+    "\n"
+    "-L DIRECTORY   Node-local directory the runs work in for -C and -R. Defaults to $TMPDIR, or /tmp.\n"
+    "\n"
+    "-R DIRECTORY   Result cache: runs with the same script, SLiM, -d parameters and seed as one done before copy\n"
+    "               its outputs from the cache instead of running again. Runs work in a directory of their own\n"
+    "               under -L, and their outputs are stored once they finish. Can be shared between sweeps and jobs.\n"
+    "\n"
+    "-M SIZE        Size limit for the result cache, e.g. 500M or 20G: the least recently used runs are evicted\n"
+    "               to stay under it. Defaults to 10G.\n"
+    "\n"
+    "-w WIDTH       Sequential mode: run each combo's seeds in batches, and stop giving a combo seeds once the 95%%\n"
+    "               confidence interval of its summary column (-q) is no wider than WIDTH, or its seeds run out.\n"
+    "               Seeds are used in the order of the seeds file. Not with -a, -m or -I.\n"
+    "\n"
+    "-n N           Seeds per batch for -w. Defaults to 5.\n"
+    "\n"
+    "-o FILEPATH    SLiM output the summary is read from for -w. Defaults to ./out_slim1T_means.csv.\n"
+    "\n"
+    "-q COL         Column of the -o output holding the summary. Defaults to 6 (phenomean).\n"
+    "\n"
+    "-g GEN         Use the summary at this generation. Defaults to the latest generation each combo has reached.\n"
+    "\n",
+    appname,
+    appname,
+    THREAD_NUM
+    );
+}
+
+int main(int argc, char* argv[]) {
+    const struct option longopts[] =
+    {
+        { "seeds",          required_argument,  0,  's' },
+        { "combos",         required_argument,  0,  'c' },
+        { "script",         required_argument,  0,  'x' },
+        { "threads",        required_argument,  0,  't' },
+        { "adapt",          required_argument,  0,  'a' },
+        { "rounds",         required_argument,  0,  'r' },
+        { "parameters",     required_argument,  0,  'p' },
+        { "manifest",       required_argument,  0,  'm' },
+        { "task",           required_argument,  0,  'k' },
+        { "slim",           required_argument,  0,  'S' },
+        { "burnin-plan",    required_argument,  0,  'B' },
+        { "burnin-dir",     required_argument,  0,  'D' },
+        { "burnins",        no_argument,        0,  'I' },
+        { "checkpoints",    required_argument,  0,  'C' },
+        { "interval",       required_argument,  0,  'G' },
+        { "local-dir",      required_argument,  0,  'L' },
+        { "cache",          required_argument,  0,  'R' },
+        { "cache-size",     required_argument,  0,  'M' },
+        { "ci-width",       required_argument,  0,  'w' },
+        { "batch",          required_argument,  0,  'n' },
+        { "results",        required_argument,  0,  'o' },
+        { "summary-col",    required_argument,  0,  'q' },
+        { "generation",     required_argument,  0,  'g' },
+        { "help",           no_argument,        0,  'h' },
+        {0,0,0,0}
+    };
+
+    string seedsFile = "./seeds.csv";
+    string combosFile = "./combos.csv";
+    string script = "~/Desktop/example_script.slim";
+    int threads = THREAD_NUM;
+    string adaptCmd;
+    int rounds = 10;
+    string columns;
+    string manifestFile;
+    long task = 1;
+    string slim = "slim";
+    string planFile;
+    string burninDir = "./burnins";
+    bool burninStage = false;
+    string checkpointDir;
+    long checkpointEvery = 1000;
+    string localDir = std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp";
+    string cacheDir;
+    string cacheSize = "10G";
+    double ciWidth = 0.0;
+    size_t batch = 5;
+    string resultsFile = "./out_slim1T_means.csv";
+    size_t summaryCol = 6;
+    double generation = NAN;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1) {
+        options = getopt_long(argc, argv, "s:c:x:t:a:r:p:m:k:S:B:D:IC:G:L:R:M:w:n:o:q:g:h", longopts, &optionindex);
+
+        switch (options) {
+            case 's':
+                seedsFile = optarg;
+                continue;
+
+            case 'c':
+                combosFile = optarg;
+                continue;
+
+            case 'x':
+                script = optarg;
+                continue;
+
+            case 't':
+                threads = std::stoi(optarg);
+                continue;
 
+            case 'a':
+                adaptCmd = optarg;
+                continue;
+
+            case 'r':
+                rounds = std::stoi(optarg);
+                continue;
+
+            case 'p':
+                columns = optarg;
+                continue;
+
+            case 'm':
+                manifestFile = optarg;
+                continue;
+
+            case 'k':
+                task = std::stol(optarg);
+                continue;
+
+            case 'S':
+                slim = optarg;
+                continue;
+
+            case 'B':
+                planFile = optarg;
+                continue;
+
+            case 'D':
+                burninDir = optarg;
+                continue;
+
+            case 'I':
+                burninStage = true;
+                continue;
+
+            case 'C':
+                checkpointDir = optarg;
+                continue;
+
+            case 'G':
+                checkpointEvery = std::stol(optarg);
+                continue;
+
+            case 'L':
+                localDir = optarg;
+                continue;
+
+            case 'R':
+                cacheDir = optarg;
+                continue;
+
+            case 'M':
+                cacheSize = optarg;
+                continue;
+
+            case 'w':
+                ciWidth = std::stod(optarg);
+                continue;
+
+            case 'n':
+                batch = std::stoul(optarg);
+                continue;
+
+            case 'o':
+                resultsFile = optarg;
+                continue;
+
+            case 'q':
+                summaryCol = std::stoul(optarg);
+                continue;
+
+            case 'g':
+                generation = std::stod(optarg);
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case -1:
+                break;
+        }
+    }
 
-int main() {
     // Read the seeds and combos
-    io::CSVReader<1> seeds("./seeds.csv");
-    seeds.read_header(io::ignore_extra_column, "Seed");
-    vector<string> vSeeds;
-    int64_t curSeed;
-    // For each row in the file, fill variables with that row's values
-    while (seeds.read_row(curSeed)) {
-        vSeeds.emplace_back(std::to_string(curSeed)); // Stick it into a vector of all seeds
-    }
-    io::CSVReader<2> combos("./combos.csv");
-    combos.read_header(io::ignore_extra_column, "param1", "param2");
-    vector<std::pair<float, string>> vCombos;
-    float curP1;
-    string curP2;
-    while (combos.read_row(curP1, curP2)) {
-        vCombos.emplace_back(curP1, curP2); // Same as above, but we are constructing a vector of pairs, where the pair is param1 and param2
-        }
-    
-    
+    Sweep sweep;
+    vector<std::pair<long, long>> runs;
+    vector<long> burnins;
+    script = expandHome(script);
+    slim = expandHome(slim);
+    burninDir = expandHome(burninDir);
+    try {
+        loadSeeds(sweep, seedsFile);
+        loadCombos(sweep, combosFile);
+        if (!columns.empty())
+            selectColumns(sweep, columns);
+        if (!manifestFile.empty())
+            runs = loadManifest(manifestFile, task, sweep);
+        if (!planFile.empty())
+            burnins = loadBurninPlan(planFile, sweep);
+        if (burninStage && burnins.empty())
+            throw std::runtime_error("Running the burn-ins (-I) needs a burn-in plan (-B)");
+        if (ciWidth > 0.0 && (!adaptCmd.empty() || !manifestFile.empty() || burninStage))
+            throw std::runtime_error("Sequential mode (-w) can't be used with -a, -m or -I");
+        if (!adaptCmd.empty() && (!manifestFile.empty() || !planFile.empty() || burninStage))
+            throw std::runtime_error("Adaptive mode (-a) can't be used with -m, -B or -I");
+        if (ciWidth > 0.0 && (batch < 1 || summaryCol < 4))
+            throw std::runtime_error("Sequential mode (-w) needs a batch of at least 1 seed (-n) and a summary column after modelindex (-q)");
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     // Start of parallel processing code
-    omp_set_num_threads(THREAD_NUM); // How many cores to use?
-    #pragma omp parallel for collapse(2) // 2 for loops, so collapse those loops into one parallelisable structure
-    { 
-        for (int i=0; i < vSeeds.size(); ++i) {
-            for (int j=0; j < vCombos.size(); ++j) {
-                runSLiM(vCombos[j], vSeeds[i]); // run SLiM with a given seed and parameter combination
-            }
+    omp_set_num_threads(threads); // How many cores to use?
+
+    if (burninStage) {
+        runBurnins(sweep, burnins, burninDir, script, slim);
+        return 0;
+    }
+
+    // With checkpoints or the cache, runs work in directories of their own, so paths have to be absolute
+    std::unique_ptr<Checkpoints> checkpoints;
+    std::unique_ptr<ResultCache> cache;
+    if (!checkpointDir.empty() || !cacheDir.empty()) {
+        namespace fs = std::filesystem;
+        script = fs::absolute(script).string();
+        burninDir = fs::absolute(burninDir).string();
+        localDir = fs::absolute(expandHome(localDir)).string();
+        if (slim.find('/') != string::npos)
+            slim = fs::absolute(slim).string();
+        try {
+            if (!checkpointDir.empty())
+                checkpoints = std::make_unique<Checkpoints>(fs::absolute(expandHome(checkpointDir)).string(), localDir,
+                                                            checkpointEvery);
+            if (!cacheDir.empty())
+                cache = std::make_unique<ResultCache>(expandHome(cacheDir), parseSize(cacheSize), script, slim);
+        }
+        catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    auto run = [&](const Job &job) {
+        if (cache)
+            runCached(*cache, checkpoints.get(), job.comboArgs, job.key, job.seed, script, slim, localDir);
+        else if (checkpoints)
+            checkpoints->run(job.comboArgs, job.key, job.seed, script, slim);
+        else
+            runSLiM(job.comboArgs, job.seed, script, slim);
+    };
+    auto launch = [&](size_t combo, size_t seed) {
+        run({sweep.seed(seed), branchArgs(sweep, combo, seed, burnins, burninDir),
+             std::to_string(combo + 1) + "_" + sweep.seed(seed)});
+    };
+
+    if (!adaptCmd.empty()) {
+        runAdaptive(sweep, combosFile, run, threads, adaptCmd, rounds, columns);
+        return 0;
+    }
+
+    if (ciWidth > 0.0) {
+        ReplicateResults results(resultsFile, summaryCol, generation);
+        try {
+            runSequential(sweep, launch, threads, results, batch, ciWidth);
+        }
+        catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!manifestFile.empty()) {
+        const long nRuns = runs.size();
+        #pragma omp parallel for schedule(dynamic)
+        for (long r=0; r < nRuns; ++r) {
+            launch(runs[r].first, runs[r].second);
+        }
+        return 0;
+    }
+
+    const long nSeeds = sweep.nSeeds();
+    const long nCombos = sweep.nCombos();
+
+    #pragma omp parallel for collapse(2) schedule(dynamic) // 2 for loops, so collapse those loops into one parallelisable structure
+    for (long i=0; i < nSeeds; ++i) {
+        for (long j=0; j < nCombos; ++j) {
+            launch(j, i); // run SLiM with a given seed and parameter combination
         }
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,425 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "../../Parallelisation/Cpp/includes/csv.h"
+#include "../../Parallelisation/Cpp/includes/parse.h"
+#include "../../Parallelisation/Cpp/includes/slimcol.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+#define BUFFER_SIZE (4 << 20)
+
+
+using slimformat::Layout;
+using slimformat::Preset;
+using slimformat::PRESETS;
+
+// Columns from -n: a list, the name of a preset, or nothing, in which case a preset is picked by the output's name
+// (e.g. out_slim1T_muts.csv) if its first row fits one of the preset's layouts, and any other file gets c1, c2, ...
+Layout file_layout(const string &names, const string &infile, size_t ncols)
+{
+    if (const Preset *preset = slimformat::findPreset(names, infile))
+    {
+        Layout layout = slimformat::presetLayout(*preset);
+        if (!names.empty() || layout.fields.count(ncols))
+            return layout;
+    }
+    vector<string> columns;
+    if (!names.empty())
+        columns = splitList(names);
+    for (size_t c = columns.size(); c < ncols; ++c)
+        columns.push_back("c" + std::to_string(c + 1));
+    if (columns.size() != ncols)
+        throw std::runtime_error("Got " + std::to_string(columns.size()) + " column names for " + std::to_string(ncols) + " columns");
+    return slimformat::plainLayout(columns);
+}
+
+// Convert a SLiM output csv into a columnar file. Rows can have any of the layout's widths, and are padded with NA
+// to the full set of columns
+void csv_to_col(const string &infile, const string &outfile, const string &names, bool header, uint32_t chunkRows, bool debug)
+{
+    io::LineReader in(infile);
+    char *line = in.next_line();
+    while (line && !*line)
+        line = in.next_line();
+    if (!line)
+        throw std::runtime_error(infile + " is empty");
+
+    vector<std::string_view> fields;
+    splitFields(line, fields);
+    Layout layout;
+    if (header)
+    {
+        layout = slimformat::plainLayout(vector<string>(fields.begin(), fields.end()));
+        line = in.next_line();
+    }
+    else
+    {
+        layout = file_layout(names, infile, fields.size());
+    }
+
+    slimcol::Writer out(outfile, layout.columns, chunkRows);
+    vector<std::string_view> row(layout.columns.size());
+    string width;
+    for (; line; line = in.next_line())
+    {
+        if (!*line)
+            continue;   // The model can leave blank lines between its mutation outputs
+        splitFields(line, fields);
+        auto cols = layout.fields.find(fields.size());
+        if (cols == layout.fields.end())
+            throw std::runtime_error(infile + ":" + std::to_string(in.get_file_line()) + " has " + std::to_string(fields.size())
+                                     + " columns, expected " + layout.widths());
+        std::fill(row.begin(), row.end(), std::string_view("NA"));
+        for (size_t f = 0; f < fields.size(); ++f)
+            row[cols->second[f]] = fields[f];
+        if (layout.mixed())
+        {
+            width = std::to_string(fields.size());
+            row.back() = width;
+        }
+        out.addRow(row);
+    }
+    out.close();
+
+    if (debug)
+    {
+        slimcol::Reader check(outfile);
+        const char *encodings[] = {"", "int", "int delta", "double", "dictionary"};
+        cout << "Converted " << check.rows() << " rows from " << infile << " to " << outfile << " in " << check.chunks() << " chunks\n";
+        for (size_t c = 0; c < check.cols(); ++c)
+        {
+            size_t bytes = 0;
+            for (size_t k = 0; k < check.chunks(); ++k)
+                bytes += check.chunk(c, k).size;
+            cout << "  " << check.name(c) << ": " << bytes << " bytes";
+            if (check.chunks() > 0)
+                cout << ", first chunk " << encodings[check.chunk(c, 0).encoding];
+            cout << "\n";
+        }
+    }
+}
+
+// A range filter from -w: rows where col is in [lo, hi]
+struct Range
+{
+    size_t col;
+    double lo;
+    double hi;
+};
+
+Range parse_range(const string &spec, const slimcol::Reader &in)
+{
+    size_t eq = spec.find('=');
+    size_t colon = spec.find(':', eq);
+    if (eq == string::npos || colon == string::npos)
+        throw std::invalid_argument("Can't read the range " + spec + ", expected COL=LO:HI");
+    int col = in.find(spec.substr(0, eq));
+    if (col < 0)
+        throw std::invalid_argument("No column named " + spec.substr(0, eq));
+    string lo = spec.substr(eq + 1, colon - eq - 1), hi = spec.substr(colon + 1);
+    return { size_t(col), lo.empty() ? -INFINITY : std::stod(lo), hi.empty() ? INFINITY : std::stod(hi) };
+}
+
+// Write the rows of one chunk that pass the ranges, with only the projected columns, as csv. Given the layout of a
+// file with rows of several widths (and every column projected), each row is written with only the fields it had.
+// A row whose width isn't one of the layout's is written whole
+void chunk_to_csv(const slimcol::Reader &in, size_t chunk, const vector<size_t> &project, const vector<Range> &ranges,
+                  const Layout *layout, string &out)
+{
+    for (const Range &range : ranges)
+        if (!in.mayContain(range.col, chunk, range.lo, range.hi))
+            return;
+
+    const size_t rows = in.chunkRows(chunk);
+    vector<char> keep(rows, 1);
+    slimcol::Chunk values;
+    for (const Range &range : ranges)
+    {
+        in.read(range.col, chunk, values);
+        for (size_t r = 0; r < rows; ++r)
+        {
+            double v = values.number(r);
+            keep[r] = keep[r] && v >= range.lo && v <= range.hi;
+        }
+    }
+
+    vector<slimcol::Chunk> columns(project.size());
+    for (size_t c = 0; c < project.size(); ++c)
+        in.read(project[c], chunk, columns[c]);
+    for (size_t r = 0; r < rows; ++r)
+    {
+        if (!keep[r])
+            continue;
+        auto cols = layout ? layout->fields.find(size_t(columns.back().number(r))) : std::map<size_t, vector<size_t>>::const_iterator();
+        if (layout && cols != layout->fields.end())
+        {
+            for (size_t f = 0; f < cols->second.size(); ++f)
+            {
+                if (f)
+                    out += ',';
+                columns[cols->second[f]].format(r, out);
+            }
+        }
+        else
+        {
+            for (size_t c = 0; c < project.size(); ++c)
+            {
+                if (c)
+                    out += ',';
+                columns[c].format(r, out);
+            }
+        }
+        out += '\n';
+    }
+}
+
+// Write a columnar file back out as csv, optionally only some columns and rows. Chunks are decoded in parallel, a
+// batch at a time, and written in order
+void col_to_csv(const string &infile, const string &outfile, const string &projection, const vector<string> &rangeSpecs,
+                bool header, bool debug)
+{
+    slimcol::Reader in(infile);
+    vector<size_t> project;
+    for (const string &name : splitList(projection))
+    {
+        int col = in.find(name);
+        if (col < 0)
+            throw std::invalid_argument("No column named " + name + " in " + infile);
+        project.push_back(col);
+    }
+    if (project.empty())
+        for (size_t c = 0; c < in.cols(); ++c)
+            project.push_back(c);
+    vector<Range> ranges;
+    for (const string &spec : rangeSpecs)
+        ranges.push_back(parse_range(spec, in));
+
+    // A preset's file with rows of several layouts, written whole: give each row back its own columns
+    vector<string> names;
+    for (size_t c = 0; c < in.cols(); ++c)
+        names.push_back(in.name(c));
+    Layout mixed;
+    bool asWritten = false;
+    for (const Preset &preset : PRESETS)
+    {
+        Layout layout = slimformat::presetLayout(preset);
+        if (projection.empty() && layout.mixed() && layout.columns == names)
+        {
+            mixed = layout;
+            asWritten = true;
+        }
+    }
+    if (asWritten && header)
+        throw std::invalid_argument(infile + "'s rows have different columns, so can't share a header: pick columns with -c");
+
+    FILE *out = outfile.empty() ? stdout : std::fopen(outfile.c_str(), "wb");
+    if (!out)
+        throw std::runtime_error("Can't open " + outfile + " for writing");
+    std::setvbuf(out, nullptr, _IOFBF, BUFFER_SIZE);
+    if (header)
+    {
+        for (size_t c = 0; c < project.size(); ++c)
+            std::fprintf(out, "%s%s", c ? "," : "", in.name(project[c]).c_str());
+        std::fputc('\n', out);
+    }
+
+    const size_t batch = 4 * omp_get_max_threads();
+    vector<string> texts(batch);
+    for (size_t first = 0; first < in.chunks(); first += batch)
+    {
+        size_t n = std::min(batch, in.chunks() - first);
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t k = 0; k < n; ++k)
+        {
+            texts[k].clear();
+            chunk_to_csv(in, first + k, project, ranges, asWritten ? &mixed : nullptr, texts[k]);
+        }
+        for (size_t k = 0; k < n; ++k)
+            std::fwrite(texts[k].data(), 1, texts[k].size(), out);
+    }
+
+    bool failed = std::fflush(out) != 0;
+    if (out != stdout)
+        std::fclose(out);
+    if (failed)
+        throw std::runtime_error("Failed writing to " + (outfile.empty() ? string("the standard output") : outfile));
+    if (debug)
+        std::cerr << "Read " << project.size() << " of " << in.cols() << " columns of " << in.rows() << " rows from " << infile << endl;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "SLiM Columns\n"
+    "\n"
+    "This program converts a SLiM output .csv into a columnar binary file, which analyses can mmap and read a column\n"
+    "at a time without parsing text, and back. Rows are stored in chunks, and each column of a chunk is encoded on its\n"
+    "own: whole numbers as deltas, other numbers as doubles and anything else as a dictionary, with the minimum and\n"
+    "maximum of each chunk so reads can skip chunks outside a range.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./out_slim1T_muts.csv -d ./out_slim1T_muts.col\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i FILEPATH    The file to convert. Defaults to ./out_slim1T_means.csv.\n"
+    "\n"
+    "-d FILEPATH    Specify a filepath and name for the converted file. Defaults to the input with a .col extension,\n"
+    "               or the standard output with -r.\n"
+    "\n"
+    "-n LIST        Column names, delimited by commas, or the name of one of the model's outputs: means, burnin,\n"
+    "               burnend, opt or muts. Defaults to the output named in the input's filename, e.g. muts for\n"
+    "               ./out_slim1T_muts.csv, or c1, c2, ... for anything else.\n"
+    "\n"
+    "-H             The .csv has a header row: take the column names from it, or with -r, write one.\n"
+    "\n"
+    "-b N           Rows per chunk. Defaults to 65536.\n"
+    "\n"
+    "-r             Reverse the conversion: read a columnar file and write a .csv.\n"
+    "               Example: -r -i ./out_slim1T_muts.col -c generation,id,freq -w modelindex=200:300\n"
+    "\n"
+    "-c LIST        With -r, the columns to write, delimited by commas. Defaults to all of them.\n"
+    "\n"
+    "-w COL=LO:HI   With -r, only write rows where COL is between LO and HI, inclusive. Either bound can be left out.\n"
+    "               Can be given more than once.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "destination",    required_argument,  0,  'd' },
+        { "names",          required_argument,  0,  'n' },
+        { "header",         no_argument,        0,  'H' },
+        { "chunk",          required_argument,  0,  'b' },
+        { "reverse",        no_argument,        0,  'r' },
+        { "columns",        required_argument,  0,  'c' },
+        { "where",          required_argument,  0,  'w' },
+        { "threads",        required_argument,  0,  'T' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string infile = "./out_slim1T_means.csv";
+    string outfile;
+    string names;
+    string projection;
+    vector<string> ranges;
+    uint32_t chunkRows = 65536;
+    bool header = false;
+    bool reverse = false;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:d:n:Hb:rc:w:T:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                infile = optarg;
+                continue;
+
+            case 'd':
+                outfile = optarg;
+                continue;
+
+            case 'n':
+                names = optarg;
+                continue;
+
+            case 'H':
+                header = true;
+                continue;
+
+            case 'b':
+                chunkRows = std::stoul(optarg);
+                continue;
+
+            case 'r':
+                reverse = true;
+                continue;
+
+            case 'c':
+                projection = optarg;
+                continue;
+
+            case 'w':
+                ranges.push_back(optarg);
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        if (reverse)
+        {
+            col_to_csv(infile, outfile, projection, ranges, header, debug);
+        }
+        else
+        {
+            if (outfile.empty())
+            {
+                size_t dot = infile.rfind('.');
+                size_t slash = infile.rfind('/');
+                bool extension = dot != string::npos && (slash == string::npos || dot > slash);
+                outfile = infile.substr(0, extension ? dot : infile.size()) + ".col";
+            }
+            csv_to_col(infile, outfile, names, header, chunkRows, debug);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    if (debug)
+        std::cerr << "Done in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << endl;
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include "../../Parallelisation/Cpp/includes/csv.h"
+#include "../../Parallelisation/Cpp/includes/parse.h"
+#include "../../Parallelisation/Cpp/includes/slimbin.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+
+// Narrowest type that can hold every value in a column: integers, then doubles, then fixed-width strings. A value
+// written with a point or an exponent (1.0, 1e-8) isn't an integer, so its column is always doubles, and SLiM is passed
+// floats for it as it would be from the .csv
+slimbin::Column infer_column(const string &name, const vector<vector<string>> &rows, size_t col)
+{
+    bool isInt = true;
+    bool isFloat = true;
+    size_t width = 1;
+    for (const vector<string> &row : rows)
+    {
+        const string &value = row[col];
+        width = std::max(width, value.size());
+        if (value.empty())
+        {
+            isInt = isFloat = false;
+            continue;
+        }
+        int64_t i;
+        double d;
+        const char *end = value.data() + value.size();
+        auto ires = std::from_chars(value.data(), end, i);
+        isInt = isInt && ires.ec == std::errc() && ires.ptr == end;
+        auto dres = std::from_chars(value.data(), end, d);
+        isFloat = isFloat && dres.ec == std::errc() && dres.ptr == end;
+    }
+
+    slimbin::Column column;
+    column.name = name;
+    column.type = isInt ? slimbin::I64 : isFloat ? slimbin::F64 : slimbin::STR;
+    column.width = column.type == slimbin::STR ? width : 0;
+    return column;
+}
+
+// Convert a combos csv (with a header) into a binary table
+int csv_to_bin(const string &infile, const string &outfile, bool debug)
+{
+    io::LineReader in(infile);
+    char *line = in.next_line();
+    if (!line)
+    {
+        std::cerr << infile << " is empty" << endl;
+        return 1;
+    }
+    vector<string> header = splitLine(line);
+
+    vector<vector<string>> rows;
+    while ((line = in.next_line()))
+    {
+        if (!*line)
+            continue;
+        rows.emplace_back(splitLine(line));
+        if (rows.back().size() != header.size())
+        {
+            std::cerr << infile << ":" << in.get_file_line() << " has " << rows.back().size()
+                      << " columns, expected " << header.size() << endl;
+            return 1;
+        }
+    }
+
+    vector<slimbin::Column> columns;
+    for (size_t i = 0; i < header.size(); ++i)
+        columns.emplace_back(infer_column(header[i], rows, i));
+
+    slimbin::Writer out(outfile, columns);
+    for (const vector<string> &row : rows)
+    {
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            const string &value = row[i];
+            switch (columns[i].type)
+            {
+                case slimbin::I64:
+                    out.set(i, int64_t(std::stoll(value)));
+                    break;
+                case slimbin::F64:
+                    out.set(i, std::stod(value));
+                    break;
+                default:
+                    out.set(i, std::string_view(value));
+            }
+        }
+        out.endRow();
+    }
+    out.close();
+
+    if (debug)
+    {
+        cout << "Converted " << rows.size() << " rows from " << infile << " to " << outfile << "\n";
+        const char *typeNames[] = {"", "u32", "u64", "i64", "f64", "str"};
+        for (const slimbin::Column &col : columns)
+            cout << "  " << col.name << ": " << typeNames[col.type] << (col.type == slimbin::STR ? "[" + std::to_string(col.width) + "]" : "") << "\n";
+    }
+    return 0;
+}
+
+// Dump a binary table back to csv, for checking what's in it
+int bin_to_csv(const string &infile, const string &outfile, bool debug)
+{
+    slimbin::Reader in(infile);
+    std::ofstream out(outfile);
+
+    for (size_t c = 0; c < in.cols(); ++c)
+        out << (c ? "," : "") << in.column(c).name;
+    out << "\n";
+
+    for (size_t r = 0; r < in.rows(); ++r)
+    {
+        for (size_t c = 0; c < in.cols(); ++c)
+            out << (c ? "," : "") << in.toString(r, c);
+        out << "\n";
+    }
+
+    if (debug)
+        cout << "Wrote " << in.rows() << " rows from " << infile << " to " << outfile << endl;
+    return 0;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "Combo Converter\n"
+    "\n"
+    "This program converts a combos .csv into a binary table that run_slim can mmap and use directly.\n"
+    "Column types are inferred: whole numbers become 64-bit integers, other numbers doubles, and anything else fixed-width strings.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./combos.csv -d ./combos.bin\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i FILEPATH    The file to convert. Defaults to ./combos.csv.\n"
+    "\n"
+    "-d FILEPATH    Specify a filepath and name for the converted file. Defaults to ./combos.bin.\n"
+    "               Example: -d ~/Desktop/combos.bin\n"
+    "\n"
+    "-r             Reverse the conversion: read a binary table and write a .csv.\n"
+    "               Example: -r -i ./combos.bin -d ./combos.csv\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "destination",    required_argument,  0,  'd' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        { "reverse",        no_argument,        0,  'r' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string infile;
+    string outfile;
+    bool debug = false;
+    bool reverse = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:d:hvr", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                infile = optarg;
+                continue;
+
+            case 'd':
+                outfile = optarg;
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case 'r':
+                reverse = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    if (infile.empty())
+        infile = reverse ? "./combos.bin" : "./combos.csv";
+    if (outfile.empty())
+        outfile = reverse ? "./combos.csv" : "./combos.bin";
+
+    try
+    {
+        return reverse ? bin_to_csv(infile, outfile, debug) : csv_to_bin(infile, outfile, debug);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+}
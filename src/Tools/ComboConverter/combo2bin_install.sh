@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ -std=c++17 -pthread -o combo2bin ./combo2bin.cpp
\ No newline at end of file
@@ -0,0 +1,386 @@
+///////////////////////////////////////////////////////////////////////////////////////
+// Adaptive design: choose the next combos to run from the results of completed runs //
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "design.hpp"
+#include "kdtree.hpp"
+#include "sequences.hpp"
+#include "../../../Parallelisation/Cpp/includes/csv.h"
+#include "../../../Parallelisation/Cpp/includes/slimbin.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+
+// Mean response of each combo across its seeds, keyed by modelindex (the combo's 1-based row in the combos file)
+struct Response
+{
+    double sum = 0.0;
+    size_t count = 0;
+    double generation = -INFINITY;
+};
+
+// Pull the 1-based column col out of a SLiM output line without splitting the whole line
+bool field(const char *line, size_t col, double &value)
+{
+    for (size_t c = 1; c < col; ++c)
+    {
+        line = std::strchr(line, ',');
+        if (!line)
+            return false;
+        ++line;
+    }
+    const char *end = line + std::strcspn(line, ",");
+    auto res = std::from_chars(line, end, value);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+// Read a headerless SLiM output file (generation first, then seed and modelindex, as the models write them).
+// Each combo's response is its mean over seeds, at generation gen, or at the latest generation it has reached
+std::unordered_map<size_t, Response> read_responses(const string &filename, size_t modelCol, size_t yCol, double gen)
+{
+    std::unordered_map<size_t, Response> responses;
+    io::LineReader in(filename);
+
+    while (char *line = in.next_line())
+    {
+        double generation, model, y;
+        if (!field(line, 1, generation) || !field(line, modelCol, model) || !field(line, yCol, y))
+            continue;   // Skips headers, blank lines and short rows from other phases of the model
+        if (!std::isnan(gen) && generation != gen)
+            continue;
+
+        Response &r = responses[size_t(model)];
+        if (generation > r.generation)
+        {
+            r = Response();
+            r.generation = generation;
+        }
+        if (generation == r.generation)
+        {
+            r.sum += y;
+            ++r.count;
+        }
+    }
+    return responses;
+}
+
+size_t count_columns(const string &filename)
+{
+    if (slimbin::isBinary(filename))
+        return slimbin::Reader(filename).cols();
+    std::ifstream infile(filename);
+    string header;
+    std::getline(infile, header);
+    return std::count(header.begin(), header.end(), ',') + 1;
+}
+
+struct Candidate
+{
+    double spread = 0.0;    // Weighted sd of the neighbouring combos' responses
+    double gap = 0.0;       // Distance to the nearest combo, run or queued
+    double score = 0.0;
+    bool picked = false;
+};
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "Adaptive Design Generator\n"
+    "\n"
+    "This program reads the results of completed runs, fits a k-nearest-neighbour surrogate over the parameter space,\n"
+    "and appends new combos to the combos file where the surrogate is most uncertain or least explored.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./combos.csv -r ./out_slim1T_means.csv -y 6 -n 20\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-i FILEPATH    The combos file (.csv or binary) to extend. Every column must be a numeric factor. Defaults to ./combos.csv.\n"
+    "\n"
+    "-r FILEPATH    SLiM output file with results. Defaults to ./out_slim1T_means.csv.\n"
+    "\n"
+    "-m COL         Column of the output holding the modelindex (the combo's row number). Defaults to 3.\n"
+    "\n"
+    "-y COL         Column of the output holding the response to model. Defaults to 6 (phenomean).\n"
+    "\n"
+    "-g GEN         Use responses at this generation. Defaults to the latest generation each combo has reached.\n"
+    "\n"
+    "-f LIST        Factors and their ranges, as name=min:max delimited by commas. Defaults to the observed ranges.\n"
+    "\n"
+    "-n N           Number of combos to add. Defaults to 10.\n"
+    "\n"
+    "-k K           Number of neighbours in the surrogate. Defaults to 5.\n"
+    "\n"
+    "-e W           Weight on exploring unsampled space, relative to surrogate uncertainty. Defaults to 1.\n"
+    "\n"
+    "-c N           Number of candidate points to score. Defaults to 200 per combo added.\n"
+    "\n"
+    "-s SEED        Seed for the candidate points. Defaults to a random seed from /dev/random.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "results",        required_argument,  0,  'r' },
+        { "model-col",      required_argument,  0,  'm' },
+        { "response-col",   required_argument,  0,  'y' },
+        { "generation",     required_argument,  0,  'g' },
+        { "factors",        required_argument,  0,  'f' },
+        { "nnew",           required_argument,  0,  'n' },
+        { "neighbours",     required_argument,  0,  'k' },
+        { "explore",        required_argument,  0,  'e' },
+        { "candidates",     required_argument,  0,  'c' },
+        { "seed",           required_argument,  0,  's' },
+        { "threads",        required_argument,  0,  'T' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string combosFile = "./combos.csv";
+    string resultsFile = "./out_slim1T_means.csv";
+    size_t modelCol = 3;
+    size_t yCol = 6;
+    double gen = NAN;
+    string factorSpec;
+    size_t n_new = 10;
+    size_t k = 5;
+    double explore = 1.0;
+    size_t n_candidates = 0;
+    uint64_t seed = std::random_device()();
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:r:m:y:g:f:n:k:e:c:s:T:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                combosFile = optarg;
+                continue;
+
+            case 'r':
+                resultsFile = optarg;
+                continue;
+
+            case 'm':
+                modelCol = std::stoul(optarg);
+                continue;
+
+            case 'y':
+                yCol = std::stoul(optarg);
+                continue;
+
+            case 'g':
+                gen = std::stod(optarg);
+                continue;
+
+            case 'f':
+                factorSpec = optarg;
+                continue;
+
+            case 'n':
+                n_new = std::stoul(optarg);
+                continue;
+
+            case 'k':
+                k = std::stoul(optarg);
+                continue;
+
+            case 'e':
+                explore = std::stod(optarg);
+                continue;
+
+            case 'c':
+                n_candidates = std::stoul(optarg);
+                continue;
+
+            case 's':
+                seed = std::stoull(optarg);
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    if (n_candidates == 0)
+        n_candidates = 200 * n_new;
+
+    try
+    {
+        vector<Factor> factors;
+        if (!factorSpec.empty())
+            factors = parse_factors(factorSpec);
+        Design design = read_design(combosFile, factors);
+        if (count_columns(combosFile) != factors.size())
+            throw std::invalid_argument(combosFile + " has columns that aren't factors, so new rows can't be appended to it");
+
+        std::unordered_map<size_t, Response> responses = read_responses(resultsFile, modelCol, yCol, gen);
+
+        // Completed combos and their mean responses make up the surrogate's training set
+        vector<size_t> done;
+        for (size_t i = 0; i < design.n; ++i)
+        {
+            auto it = responses.find(i + 1);
+            if (it != responses.end() && it->second.count)
+                done.push_back(i);
+        }
+        if (done.size() < 2)
+            throw std::invalid_argument("Need results for at least 2 combos to fit a surrogate, found " + std::to_string(done.size()));
+
+        Design trained(done.size(), design.k);
+        vector<double> y(done.size());
+        double ySum = 0.0, ySq = 0.0;
+        for (size_t t = 0; t < done.size(); ++t)
+        {
+            std::copy(design.row(done[t]), design.row(done[t]) + design.k, trained.row(t));
+            const Response &r = responses[done[t] + 1];
+            y[t] = r.sum / r.count;
+            ySum += y[t];
+            ySq += y[t] * y[t];
+        }
+        double ySd = std::sqrt(std::max(ySq / y.size() - std::pow(ySum / y.size(), 2), 0.0));
+        if (ySd == 0.0)
+            ySd = 1.0;
+        k = std::min(k, done.size());
+
+        KDTree trainedTree(trained);
+        KDTree designTree(design);
+
+        // Typical spacing of the existing design, so the exploration term is on the same scale as the spread term
+        double typical = 0.0;
+        {
+            vector<size_t> idx;
+            vector<double> d2;
+            #pragma omp parallel for reduction(+:typical) private(idx, d2)
+            for (size_t i = 0; i < design.n; ++i)
+            {
+                designTree.nearest(design.row(i), 1, idx, d2, i);
+                typical += idx.empty() ? 0.0 : std::sqrt(d2[0]);
+            }
+            typical = design.n > 1 ? typical / design.n : 1.0;
+            if (typical == 0.0)
+                typical = 1.0;
+        }
+
+        // Candidates are a scrambled Sobol sample of the whole space, scored in parallel:
+        // the inverse-distance weighted sd of the k nearest responses, plus the distance to the nearest combo.
+        // Each round starts further along the sequence (the combos file grows every round), so a round run with the same
+        // seed as the last doesn't score the same points again
+        Design cands(n_candidates, design.k);
+        SobolSequence(design.k, true, seed).fill(cands, uint64_t(design.n) * n_candidates);
+        vector<Candidate> scored(n_candidates);
+
+        #pragma omp parallel
+        {
+            vector<size_t> idx;
+            vector<double> d2;
+
+            #pragma omp for schedule(dynamic, 64)
+            for (size_t c = 0; c < n_candidates; ++c)
+            {
+                trainedTree.nearest(cands.row(c), k, idx, d2);
+                double wSum = 0.0, mean = 0.0, sq = 0.0;
+                for (size_t i = 0; i < idx.size(); ++i)
+                {
+                    double w = 1.0 / (std::sqrt(d2[i]) + 1e-12);
+                    wSum += w;
+                    mean += w * y[idx[i]];
+                    sq += w * y[idx[i]] * y[idx[i]];
+                }
+                mean /= wSum;
+                scored[c].spread = std::sqrt(std::max(sq / wSum - mean * mean, 0.0)) / ySd;
+
+                designTree.nearest(cands.row(c), 1, idx, d2);
+                scored[c].gap = std::sqrt(d2[0]) / typical;
+            }
+        }
+
+        // Pick greedily, each candidate at most once, shrinking the gap of candidates near each pick so new combos don't
+        // all land in one spot
+        Design picked(std::min(n_new, n_candidates), design.k);
+        for (size_t p = 0; p < picked.n; ++p)
+        {
+            size_t best = n_candidates;
+            for (size_t c = 0; c < n_candidates; ++c)
+            {
+                if (scored[c].picked)
+                    continue;
+                scored[c].score = scored[c].spread + explore * scored[c].gap;
+                if (best == n_candidates || scored[c].score > scored[best].score)
+                    best = c;
+            }
+            scored[best].picked = true;
+            std::copy(cands.row(best), cands.row(best) + design.k, picked.row(p));
+            if (debug)
+                cout << "New combo " << design.n + p + 1 << ": spread " << scored[best].spread << ", gap " << scored[best].gap << endl;
+
+            #pragma omp parallel for
+            for (size_t c = 0; c < n_candidates; ++c)
+            {
+                double d = 0.0;
+                for (size_t j = 0; j < design.k; ++j)
+                    d += std::pow(cands.row(c)[j] - picked.row(p)[j], 2);
+                scored[c].gap = std::min(scored[c].gap, std::sqrt(d) / typical);
+            }
+        }
+
+        write_design(combosFile, picked, factors, slimbin::isBinary(combosFile), true);
+
+        if (debug)
+            cout << "Fitted to " << done.size() << " of " << design.n << " combos, appended " << picked.n << " combos to " << combosFile << endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,237 @@
+// Shared pieces of the design generators: factor parsing and writing designs out as combos
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "design.hpp"
+#include "../../../Parallelisation/Cpp/includes/csv.h"
+#include "../../../Parallelisation/Cpp/includes/parse.h"
+#include "../../../Parallelisation/Cpp/includes/slimbin.h"
+
+using std::string;
+using std::vector;
+
+namespace
+{
+    bool parse_double(const string &field, double &value)
+    {
+        const char *end = field.data() + field.size();
+        auto res = std::from_chars(field.data(), end, value);
+        return !field.empty() && res.ec == std::errc() && res.ptr == end;
+    }
+
+    // Fill in observed ranges for factors read without a given range, then map the design into [0, 1]
+    void to_unit(Design &design, vector<Factor> &factors, bool observed)
+    {
+        for (size_t j = 0; j < design.k; ++j)
+        {
+            Factor &f = factors[j];
+            if (observed && design.n)
+            {
+                f.min = f.max = design.row(0)[j];
+                for (size_t i = 1; i < design.n; ++i)
+                {
+                    f.min = std::min(f.min, design.row(i)[j]);
+                    f.max = std::max(f.max, design.row(i)[j]);
+                }
+            }
+            double range = f.max > f.min ? f.max - f.min : 1.0;
+            for (size_t i = 0; i < design.n; ++i)
+                design.row(i)[j] = (design.row(i)[j] - f.min) / range;
+        }
+    }
+}
+
+vector<Factor> parse_factors(const string &spec)
+{
+    vector<Factor> factors;
+    std::stringstream ss(spec);
+    string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        size_t eq = item.find('=');
+        size_t colon = item.find(':', eq);
+        if (eq == string::npos || colon == string::npos)
+            throw std::invalid_argument("Factor '" + item + "' should look like name=min:max");
+
+        Factor f;
+        f.name = item.substr(0, eq);
+        f.min = std::stod(item.substr(eq + 1, colon - eq - 1));
+        f.max = std::stod(item.substr(colon + 1));
+        factors.emplace_back(f);
+    }
+
+    if (factors.empty())
+        throw std::invalid_argument("No factors given");
+    return factors;
+}
+
+void write_design(const string &filename, const Design &design, const vector<Factor> &factors, bool binary, bool append)
+{
+    if (binary)
+    {
+        vector<slimbin::Column> columns;
+        for (const Factor &f : factors)
+            columns.push_back({f.name, slimbin::F64});
+
+        slimbin::Writer out(filename, columns, append);
+        for (size_t i = 0; i < design.n; ++i)
+        {
+            for (size_t j = 0; j < design.k; ++j)
+                out.set(j, factors[j].min + design.row(i)[j] * (factors[j].max - factors[j].min));
+            out.endRow();
+        }
+        out.close();
+        return;
+    }
+
+    bool writeHeader = true;
+    bool needNewline = false;
+    if (append)
+    {
+        std::ifstream existing(filename, std::ios::binary | std::ios::ate);
+        writeHeader = !existing || existing.tellg() <= 0;
+        if (!writeHeader)
+        {
+            // Files written by hand or by write.csv may not end in a newline
+            existing.seekg(-1, std::ios::end);
+            needNewline = existing.get() != '\n';
+        }
+    }
+
+    std::ofstream outfile(filename, append ? std::ios::app : std::ios::trunc);
+    if (!outfile)
+        throw std::runtime_error("Can't open " + filename + " for writing");
+    if (needNewline)
+        outfile << "\n";
+
+    if (writeHeader)
+    {
+        for (size_t j = 0; j < factors.size(); ++j)
+            outfile << (j ? "," : "") << factors[j].name;
+        outfile << "\n";
+    }
+
+    // Format into one buffer per row: shortest round-trip representation of each value
+    string line;
+    char buf[32];
+    for (size_t i = 0; i < design.n; ++i)
+    {
+        line.clear();
+        for (size_t j = 0; j < design.k; ++j)
+        {
+            double value = factors[j].min + design.row(i)[j] * (factors[j].max - factors[j].min);
+            auto res = std::to_chars(buf, buf + sizeof(buf), value);
+            if (j)
+                line += ',';
+            line.append(buf, res.ptr - buf);
+        }
+        line += '\n';
+        outfile << line;
+    }
+}
+
+Design read_design(const string &filename, vector<Factor> &factors)
+{
+    const bool observed = factors.empty();
+    Design design;
+
+    if (slimbin::isBinary(filename))
+    {
+        slimbin::Reader in(filename);
+        vector<size_t> cols;
+        if (observed)
+        {
+            for (size_t c = 0; c < in.cols(); ++c)
+                if (in.column(c).type != slimbin::STR)
+                {
+                    cols.push_back(c);
+                    factors.push_back({in.column(c).name});
+                }
+        }
+        else
+        {
+            for (const Factor &f : factors)
+            {
+                int c = in.find(f.name);
+                if (c < 0 || in.column(c).type == slimbin::STR)
+                    throw std::invalid_argument(filename + " has no numeric column " + f.name);
+                cols.push_back(c);
+            }
+        }
+
+        design = Design(in.rows(), cols.size());
+        for (size_t i = 0; i < design.n; ++i)
+            for (size_t j = 0; j < cols.size(); ++j)
+                design.row(i)[j] = in.getF64(i, cols[j]);
+        to_unit(design, factors, observed);
+        return design;
+    }
+
+    io::LineReader in(filename);
+    char *line = in.next_line();
+    if (!line)
+        throw std::invalid_argument(filename + " is empty");
+    vector<string> header = splitLine(line);
+
+    // Without factors we don't know which columns are numeric until we've seen the data, so read everything first
+    vector<size_t> cols;
+    if (observed)
+    {
+        for (size_t c = 0; c < header.size(); ++c)
+            if (!header[c].empty())  // Skip the unnamed row name column from R's write.csv
+                cols.push_back(c);
+    }
+    else
+    {
+        for (const Factor &f : factors)
+        {
+            auto it = std::find(header.begin(), header.end(), f.name);
+            if (it == header.end())
+                throw std::invalid_argument(filename + " has no column " + f.name);
+            cols.push_back(it - header.begin());
+        }
+    }
+
+    vector<double> values;
+    vector<bool> numeric(cols.size(), true);
+    size_t rows = 0;
+    while ((line = in.next_line()))
+    {
+        if (!*line)
+            continue;
+        vector<string> fields = splitLine(line);
+        if (fields.size() != header.size())
+            throw std::invalid_argument(filename + ":" + std::to_string(in.get_file_line()) + " has the wrong number of columns");
+        for (size_t j = 0; j < cols.size(); ++j)
+        {
+            double value = 0.0;
+            if (!parse_double(fields[cols[j]], value))
+            {
+                if (!observed)
+                    throw std::invalid_argument(filename + ":" + std::to_string(in.get_file_line()) + " " + factors[j].name + " isn't a number");
+                numeric[j] = false;
+            }
+            values.push_back(value);
+        }
+        ++rows;
+    }
+
+    vector<size_t> keep;
+    for (size_t j = 0; j < cols.size(); ++j)
+        if (numeric[j])
+        {
+            keep.push_back(j);
+            if (observed)
+                factors.push_back({header[cols[j]]});
+        }
+
+    design = Design(rows, keep.size());
+    for (size_t i = 0; i < rows; ++i)
+        for (size_t j = 0; j < keep.size(); ++j)
+            design.row(i)[j] = values[i * cols.size() + keep[j]];
+    to_unit(design, factors, observed);
+    return design;
+}
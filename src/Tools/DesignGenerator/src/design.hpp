@@ -0,0 +1,38 @@
+#include <string>
+#include <vector>
+#pragma once
+
+// A factor to sample, and the range its values are scaled to (as in lhs.design's factor.names)
+struct Factor
+{
+    std::string name;
+    double min = 0.0;
+    double max = 1.0;
+};
+
+// A design in the unit hypercube: n rows of k values, stored row-major so a whole point is contiguous
+struct Design
+{
+    size_t n = 0;
+    size_t k = 0;
+    std::vector<double> x;
+
+    Design() = default;
+    Design(size_t rows, size_t cols) : n(rows), k(cols), x(rows * cols) {}
+
+    double *row(size_t i) { return &x[i * k]; }
+    const double *row(size_t i) const { return &x[i * k]; }
+};
+
+// Parse a factor list of the form "param1=0:1,param2=100:20000"
+std::vector<Factor> parse_factors(const std::string &spec);
+
+// Scale a unit design to the factor ranges and write it in the combos.csv format read by run_slim and RGenerator:
+// a header of factor names and one row per run. With binary set, write a slimbin table instead.
+// With append set, rows are added to the end of an existing file (and the header is only written for a new one)
+void write_design(const std::string &filename, const Design &design, const std::vector<Factor> &factors, bool binary, bool append = false);
+
+
+// Read the factor columns of a combos .csv or binary table, mapped back into the unit hypercube.
+// If factors is empty, every numeric column is read and given its observed range
+Design read_design(const std::string &filename, std::vector<Factor> &factors);
@@ -0,0 +1,358 @@
+///////////////////////////////////////////////////////////////////////////////////////
+// Design diagnostics: space-filling and uniformity checks for a combos file          //
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "design.hpp"
+#include "kdtree.hpp"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+
+// Hickernell's centered L2 discrepancy: how far the design is from uniform across every sub-box anchored at a
+// corner of the cube, with lower being more uniform. The pair sum is O(n^2 k), so it's done on column-major
+// copies of the design, a block of partner points at a time, so the inner loop vectorises
+double centered_l2(const Design &design)
+{
+    const size_t n = design.n, k = design.k;
+    vector<double> x(n * k), z(n * k);
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < k; ++j)
+        {
+            x[j * n + i] = design.row(i)[j];
+            z[j * n + i] = std::abs(design.row(i)[j] - 0.5);
+        }
+
+    double single = 0.0;
+    double pairs = 0.0;
+    const size_t blockSize = 256;
+
+    #pragma omp parallel reduction(+:single, pairs)
+    {
+        vector<double> prod(blockSize);
+
+        #pragma omp for schedule(dynamic, 16)
+        for (size_t i = 0; i < n; ++i)
+        {
+            double s = 1.0, diag = 1.0;
+            for (size_t j = 0; j < k; ++j)
+            {
+                double zi = z[j * n + i];
+                s *= 1.0 + 0.5 * zi - 0.5 * zi * zi;
+                diag *= 1.0 + zi;
+            }
+            single += s;
+            pairs += diag;
+
+            // Pairs (i, l) for l > i, counted twice for symmetry
+            for (size_t begin = i + 1; begin < n; begin += blockSize)
+            {
+                size_t len = std::min(blockSize, n - begin);
+                std::fill(prod.begin(), prod.begin() + len, 1.0);
+                for (size_t j = 0; j < k; ++j)
+                {
+                    const double xi = x[j * n + i], zi = z[j * n + i];
+                    const double *xl = &x[j * n + begin];
+                    const double *zl = &z[j * n + begin];
+                    for (size_t l = 0; l < len; ++l)
+                        prod[l] *= 1.0 + 0.5 * zi + 0.5 * zl[l] - 0.5 * std::abs(xi - xl[l]);
+                }
+                double sum = 0.0;
+                for (size_t l = 0; l < len; ++l)
+                    sum += prod[l];
+                pairs += 2.0 * sum;
+            }
+        }
+    }
+
+    double cd2 = std::pow(13.0 / 12.0, k) - 2.0 / n * single + pairs / (double(n) * n);
+    return std::sqrt(std::max(cd2, 0.0));
+}
+
+struct Spacing
+{
+    double minDist = INFINITY;
+    double meanNN = 0.0;    // Mean distance from each point to its nearest neighbour
+    size_t a = 0;           // Closest pair of rows
+    size_t b = 0;
+};
+
+// Nearest neighbour of every point from a k-d tree, queried in parallel: O(n log n) for the
+// low-dimensional designs we sample, rather than comparing every pair
+Spacing spacing(const Design &design)
+{
+    KDTree tree(design);
+    Spacing result;
+    double sumNN = 0.0;
+
+    #pragma omp parallel
+    {
+        Spacing local;
+        vector<size_t> idx;
+        vector<double> d2;
+
+        #pragma omp for reduction(+:sumNN) schedule(dynamic, 256)
+        for (size_t i = 0; i < design.n; ++i)
+        {
+            tree.nearest(design.row(i), 1, idx, d2, i);
+            if (idx.empty())
+                continue;
+            double d = std::sqrt(d2[0]);
+            sumNN += d;
+            if (d < local.minDist)
+            {
+                local.minDist = d;
+                local.a = std::min(i, idx[0]);
+                local.b = std::max(i, idx[0]);
+            }
+        }
+
+        #pragma omp critical
+        if (local.minDist < result.minDist)
+            result = local;
+    }
+    result.meanNN = design.n ? sumNN / design.n : 0.0;
+    return result;
+}
+
+// Pearson correlations between every pair of factors, as cor() does in R
+vector<double> correlations(const Design &design)
+{
+    const size_t n = design.n, k = design.k;
+    vector<double> mean(k, 0.0), cov(k * k, 0.0);
+
+    for (size_t j = 0; j < k; ++j)
+    {
+        double sum = 0.0;
+        #pragma omp parallel for reduction(+:sum)
+        for (size_t i = 0; i < n; ++i)
+            sum += design.row(i)[j];
+        mean[j] = sum / n;
+    }
+
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (size_t a = 0; a < k; ++a)
+        for (size_t b = 0; b < k; ++b)
+        {
+            if (b < a)
+                continue;
+            double sum = 0.0;
+            for (size_t i = 0; i < n; ++i)
+                sum += (design.row(i)[a] - mean[a]) * (design.row(i)[b] - mean[b]);
+            cov[a * k + b] = cov[b * k + a] = sum;
+        }
+
+    vector<double> cor(k * k);
+    for (size_t a = 0; a < k; ++a)
+        for (size_t b = 0; b < k; ++b)
+            cor[a * k + b] = cov[a * k + b] / std::sqrt(cov[a * k + a] * cov[b * k + b]);
+    return cor;
+}
+
+// Kolmogorov-Smirnov distance of each factor from a uniform distribution: the histogram check, as a number
+vector<double> ks_uniform(const Design &design)
+{
+    vector<double> ks(design.k);
+
+    #pragma omp parallel for
+    for (size_t j = 0; j < design.k; ++j)
+    {
+        vector<double> col(design.n);
+        for (size_t i = 0; i < design.n; ++i)
+            col[i] = design.row(i)[j];
+        std::sort(col.begin(), col.end());
+
+        double d = 0.0;
+        for (size_t i = 0; i < col.size(); ++i)
+            d = std::max({d, (i + 1.0) / col.size() - col[i], col[i] - double(i) / col.size()});
+        ks[j] = d;
+    }
+    return ks;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "Design Diagnostics\n"
+    "\n"
+    "This program checks how well a combos file fills its parameter space, and writes a .csv report of:\n"
+    "centered L2 discrepancy, minimum and mean nearest neighbour distance, correlations between factors,\n"
+    "and the Kolmogorov-Smirnov distance of each factor from uniform. Distances are measured in the unit hypercube.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./combos.csv -f \"param1=0:1,param2=100:20000\" -C 0.05\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-i FILEPATH    The combos file (.csv or binary) to check. Defaults to ./combos.csv.\n"
+    "\n"
+    "-f LIST        Factors to check and their ranges, as name=min:max delimited by commas.\n"
+    "               Defaults to every numeric column, scaled by its observed range.\n"
+    "\n"
+    "-C R           Fail (exit status 2) if any correlation between factors is larger than R in magnitude.\n"
+    "\n"
+    "-D D           Fail (exit status 2) if the minimum distance between points is smaller than D.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-d FILEPATH    Specify a filepath for the report. Defaults to the terminal.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "factors",        required_argument,  0,  'f' },
+        { "max-cor",        required_argument,  0,  'C' },
+        { "min-dist",       required_argument,  0,  'D' },
+        { "threads",        required_argument,  0,  'T' },
+        { "destination",    required_argument,  0,  'd' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string infile = "./combos.csv";
+    string outfile;
+    string factorSpec;
+    double maxCor = INFINITY;
+    double minDist = 0.0;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:f:C:D:T:d:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                infile = optarg;
+                continue;
+
+            case 'f':
+                factorSpec = optarg;
+                continue;
+
+            case 'C':
+                maxCor = std::stod(optarg);
+                continue;
+
+            case 'D':
+                minDist = std::stod(optarg);
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'd':
+                outfile = optarg;
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        vector<Factor> factors;
+        if (!factorSpec.empty())
+            factors = parse_factors(factorSpec);
+        Design design = read_design(infile, factors);
+        if (design.n < 2 || design.k == 0)
+            throw std::invalid_argument(infile + " needs at least 2 rows of numeric factors to check");
+
+        double cd2 = centered_l2(design);
+        Spacing space = spacing(design);
+        vector<double> cor = correlations(design);
+        vector<double> ks = ks_uniform(design);
+
+        std::ofstream file;
+        if (!outfile.empty())
+            file.open(outfile);
+        std::ostream &out = outfile.empty() ? cout : file;
+
+        // Long format, so the report reads straight into R or a script regardless of how many factors there are
+        out << "metric,factor1,factor2,value\n"
+            << "rows,,," << design.n << "\n"
+            << "factors,,," << design.k << "\n"
+            << "centered_l2_discrepancy,,," << cd2 << "\n"
+            << "min_distance,,," << space.minDist << "\n"
+            << "mean_nn_distance,,," << space.meanNN << "\n"
+            << "closest_pair,row,row," << space.a + 1 << ";" << space.b + 1 << "\n";
+
+        double worstCor = 0.0;
+        for (size_t a = 0; a < design.k; ++a)
+            for (size_t b = a + 1; b < design.k; ++b)
+            {
+                out << "correlation," << factors[a].name << "," << factors[b].name << "," << cor[a * design.k + b] << "\n";
+                worstCor = std::max(worstCor, std::abs(cor[a * design.k + b]));
+            }
+        for (size_t j = 0; j < design.k; ++j)
+            out << "ks_uniform," << factors[j].name << ",," << ks[j] << "\n";
+        out.flush();
+
+        if (debug)
+        {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cerr << "Checked " << design.n << " rows of " << design.k << " factors from " << infile
+                      << " in " << elapsed.count() << " seconds on " << omp_get_max_threads() << " threads" << endl;
+        }
+
+        bool failed = false;
+        if (worstCor > maxCor)
+        {
+            std::cerr << "FAIL: largest correlation " << worstCor << " is above " << maxCor << endl;
+            failed = true;
+        }
+        if (space.minDist < minDist)
+        {
+            std::cerr << "FAIL: minimum distance " << space.minDist << " is below " << minDist << endl;
+            failed = true;
+        }
+        if (failed)
+            return 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
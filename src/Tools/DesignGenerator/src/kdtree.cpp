@@ -0,0 +1,116 @@
+// k-d tree nearest neighbour search
+#include <algorithm>
+#include <queue>
+#include "kdtree.hpp"
+
+using std::vector;
+
+namespace
+{
+    const size_t LEAF_SIZE = 16;
+}
+
+KDTree::KDTree(const Design &design) : _design(design), _order(design.n)
+{
+    for (size_t i = 0; i < design.n; ++i)
+        _order[i] = i;
+    if (design.n)
+        build(0, design.n);
+}
+
+// Split on the dimension with the widest spread, at the median, so the tree stays balanced
+int KDTree::build(size_t begin, size_t end)
+{
+    int id = _nodes.size();
+    _nodes.push_back({begin, end});
+    if (end - begin <= LEAF_SIZE)
+        return id;
+
+    size_t dim = 0;
+    double widest = -1.0;
+    for (size_t j = 0; j < _design.k; ++j)
+    {
+        double lo = _design.row(_order[begin])[j], hi = lo;
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            double v = _design.row(_order[i])[j];
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+        if (hi - lo > widest)
+        {
+            widest = hi - lo;
+            dim = j;
+        }
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    std::nth_element(_order.begin() + begin, _order.begin() + mid, _order.begin() + end,
+                     [&](size_t a, size_t b) { return _design.row(a)[dim] < _design.row(b)[dim]; });
+
+    _nodes[id].dim = dim;
+    _nodes[id].split = _design.row(_order[mid])[dim];
+    int left = build(begin, mid);
+    int right = build(mid, end);
+    _nodes[id].left = left;
+    _nodes[id].right = right;
+    return id;
+}
+
+void KDTree::nearest(const double *x, size_t k, vector<size_t> &idx, vector<double> &d2, size_t exclude) const
+{
+    // Max-heap of the best k so far, so the current k-th best distance is always on top
+    std::priority_queue<std::pair<double, size_t>> best;
+    vector<std::pair<int, double>> stack;  // Node and a lower bound on its distance from x
+    if (!_nodes.empty())
+        stack.push_back({0, 0.0});
+
+    while (!stack.empty())
+    {
+        auto [id, bound] = stack.back();
+        stack.pop_back();
+        if (best.size() == k && bound >= best.top().first)
+            continue;
+
+        const Node &node = _nodes[id];
+        if (node.left < 0)
+        {
+            for (size_t i = node.begin; i < node.end; ++i)
+            {
+                size_t p = _order[i];
+                if (p == exclude)
+                    continue;
+                const double *row = _design.row(p);
+                double dist = 0.0;
+                for (size_t j = 0; j < _design.k; ++j)
+                {
+                    double u = row[j] - x[j];
+                    dist += u * u;
+                }
+                if (best.size() < k)
+                    best.push({dist, p});
+                else if (dist < best.top().first)
+                {
+                    best.pop();
+                    best.push({dist, p});
+                }
+            }
+            continue;
+        }
+
+        // Visit the side x is on first, and only visit the far side if it could still hold something closer
+        double diff = x[node.dim] - node.split;
+        int nearSide = diff < 0 ? node.left : node.right;
+        int farSide = diff < 0 ? node.right : node.left;
+        stack.push_back({farSide, std::max(bound, diff * diff)});
+        stack.push_back({nearSide, bound});
+    }
+
+    idx.resize(best.size());
+    d2.resize(best.size());
+    for (size_t i = best.size(); i-- > 0; best.pop())
+    {
+        d2[i] = best.top().first;
+        idx[i] = best.top().second;
+    }
+}
@@ -0,0 +1,35 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "design.hpp"
+#pragma once
+
+// k-d tree over the points of a design, for nearest neighbour queries in the unit hypercube.
+// The tree keeps a reference to the design, so the design has to outlive it
+class KDTree
+{
+public:
+    explicit KDTree(const Design &design);
+
+    // Indices and squared distances of the k points nearest to x, nearest first.
+    // The point with index exclude is skipped, so a design point can be queried against the rest
+    void nearest(const double *x, size_t k, std::vector<size_t> &idx, std::vector<double> &d2,
+                 size_t exclude = SIZE_MAX) const;
+
+private:
+    struct Node
+    {
+        size_t begin;
+        size_t end;
+        size_t dim = 0;
+        double split = 0.0;
+        int left = -1;      // Leaf if there are no children
+        int right = -1;
+    };
+
+    int build(size_t begin, size_t end);
+
+    const Design &_design;
+    std::vector<size_t> _order;   // Point indices, arranged so every node covers a contiguous range
+    std::vector<Node> _nodes;
+};
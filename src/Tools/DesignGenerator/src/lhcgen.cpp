@@ -0,0 +1,375 @@
+///////////////////////////////////////////////////////////////////////////////////////
+// Latin hypercube generator: random and maximin-optimised designs for parameter sweeps //
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "design.hpp"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+
+// Random Latin hypercube: each column is a random permutation of the n strata,
+// with each point jittered uniformly within its stratum
+Design random_lhc(size_t n, size_t k, std::mt19937_64 &rng)
+{
+    Design design(n, k);
+    std::uniform_real_distribution<double> jitter(0.0, 1.0);
+    vector<size_t> strata(n);
+
+    for (size_t j = 0; j < k; ++j)
+    {
+        for (size_t i = 0; i < n; ++i)
+            strata[i] = i;
+        std::shuffle(strata.begin(), strata.end(), rng);
+
+        for (size_t i = 0; i < n; ++i)
+            design.row(i)[j] = (strata[i] + jitter(rng)) / n;
+    }
+    return design;
+}
+
+// Morris & Mitchell's phi_p criterion is sum(d_ij^-p) over all pairs of points. For large p, minimising it
+// maximises the minimum distance, but unlike the minimum itself every pair contributes, so it responds
+// smoothly to small changes in the design. We work with squared distances, hence d2^(-p/2)
+inline double phi_term(double d2, double halfp)
+{
+    return std::pow(d2, -halfp);
+}
+
+inline double dist2(const double *a, const double *b, size_t k)
+{
+    double d2 = 0.0;
+    for (size_t j = 0; j < k; ++j)
+    {
+        double u = a[j] - b[j];
+        d2 += u * u;
+    }
+    return d2;
+}
+
+double phi_sum(const Design &design, double p)
+{
+    double sum = 0.0;
+    #pragma omp parallel for reduction(+:sum) schedule(dynamic, 64)
+    for (size_t i = 0; i < design.n; ++i)
+        for (size_t l = i + 1; l < design.n; ++l)
+            sum += phi_term(dist2(design.row(i), design.row(l), design.k), p / 2);
+    return sum;
+}
+
+double min_distance(const Design &design)
+{
+    double best = INFINITY;
+    #pragma omp parallel for reduction(min:best) schedule(dynamic, 64)
+    for (size_t i = 0; i < design.n; ++i)
+        for (size_t l = i + 1; l < design.n; ++l)
+            best = std::min(best, dist2(design.row(i), design.row(l), design.k));
+    return std::sqrt(best);
+}
+
+// Exchanging column c between rows a and b keeps every column a permutation of the strata, so the design stays a Latin hypercube
+struct Swap
+{
+    size_t col;
+    size_t a;
+    size_t b;
+    double delta;
+};
+
+// Change in phi_sum caused by a swap. Only the distances from a and b to the other points change
+// (the a-b distance itself doesn't), so a move costs O(nk) instead of the O(n^2 k) of a full evaluation
+double swap_delta(const Design &design, const Swap &s, double halfp)
+{
+    const double *ra = design.row(s.a);
+    const double *rb = design.row(s.b);
+    const double xa = ra[s.col];
+    const double xb = rb[s.col];
+    double delta = 0.0;
+
+    for (size_t i = 0; i < design.n; ++i)
+    {
+        if (i == s.a || i == s.b)
+            continue;
+        const double *ri = design.row(i);
+        double da2 = 0.0, db2 = 0.0, da2new = 0.0, db2new = 0.0;
+        for (size_t j = 0; j < design.k; ++j)
+        {
+            double ua = ra[j] - ri[j];
+            double ub = rb[j] - ri[j];
+            da2 += ua * ua;
+            db2 += ub * ub;
+            if (j == s.col)
+            {
+                ua = xb - ri[j];
+                ub = xa - ri[j];
+            }
+            da2new += ua * ua;
+            db2new += ub * ub;
+        }
+        delta += phi_term(da2new, halfp) - phi_term(da2, halfp) + phi_term(db2new, halfp) - phi_term(db2, halfp);
+    }
+    return delta;
+}
+
+// Simulated annealing over column swaps. Each iteration draws a batch of candidate swaps, evaluates them in parallel,
+// and takes the best one: always if it improves the design, otherwise with a probability that shrinks as we cool
+Design maximin_lhc(Design design, double p, size_t iterations, size_t candidates, double temp, std::mt19937_64 &rng, bool debug)
+{
+    const double halfp = p / 2;
+    double phi = phi_sum(design, p);
+    double bestPhi = phi;
+    double phiChecked = phi;
+    Design best = design;
+
+    // Cool geometrically to 1/1000th of the starting temperature over the run
+    const double cooling = std::pow(1e-3, 1.0 / std::max<size_t>(iterations, 1));
+    std::uniform_int_distribution<size_t> pickCol(0, design.k - 1);
+    std::uniform_int_distribution<size_t> pickRow(0, design.n - 1);
+    std::uniform_real_distribution<double> unif(0.0, 1.0);
+    vector<Swap> batch(candidates);
+    size_t accepted = 0;
+
+    for (size_t it = 0; it < iterations; ++it)
+    {
+        for (Swap &s : batch)
+        {
+            s.col = pickCol(rng);
+            s.a = pickRow(rng);
+            do
+                s.b = pickRow(rng);
+            while (s.b == s.a);
+        }
+
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t c = 0; c < batch.size(); ++c)
+            batch[c].delta = swap_delta(design, batch[c], halfp);
+
+        const Swap &s = *std::min_element(batch.begin(), batch.end(),
+                                          [](const Swap &l, const Swap &r) { return l.delta < r.delta; });
+
+        // Deltas are relative to the current phi so the temperature means the same thing at any scale
+        if (s.delta < 0 || unif(rng) < std::exp(-s.delta / (phi * temp)))
+        {
+            std::swap(design.row(s.a)[s.col], design.row(s.b)[s.col]);
+            phi += s.delta;
+            ++accepted;
+
+            // Removing the closest pair can shrink phi by many orders of magnitude, leaving the running total as mostly
+            // rounding error from the terms that were subtracted. Start again from a fresh sum when that happens
+            if (phi < phiChecked * 1e-6)
+            {
+                phi = phi_sum(design, p);
+                phiChecked = phi;
+            }
+            if (phi < bestPhi)
+            {
+                bestPhi = phi;
+                best.x = design.x;
+            }
+        }
+        temp *= cooling;
+
+        if (debug && (it + 1) % std::max<size_t>(iterations / 10, 1) == 0)
+            cout << "Iteration " << it + 1 << ": phi_p = " << std::pow(bestPhi, 1.0 / p) << ", " << accepted << " swaps accepted" << endl;
+    }
+    return best;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "Latin Hypercube Generator\n"
+    "\n"
+    "This program generates a Latin hypercube design and writes it as a combos .csv for run_slim and SLiM Runner.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -n 512 -f \"param1=0:1,param2=100:20000\" -m\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-n N           Number of runs (rows) in the design. Defaults to 512.\n"
+    "\n"
+    "-f LIST        Factors and their ranges, as name=min:max delimited by commas.\n"
+    "               Defaults to \"param1=0:1,param2=100:20000\".\n"
+    "\n"
+    "-m             Optimise the design towards maximin (maximise the minimum distance between points).\n"
+    "\n"
+    "-i N           Number of maximin optimisation iterations. Defaults to 10000.\n"
+    "\n"
+    "-c N           Candidate swaps evaluated (in parallel) per iteration. Defaults to 4 per thread.\n"
+    "\n"
+    "-p P           Exponent for the phi_p maximin criterion. Larger is closer to pure maximin. Defaults to 15.\n"
+    "\n"
+    "-a TEMP        Starting annealing temperature, as a fraction of phi_p. 0 is a pure greedy search. Defaults to 0.005.\n"
+    "\n"
+    "-s SEED        Seed for the design. Defaults to a random seed from /dev/random.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n"
+    "-b             Write a binary combos table instead of a .csv, for fast loading by run_slim.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-d FILEPATH    Specify a filepath and name for the design to be saved. Defaults to ./combos.csv.\n"
+    "               Example: -d ~/Desktop/combos.csv\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "destination",    required_argument,  0,  'd' },
+        { "nruns",          required_argument,  0,  'n' },
+        { "factors",        required_argument,  0,  'f' },
+        { "maximin",        no_argument,        0,  'm' },
+        { "iterations",     required_argument,  0,  'i' },
+        { "candidates",     required_argument,  0,  'c' },
+        { "phi-p",          required_argument,  0,  'p' },
+        { "anneal",         required_argument,  0,  'a' },
+        { "seed",           required_argument,  0,  's' },
+        { "threads",        required_argument,  0,  'T' },
+        { "binary",         no_argument,        0,  'b' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string filename;
+    size_t n_runs = 512;
+    string factorSpec = "param1=0:1,param2=100:20000";
+    bool maximin = false;
+    size_t iterations = 10000;
+    size_t candidates = 0;
+    double p = 15;
+    double temp = 0.005;
+    uint64_t seed = std::random_device()();
+    bool binary = false;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "d:n:f:mi:c:p:a:s:T:bhv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'd':
+                filename = optarg;
+                continue;
+
+            case 'n':
+                n_runs = std::stoul(optarg);
+                continue;
+
+            case 'f':
+                factorSpec = optarg;
+                continue;
+
+            case 'm':
+                maximin = true;
+                continue;
+
+            case 'i':
+                iterations = std::stoul(optarg);
+                continue;
+
+            case 'c':
+                candidates = std::stoul(optarg);
+                continue;
+
+            case 'p':
+                p = std::stod(optarg);
+                continue;
+
+            case 'a':
+                temp = std::stod(optarg);
+                continue;
+
+            case 's':
+                seed = std::stoull(optarg);
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'b':
+                binary = true;
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    if (filename.empty())
+        filename = binary ? "./combos.bin" : "./combos.csv";
+    if (candidates == 0)
+        candidates = 4 * omp_get_max_threads();
+
+    try
+    {
+        vector<Factor> factors = parse_factors(factorSpec);
+        if (n_runs < 2)
+            throw std::invalid_argument("A design needs at least 2 runs");
+
+        std::mt19937_64 rng(seed);
+        auto start = std::chrono::steady_clock::now();
+        Design design = random_lhc(n_runs, factors.size(), rng);
+
+        if (debug)
+        {
+            cout << "Design seed: " << seed << "\n"
+                 << "Runs = " << n_runs << ", factors = " << factors.size() << ", threads = " << omp_get_max_threads() << "\n"
+                 << "Initial minimum distance: " << min_distance(design) << endl;
+        }
+
+        if (maximin)
+            design = maximin_lhc(std::move(design), p, iterations, candidates, temp, rng, debug);
+
+        write_design(filename, design, factors, binary);
+
+        if (debug)
+        {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            cout << "Final minimum distance: " << min_distance(design) << "\n"
+                 << "Design written to: " << filename << " in " << elapsed.count() << " seconds" << endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////////////
+// Quasi-random sequence generator: extendable Sobol and Halton designs for sweeps     //
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "design.hpp"
+#include "sequences.hpp"
+#include "../../../Parallelisation/Cpp/includes/slimbin.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+
+// Number of design rows already in a combos file, so appending carries on from the next index
+uint64_t existing_rows(const string &filename)
+{
+    if (slimbin::isBinary(filename))
+        return slimbin::Reader(filename).rows();
+
+    std::ifstream infile(filename);
+    string line;
+    uint64_t rows = 0;
+    bool header = true;
+    while (std::getline(infile, line))
+    {
+        if (line.empty())
+            continue;
+        if (header)
+            header = false;
+        else
+            ++rows;
+    }
+    return rows;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "Quasi-Random Sequence Generator\n"
+    "\n"
+    "This program generates a scrambled Sobol or Halton design and writes it as a combos .csv for run_slim and SLiM Runner.\n"
+    "Each point only depends on the seed and its index, so a sweep can be grown by appending the next points with the same seed.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -n 1000 -f \"param1=0:1,param2=100:20000\" -s 1868057774 -a\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-q TYPE        Sequence to generate: sobol or halton. Defaults to sobol.\n"
+    "\n"
+    "-n N           Number of points (rows) to generate. Defaults to 512.\n"
+    "\n"
+    "-f LIST        Factors and their ranges, as name=min:max delimited by commas.\n"
+    "               Defaults to \"param1=0:1,param2=100:20000\".\n"
+    "\n"
+    "-s SEED        Seed for the scrambling. Use the same seed to extend an existing design.\n"
+    "               Defaults to a random seed from /dev/random.\n"
+    "\n"
+    "-a             Append to the destination file instead of overwriting it.\n"
+    "\n"
+    "-o N           Index of the first point to generate. Defaults to 0, or with -a the number of rows already in the file.\n"
+    "\n"
+    "-u             Don't scramble the sequence.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n"
+    "-b             Write a binary combos table instead of a .csv, for fast loading by run_slim.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-d FILEPATH    Specify a filepath and name for the design to be saved. Defaults to ./combos.csv.\n"
+    "               Example: -d ~/Desktop/combos.csv\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "destination",    required_argument,  0,  'd' },
+        { "sequence",       required_argument,  0,  'q' },
+        { "npoints",        required_argument,  0,  'n' },
+        { "factors",        required_argument,  0,  'f' },
+        { "seed",           required_argument,  0,  's' },
+        { "append",         no_argument,        0,  'a' },
+        { "offset",         required_argument,  0,  'o' },
+        { "unscrambled",    no_argument,        0,  'u' },
+        { "threads",        required_argument,  0,  'T' },
+        { "binary",         no_argument,        0,  'b' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string filename;
+    string sequence = "sobol";
+    size_t n_points = 512;
+    string factorSpec = "param1=0:1,param2=100:20000";
+    uint64_t seed = std::random_device()();
+    bool append = false;
+    int64_t offset = -1;
+    bool scramble = true;
+    bool binary = false;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "d:q:n:f:s:ao:uT:bhv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'd':
+                filename = optarg;
+                continue;
+
+            case 'q':
+                sequence = optarg;
+                continue;
+
+            case 'n':
+                n_points = std::stoul(optarg);
+                continue;
+
+            case 'f':
+                factorSpec = optarg;
+                continue;
+
+            case 's':
+                seed = std::stoull(optarg);
+                continue;
+
+            case 'a':
+                append = true;
+                continue;
+
+            case 'o':
+                offset = std::stoll(optarg);
+                continue;
+
+            case 'u':
+                scramble = false;
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'b':
+                binary = true;
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    if (filename.empty())
+        filename = binary ? "./combos.bin" : "./combos.csv";
+
+    try
+    {
+        vector<Factor> factors = parse_factors(factorSpec);
+        if (offset < 0)
+            offset = append ? existing_rows(filename) : 0;
+
+        auto start = std::chrono::steady_clock::now();
+        Design design(n_points, factors.size());
+
+        if (sequence == "sobol")
+            SobolSequence(factors.size(), scramble, seed).fill(design, offset);
+        else if (sequence == "halton")
+            HaltonSequence(factors.size(), scramble, seed).fill(design, offset);
+        else
+            throw std::invalid_argument("Unknown sequence '" + sequence + "', use sobol or halton");
+
+        write_design(filename, design, factors, binary, append);
+
+        if (debug)
+        {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            cout << "Sequence: " << sequence << (scramble ? " (scrambled)" : "") << ", seed: " << seed << "\n"
+                 << "Points " << offset << " to " << offset + n_points - 1 << ", factors = " << factors.size() << "\n"
+                 << "Design " << (append ? "appended" : "written") << " to: " << filename << " in " << elapsed.count() << " seconds" << endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
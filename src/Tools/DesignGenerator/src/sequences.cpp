@@ -0,0 +1,216 @@
+// Sobol and Halton sequence generation
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <omp.h>
+#include "sequences.hpp"
+
+using std::vector;
+
+namespace
+{
+    // Joe & Kuo new-joe-kuo-6.21201 parameters for dimensions 2 to 32: degree s of the primitive polynomial,
+    // its interior coefficients a, and the initial direction numbers m_1..m_s
+    struct SobolParams
+    {
+        int s;
+        uint32_t a;
+        uint32_t m[7];
+    };
+
+    const SobolParams JOE_KUO[] = {
+        {1, 0,  {1}},
+        {2, 1,  {1, 3}},
+        {3, 1,  {1, 3, 1}},
+        {3, 2,  {1, 1, 1}},
+        {4, 1,  {1, 1, 3, 3}},
+        {4, 4,  {1, 3, 5, 13}},
+        {5, 2,  {1, 1, 5, 5, 17}},
+        {5, 4,  {1, 1, 5, 5, 5}},
+        {5, 7,  {1, 1, 7, 11, 19}},
+        {5, 11, {1, 1, 5, 1, 1}},
+        {5, 13, {1, 1, 1, 3, 11}},
+        {5, 14, {1, 3, 5, 5, 31}},
+        {6, 1,  {1, 3, 3, 9, 7, 49}},
+        {6, 13, {1, 1, 1, 15, 21, 21}},
+        {6, 16, {1, 3, 1, 13, 27, 49}},
+        {6, 19, {1, 1, 1, 15, 7, 5}},
+        {6, 22, {1, 3, 1, 15, 13, 25}},
+        {6, 25, {1, 1, 5, 5, 19, 61}},
+        {7, 1,  {1, 3, 7, 11, 23, 15, 103}},
+        {7, 4,  {1, 3, 7, 13, 13, 15, 69}},
+        {7, 7,  {1, 1, 3, 13, 7, 35, 63}},
+        {7, 8,  {1, 3, 5, 9, 1, 25, 53}},
+        {7, 14, {1, 3, 1, 13, 9, 35, 107}},
+        {7, 19, {1, 3, 1, 5, 27, 61, 31}},
+        {7, 21, {1, 1, 5, 11, 19, 41, 61}},
+        {7, 28, {1, 3, 5, 3, 3, 13, 69}},
+        {7, 31, {1, 1, 7, 13, 1, 19, 1}},
+        {7, 32, {1, 3, 7, 5, 13, 19, 59}},
+        {7, 37, {1, 1, 3, 9, 25, 29, 41}},
+        {7, 41, {1, 3, 5, 13, 23, 1, 55}},
+        {7, 42, {1, 3, 7, 3, 13, 59, 17}},
+    };
+    static_assert(sizeof(JOE_KUO) / sizeof(JOE_KUO[0]) == SobolSequence::MAX_DIMS - 1, "Need Sobol parameters for every dimension after the first");
+
+    const uint32_t PRIMES[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+                               59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131};
+    static_assert(sizeof(PRIMES) / sizeof(PRIMES[0]) == HaltonSequence::MAX_DIMS, "Need a prime base for every Halton dimension");
+
+    // Apply a random lower-triangular binary matrix (unit diagonal) to the digits of v, most significant digit first
+    uint32_t linear_scramble(uint32_t v, const uint32_t *rows)
+    {
+        uint32_t out = 0;
+        for (int r = 0; r < SobolSequence::BITS; ++r)
+            out |= uint32_t(__builtin_parity(v & rows[r])) << (SobolSequence::BITS - 1 - r);
+        return out;
+    }
+
+    void check_dims(size_t dims, size_t max, const char *name)
+    {
+        if (dims == 0 || dims > max)
+            throw std::invalid_argument(std::string(name) + " sequences support 1 to " + std::to_string(max) + " factors");
+    }
+
+    const double TWO_POW_32 = 4294967296.0;
+}
+
+SobolSequence::SobolSequence(size_t dims, bool scramble, uint64_t seed)
+    : _dims(dims), _v(dims * BITS), _shift(dims, 0)
+{
+    check_dims(dims, MAX_DIMS, "Sobol");
+
+    // First dimension is the van der Corput sequence in base 2
+    for (int k = 0; k < BITS; ++k)
+        _v[k] = 1u << (BITS - 1 - k);
+
+    for (size_t d = 1; d < dims; ++d)
+    {
+        const SobolParams &par = JOE_KUO[d - 1];
+        uint32_t *v = &_v[d * BITS];
+        for (int k = 0; k < par.s; ++k)
+            v[k] = par.m[k] << (BITS - 1 - k);
+        for (int k = par.s; k < BITS; ++k)
+        {
+            v[k] = v[k - par.s] ^ (v[k - par.s] >> par.s);
+            for (int l = 1; l < par.s; ++l)
+                if ((par.a >> (par.s - 1 - l)) & 1)
+                    v[k] ^= v[k - l];
+        }
+    }
+
+    if (!scramble)
+        return;
+
+    std::mt19937_64 rng(seed);
+    uint32_t rows[BITS];
+    for (size_t d = 0; d < dims; ++d)
+    {
+        // Row r of the matrix keeps digits 0..r, with digit r always set so the matrix is invertible
+        for (int r = 0; r < BITS; ++r)
+        {
+            uint32_t lower = r == BITS - 1 ? ~0u : ~((1u << (BITS - 1 - r)) - 1);
+            rows[r] = (uint32_t(rng()) & lower) | (1u << (BITS - 1 - r));
+        }
+        for (int k = 0; k < BITS; ++k)
+            _v[d * BITS + k] = linear_scramble(_v[d * BITS + k], rows);
+        _shift[d] = uint32_t(rng());
+    }
+}
+
+void SobolSequence::point(uint64_t i, double *x) const
+{
+    if (i >> BITS)
+        throw std::out_of_range("Sobol index beyond 2^32");
+    uint32_t gray = i ^ (i >> 1);
+    for (size_t d = 0; d < _dims; ++d)
+    {
+        uint32_t value = _shift[d];
+        for (int k = 0; gray >> k; ++k)
+            if ((gray >> k) & 1)
+                value ^= _v[d * BITS + k];
+        x[d] = value / TWO_POW_32;
+    }
+}
+
+void SobolSequence::fill(Design &design, uint64_t first) const
+{
+    if ((first + design.n) >> BITS)
+        throw std::out_of_range("Sobol index beyond 2^32");
+    const size_t blockSize = 4096;
+    const size_t nblocks = (design.n + blockSize - 1) / blockSize;
+
+    // Each block starts from a directly computed point, then steps through Gray code order:
+    // consecutive Gray codes differ in one bit, the lowest set bit of the next index
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t b = 0; b < nblocks; ++b)
+    {
+        size_t begin = b * blockSize;
+        size_t end = std::min(design.n, begin + blockSize);
+        vector<uint32_t> state(_dims);
+
+        uint64_t i = first + begin;
+        uint32_t gray = i ^ (i >> 1);
+        for (size_t d = 0; d < _dims; ++d)
+        {
+            state[d] = _shift[d];
+            for (int k = 0; gray >> k; ++k)
+                if ((gray >> k) & 1)
+                    state[d] ^= _v[d * BITS + k];
+        }
+
+        for (size_t row = begin; row < end; ++row, ++i)
+        {
+            double *x = design.row(row);
+            for (size_t d = 0; d < _dims; ++d)
+                x[d] = state[d] / TWO_POW_32;
+
+            int bit = __builtin_ctzll(i + 1);
+            for (size_t d = 0; d < _dims; ++d)
+                state[d] ^= _v[d * BITS + bit];
+        }
+    }
+}
+
+HaltonSequence::HaltonSequence(size_t dims, bool scramble, uint64_t seed)
+    : _dims(dims), _perms(dims)
+{
+    check_dims(dims, MAX_DIMS, "Halton");
+
+    std::mt19937_64 rng(seed);
+    for (size_t d = 0; d < dims; ++d)
+    {
+        vector<uint32_t> &perm = _perms[d];
+        perm.resize(PRIMES[d]);
+        for (uint32_t digit = 0; digit < PRIMES[d]; ++digit)
+            perm[digit] = digit;
+        if (scramble)
+            std::shuffle(perm.begin() + 1, perm.end(), rng);
+    }
+}
+
+void HaltonSequence::point(uint64_t i, double *x) const
+{
+    for (size_t d = 0; d < _dims; ++d)
+    {
+        const uint32_t base = PRIMES[d];
+        const vector<uint32_t> &perm = _perms[d];
+        double inv = 1.0 / base;
+        double scale = inv;
+        double value = 0.0;
+        for (uint64_t rest = i; rest; rest /= base)
+        {
+            value += perm[rest % base] * scale;
+            scale *= inv;
+        }
+        x[d] = value;
+    }
+}
+
+void HaltonSequence::fill(Design &design, uint64_t first) const
+{
+    #pragma omp parallel for schedule(static, 1024)
+    for (size_t row = 0; row < design.n; ++row)
+        point(first + row, design.row(row));
+}
@@ -0,0 +1,47 @@
+#include <cstdint>
+#include <vector>
+#include "design.hpp"
+#pragma once
+
+// Low-discrepancy sequences. Every point is a function of its index alone, so a sweep can be extended by
+// generating the next block of indices with the same seed, and blocks can be generated in parallel
+
+// Sobol sequence with Joe & Kuo (2008) direction numbers, optionally scrambled with a random linear matrix
+// scramble plus a digital shift (Matousek 1998), which keeps the net properties of the unscrambled sequence
+class SobolSequence
+{
+public:
+    static const size_t MAX_DIMS = 32;
+    static const int BITS = 32;
+
+    SobolSequence(size_t dims, bool scramble, uint64_t seed);
+
+    // Point i, computed directly from the bits of i's Gray code
+    void point(uint64_t i, double *x) const;
+
+    // Fill every row of a design with points first, first+1, ...
+    void fill(Design &design, uint64_t first) const;
+
+private:
+    size_t _dims;
+    std::vector<uint32_t> _v;     // Direction numbers, BITS per dimension
+    std::vector<uint32_t> _shift;
+};
+
+// Halton sequence: radical inverses in the first few primes, optionally scrambled with a random
+// permutation of the digits in each base (fixing 0 so trailing zeros stay zero)
+class HaltonSequence
+{
+public:
+    static const size_t MAX_DIMS = 32;
+
+    HaltonSequence(size_t dims, bool scramble, uint64_t seed);
+
+    void point(uint64_t i, double *x) const;
+
+    void fill(Design &design, uint64_t first) const;
+
+private:
+    size_t _dims;
+    std::vector<std::vector<uint32_t>> _perms;
+};
@@ -0,0 +1,31 @@
+#!/bin/sh
+# adaptgen must append distinct combos: within a round, even with no weight on exploring (-e 0), and across two rounds
+# run with the same seed
+# Usage: adaptgen_distinct.sh ADAPTGEN
+set -e
+adaptgen=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+printf 'a,b\n0,0\n1,0\n0,1\n1,1\n0.5,0.5\n0.2,0.8\n' > "$dir/combos.csv"
+i=1
+for y in 0.1 0.9 0.3 2.5 1.2 0.7; do
+    echo "1000,1,$i,0,0,$y" >> "$dir/results.csv"
+    echo "1000,2,$i,0,0,$y" >> "$dir/results.csv"
+    i=$((i + 1))
+done
+
+"$adaptgen" -i "$dir/combos.csv" -r "$dir/results.csv" -e 0 -n 5 -s 1 -T 2
+"$adaptgen" -i "$dir/combos.csv" -r "$dir/results.csv" -e 0 -n 5 -s 1 -T 2
+
+rows=$(tail -n +2 "$dir/combos.csv" | wc -l)
+if [ "$rows" -ne 16 ]; then
+    echo "Expected 16 combos, found $rows"
+    exit 1
+fi
+dups=$(tail -n +2 "$dir/combos.csv" | sort | uniq -d)
+if [ -n "$dups" ]; then
+    echo "Appended combos repeat:"
+    echo "$dups"
+    exit 1
+fi
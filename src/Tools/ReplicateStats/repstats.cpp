@@ -0,0 +1,480 @@
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "../../Parallelisation/Cpp/includes/csv.h"
+#include "../../Parallelisation/Cpp/includes/moments.h"
+#include "../../Parallelisation/Cpp/includes/parse.h"
+#include "../../Parallelisation/Cpp/includes/slimformat.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+
+// Rows are grouped by combo and sample generation: each group is the replicates (seeds) of one combo at one point in time
+struct GroupKey
+{
+    long modelindex;
+    long generation;
+
+    bool operator==(const GroupKey &other) const { return modelindex == other.modelindex && generation == other.generation; }
+    bool operator<(const GroupKey &other) const
+    {
+        return modelindex != other.modelindex ? modelindex < other.modelindex : generation < other.generation;
+    }
+};
+
+struct GroupKeyHash
+{
+    size_t operator()(const GroupKey &key) const
+    {
+        return std::hash<long>()(key.modelindex * 1000003 ^ key.generation);
+    }
+};
+
+// Summaries of each column of a group, indexed by 1-based column number. Rows from different phases of the model have
+// different numbers of columns, so each column keeps its own count. Quantile sketches are only kept when quantiles are asked for
+struct Group
+{
+    vector<Moments> cols;
+    vector<TDigest> sketches;
+    double compression = 200;
+
+    void merge(const Group &other)
+    {
+        if (cols.size() < other.cols.size())
+            cols.resize(other.cols.size());
+        for (size_t c = 0; c < other.cols.size(); ++c)
+            cols[c].merge(other.cols[c]);
+        if (sketches.size() < other.sketches.size())
+            sketches.resize(other.sketches.size(), TDigest(other.compression));
+        for (size_t c = 0; c < other.sketches.size(); ++c)
+            sketches[c].merge(other.sketches[c]);
+    }
+};
+
+typedef std::unordered_map<GroupKey, Group, GroupKeyHash> Groups;
+
+// Which rows and columns to summarise: columns from a list, or every column after the key columns, and rows whose
+// columns match every filter, e.g. only QTL rows of a mutations output
+struct Columns
+{
+    vector<bool> listed;
+    size_t modelCol = 3;
+    vector<std::pair<size_t, string>> filters;
+    vector<double> quantiles;
+    double compression = 200;
+
+    bool keep(const vector<std::string_view> &fields) const
+    {
+        for (const auto &filter : filters)
+        {
+            if (filter.first > fields.size() || fields[filter.first - 1] != filter.second)
+                return false;
+        }
+        return true;
+    }
+
+    bool wanted(size_t col) const
+    {
+        if (!listed.empty())
+            return col < listed.size() && listed[col];
+        return col > 3 && col != modelCol;
+    }
+};
+
+// Split a file into n pieces of about the same size, each ending at the end of a line, so threads can read them in place
+vector<const char*> split_lines(const slimformat::MappedFile &file, size_t n)
+{
+    const char *begin = file.data(), *end = file.data() + file.size();
+    vector<const char*> bounds{begin};
+    for (size_t i = 1; i < n; ++i)
+    {
+        const char *p = std::max(begin + file.size() * i / n, bounds.back());
+        const char *nl = p < end ? static_cast<const char*>(std::memchr(p, '\n', end - p)) : nullptr;
+        bounds.push_back(nl ? nl + 1 : end);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+bool parse_number(std::string_view field, double &value)
+{
+    auto res = std::from_chars(field.data(), field.data() + field.size(), value);
+    return res.ec == std::errc() && res.ptr == field.data() + field.size();
+}
+
+// Add every line of a piece of a headerless SLiM output (generation first, then seed and modelindex, as the models
+// write them) to the groups. Lines that don't start with a numeric generation and modelindex are skipped and counted,
+// and lines that don't match the filters are left out
+void summarise_piece(const string &name, const char *begin, const char *end, const Columns &columns, Groups &groups,
+                     size_t &rows, size_t &skipped)
+{
+    if (begin == end)
+        return;
+    io::LineReader in(name, begin, end);
+    vector<std::string_view> fields;
+
+    while (char *line = in.next_line())
+    {
+        splitFields(line, fields);
+
+        double generation, model;
+        if (fields.size() < columns.modelCol
+            || !parse_number(fields[0], generation)
+            || !parse_number(fields[columns.modelCol - 1], model))
+        {
+            ++skipped;
+            continue;
+        }
+        if (!columns.keep(fields))
+            continue;
+
+        Group &group = groups[GroupKey{long(model), long(generation)}];
+        const bool sketch = !columns.quantiles.empty();
+        if (group.cols.size() < fields.size() + 1)
+        {
+            group.cols.resize(fields.size() + 1);
+            if (sketch)
+            {
+                group.compression = columns.compression;
+                group.sketches.resize(fields.size() + 1, TDigest(columns.compression));
+            }
+        }
+        for (size_t c = 1; c <= fields.size(); ++c)
+        {
+            double value;
+            if (columns.wanted(c) && parse_number(fields[c - 1], value))
+            {
+                group.cols[c].add(value);   // NA and other non-numbers are left out of that column's summary
+                if (sketch)
+                    group.sketches[c].add(value);
+            }
+        }
+        ++rows;
+    }
+}
+
+void write_number(FILE *out, double value)
+{
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    std::fputc(',', out);
+    std::fwrite(buf, 1, res.ptr - buf, out);
+}
+
+// One row per group and column, sorted by modelindex, generation and column, with a column for each quantile asked for
+void write_summary(Groups &groups, const vector<double> &quantiles, const string &filename)
+{
+    vector<std::pair<GroupKey, Group*>> sorted;
+    sorted.reserve(groups.size());
+    for (auto &group : groups)
+        sorted.emplace_back(group.first, &group.second);
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::unique_ptr<FILE, int(*)(FILE*)> file(filename.empty() ? stdout : std::fopen(filename.c_str(), "w"),
+                                              filename.empty() ? [](FILE*) { return 0; } : std::fclose);
+    if (!file)
+        throw std::runtime_error("Can't open " + filename + " for writing");
+    FILE *out = file.get();
+
+    std::fputs("modelindex,generation,column,n,mean,var,sd,se,min,max", out);
+    for (double q : quantiles)
+    {
+        std::fputs(",q", out);
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), q);
+        std::fwrite(buf, 1, res.ptr - buf, out);
+    }
+    std::fputc('\n', out);
+    for (const auto &entry : sorted)
+    {
+        const vector<Moments> &cols = entry.second->cols;
+        for (size_t c = 0; c < cols.size(); ++c)
+        {
+            if (cols[c].n == 0)
+                continue;
+            std::fprintf(out, "%ld,%ld,%zu,%llu", entry.first.modelindex, entry.first.generation, c,
+                         (unsigned long long)cols[c].n);
+            write_number(out, cols[c].mean);
+            write_number(out, cols[c].variance());
+            write_number(out, cols[c].sd());
+            write_number(out, cols[c].se());
+            write_number(out, cols[c].min);
+            write_number(out, cols[c].max);
+            for (double q : quantiles)
+                write_number(out, entry.second->sketches[c].quantile(q));
+            std::fputc('\n', out);
+        }
+    }
+    if (std::fflush(out) != 0)
+        throw std::runtime_error("Failed writing to " + filename);
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "Replicate Stats\n"
+    "\n"
+    "This program summarises SLiM outputs across replicates in one pass: for each combo (modelindex) and generation,\n"
+    "the count, mean, variance, standard deviation, standard error, minimum and maximum of each column over seeds.\n"
+    "Files are split between threads, each summarising its own piece, and the pieces are merged at the end,\n"
+    "so memory use depends on the number of groups rather than the size of the files.\n"
+    "Quantiles come from a t-digest per group and column, which is mergeable and has bounded size.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./out_slim1T_means.csv -c 6,7 -q 0.05,0.5,0.95 -d ./means_summary.csv\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i LIST        SLiM output files to summarise, delimited by commas. Rows from every file are pooled, so shards or\n"
+    "               the outputs of several jobs can be summarised together. Defaults to ./out_slim1T_means.csv.\n"
+    "\n"
+    "-d FILEPATH    Where to write the summary, as modelindex,generation,column,n,mean,var,sd,se,min,max rows.\n"
+    "               Defaults to the standard output.\n"
+    "\n"
+    "-c LIST        Columns to summarise (1-based), delimited by commas. Defaults to every column after modelindex.\n"
+    "\n"
+    "-m COL         Column of the output holding the modelindex (the combo's row number). Defaults to 3.\n"
+    "\n"
+    "-f LIST        Only summarise rows where each column has the given value, as COL=VALUE delimited by commas.\n"
+    "               Example: -i ./out_slim1T_muts.csv -f 4=3 -c 8 for the effect sizes of QTL mutations (m3).\n"
+    "\n"
+    "-q LIST        Quantiles to estimate, between 0 and 1, delimited by commas, e.g. 0.05,0.5,0.95.\n"
+    "               Each is added to the summary as a column named after it, e.g. q0.5.\n"
+    "\n"
+    "-k N           Compression of the quantile sketches: each keeps about N/2 centroids, and larger values are\n"
+    "               more accurate. Defaults to 200.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "destination",    required_argument,  0,  'd' },
+        { "columns",        required_argument,  0,  'c' },
+        { "model-col",      required_argument,  0,  'm' },
+        { "filter",         required_argument,  0,  'f' },
+        { "quantiles",      required_argument,  0,  'q' },
+        { "compression",    required_argument,  0,  'k' },
+        { "threads",        required_argument,  0,  'T' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string inputs = "./out_slim1T_means.csv";
+    string outFile;
+    string columnList;
+    string filterList;
+    string quantileList;
+    Columns columns;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:d:c:m:f:q:k:T:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                inputs = optarg;
+                continue;
+
+            case 'd':
+                outFile = optarg;
+                continue;
+
+            case 'c':
+                columnList = optarg;
+                continue;
+
+            case 'm':
+                columns.modelCol = std::stoul(optarg);
+                continue;
+
+            case 'f':
+                filterList = optarg;
+                continue;
+
+            case 'q':
+                quantileList = optarg;
+                continue;
+
+            case 'k':
+                columns.compression = std::stod(optarg);
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    vector<string> files;
+    try
+    {
+        files = splitList(inputs);
+        for (const string &item : splitList(columnList))
+        {
+            size_t col = std::stoul(item);
+            if (col < 1)
+                throw std::invalid_argument("Columns are numbered from 1");
+            if (columns.listed.size() <= col)
+                columns.listed.resize(col + 1);
+            columns.listed[col] = true;
+        }
+        for (const string &item : splitList(filterList))
+        {
+            size_t eq = item.find('=');
+            if (eq == string::npos || std::stoul(item.substr(0, eq)) < 1)
+                throw std::invalid_argument("Can't read the filter " + item + ", expected COL=VALUE");
+            columns.filters.emplace_back(std::stoul(item.substr(0, eq)), item.substr(eq + 1));
+        }
+        for (const string &item : splitList(quantileList))
+        {
+            double q = std::stod(item);
+            if (q < 0 || q > 1)
+                throw std::invalid_argument("Quantiles must be between 0 and 1");
+            columns.quantiles.push_back(q);
+        }
+        if (columns.compression < 10)
+            throw std::invalid_argument("The sketch compression (-k) must be at least 10");
+        if (columns.modelCol < 2)
+            throw std::invalid_argument("The modelindex column (-m) can't be the generation column");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    // Each thread summarises its own piece of each file into groups of its own, so there's no locking while reading
+    const int nThreads = omp_get_max_threads();
+    vector<Groups> partial(nThreads);
+    vector<size_t> rows(nThreads, 0), skipped(nThreads, 0);
+    size_t bytes = 0;
+    bool failed = false;
+
+    for (const string &filename : files)
+    {
+        std::unique_ptr<slimformat::MappedFile> file;
+        try
+        {
+            file = std::make_unique<slimformat::MappedFile>(filename, "repstats");
+            file->advise(MADV_SEQUENTIAL);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << endl;
+            return 1;
+        }
+        bytes += file->size();
+        vector<const char*> bounds = split_lines(*file, nThreads);
+
+        #pragma omp parallel num_threads(nThreads)
+        {
+            int t = omp_get_thread_num();
+            try
+            {
+                summarise_piece(filename, bounds[t], bounds[t + 1], columns, partial[t], rows[t], skipped[t]);
+            }
+            catch (const std::exception &e)
+            {
+                #pragma omp critical
+                {
+                    std::cerr << filename << ": " << e.what() << endl;
+                    failed = true;
+                }
+            }
+        }
+    }
+    if (failed)
+        return 1;
+
+    // Merge the threads' groups pairwise, in parallel, so the merge takes log(threads) rounds
+    for (int step = 1; step < nThreads; step *= 2)
+    {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int t = 0; t < nThreads - step; t += 2 * step)
+        {
+            Groups &into = partial[t];
+            for (auto &group : partial[t + step])
+            {
+                auto it = into.find(group.first);
+                if (it == into.end())
+                    into.emplace(group.first, std::move(group.second));
+                else
+                    it->second.merge(group.second);
+            }
+            Groups().swap(partial[t + step]);
+        }
+    }
+
+    try
+    {
+        write_summary(partial[0], columns.quantiles, outFile);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    if (debug)
+    {
+        size_t totalRows = 0, totalSkipped = 0;
+        for (int t = 0; t < nThreads; ++t)
+        {
+            totalRows += rows[t];
+            totalSkipped += skipped[t];
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Summarised " << totalRows << " rows (" << bytes << " bytes) from " << files.size() << " files into "
+                  << partial[0].size() << " groups with " << nThreads << " threads in " << seconds << "s";
+        if (totalSkipped)
+            std::cerr << ", skipping " << totalSkipped << " rows without a generation and modelindex";
+        std::cerr << endl;
+    }
+    return 0;
+}
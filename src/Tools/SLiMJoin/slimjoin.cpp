@@ -0,0 +1,580 @@
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+#include "../../Parallelisation/Cpp/includes/csv.h"
+#include "../../Parallelisation/Cpp/includes/parse.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::string_view;
+using std::vector;
+namespace fs = std::filesystem;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+#define BUFFER_SIZE (4 << 20)
+
+// Grace partitions are split again at most this many times when one is still too big for memory, e.g. if many rows share a key
+#define MAX_DEPTH 3
+
+
+typedef std::unique_ptr<FILE, int(*)(FILE*)> File;
+
+File open_file(const string &filename, const char *mode)
+{
+    File file(std::fopen(filename.c_str(), mode), std::fclose);
+    if (!file)
+        throw std::runtime_error("Can't open " + filename);
+    std::setvbuf(file.get(), nullptr, _IOFBF, BUFFER_SIZE);
+    return file;
+}
+
+// Mix a hash so partitions at each level of the grace join split keys differently (splitmix64's finaliser)
+uint64_t mix(uint64_t h, uint64_t level)
+{
+    h += 0x9e3779b97f4a7c15ULL * (level + 1);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+// How rows of one side are keyed: the key is its key columns in order, joined by commas, so key columns can be in
+// different places on each side (e.g. seed,modelindex in the means, but modelindex,seed in the positions)
+struct Side
+{
+    string filename;
+    vector<size_t> keyCols;     // 1-based
+    size_t maxKeyCol = 0;
+
+    // Split a line into its fields in place and build its key. False if it's missing a key column
+    bool split(const char *line, vector<string_view> &fields, string &key) const
+    {
+        splitFields(line, fields);
+        if (fields.size() < maxKeyCol)
+            return false;
+        key.clear();
+        for (size_t i = 0; i < keyCols.size(); ++i)
+        {
+            if (i)
+                key += ',';
+            key.append(fields[keyCols[i] - 1]);
+        }
+        return true;
+    }
+
+    bool isKey(size_t col) const { return std::find(keyCols.begin(), keyCols.end(), col) != keyCols.end(); }
+};
+
+// The build side in memory: every row's key and its other columns are packed into one arena, and an open-addressing
+// table of key hashes points to the first and last rows with each key. Rows with the same key are chained in order.
+// Nothing is allocated per row, so the table's memory is close to the size of the data, and it's all counted
+class BuildTable
+{
+public:
+    explicit BuildTable(size_t budget) : _budget(budget) { _slots.resize(16); }
+
+    size_t bytes() const
+    {
+        return _arena.capacity() + _rows.capacity() * sizeof(Row) + _slots.size() * sizeof(Slot);
+    }
+
+    // About the most a table of rows rows, from bytes bytes of input, can take: the input, a Row for each row, and up
+    // to four slots each, as the slots double once they're half full
+    static size_t estimate(size_t rows, size_t bytes) { return bytes + rows * (sizeof(Row) + 4 * sizeof(Slot)); }
+
+    // Add a row, or return false if that would take the table over its memory budget
+    bool add(string_view key, string_view payload)
+    {
+        if ((_rows.size() + 1) * 2 > _slots.size() && !grow())
+            return false;
+        if (!fit(_arena, _arena.size() + key.size() + payload.size(), 1) || !fit(_rows, _rows.size() + 1, sizeof(Row)))
+            return false;
+
+        uint64_t hash = std::hash<string_view>()(key);
+        Row row{hash, _arena.size(), uint32_t(key.size()), uint32_t(payload.size()), -1};
+        _arena.append(key);
+        _arena.append(payload);
+        _rows.push_back(row);
+        int64_t index = _rows.size() - 1;
+
+        Slot &slot = find(hash, key);
+        if (slot.first < 0)
+            slot.first = index;
+        else
+            _rows[slot.last].next = index;
+        slot.last = index;
+        return true;
+    }
+
+    // Call f with the other columns of each row with this key, in the order they were added
+    template <typename F>
+    size_t match(string_view key, F f) const
+    {
+        uint64_t hash = std::hash<string_view>()(key);
+        const Slot &slot = const_cast<BuildTable*>(this)->find(hash, key);
+        size_t n = 0;
+        for (int64_t r = slot.first; r >= 0; r = _rows[r].next, ++n)
+            f(string_view(_arena.data() + _rows[r].offset + _rows[r].keyLen, _rows[r].payloadLen));
+        return n;
+    }
+
+    size_t rows() const { return _rows.size(); }
+
+private:
+    struct Row
+    {
+        uint64_t hash;
+        uint64_t offset;
+        uint32_t keyLen;
+        uint32_t payloadLen;
+        int64_t next;       // Next row with the same key, or -1
+    };
+
+    struct Slot
+    {
+        int64_t first = -1;
+        int64_t last = -1;
+    };
+
+    // The slot for a key: the one holding it, or the empty slot it would go in
+    Slot &find(uint64_t hash, string_view key)
+    {
+        size_t mask = _slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            Slot &slot = _slots[i];
+            if (slot.first < 0)
+                return slot;
+            const Row &row = _rows[slot.first];
+            if (row.hash == hash && string_view(_arena.data() + row.offset, row.keyLen) == key)
+                return slot;
+        }
+    }
+
+    // Make room for need elements in v, growing it by doubling but never past the budget
+    template <typename V>
+    bool fit(V &v, size_t need, size_t size)
+    {
+        if (need <= v.capacity())
+            return true;
+        size_t others = bytes() - v.capacity() * size;
+        if (others + need * size > _budget)
+            return false;
+        v.reserve(std::min(std::max(need, v.capacity() * 2), (_budget - others) / size));
+        return true;
+    }
+
+    bool grow()
+    {
+        if (bytes() + _slots.size() * 2 * sizeof(Slot) > _budget)
+            return false;
+        vector<Slot> old(_slots.size() * 2);
+        old.swap(_slots);
+        size_t mask = _slots.size() - 1;
+        for (const Slot &slot : old)
+        {
+            if (slot.first < 0)
+                continue;
+            size_t i = _rows[slot.first].hash & mask;
+            while (_slots[i].first >= 0)
+                i = (i + 1) & mask;
+            _slots[i] = slot;
+        }
+        return true;
+    }
+
+    size_t _budget;
+    string _arena;
+    vector<Row> _rows;
+    vector<Slot> _slots;
+};
+
+// What to write and what was seen
+struct Join
+{
+    Side probe;
+    Side build;
+    bool keepUnmatched = false;
+    size_t buildCols = 0;       // Most non-key columns on a build row, for padding unmatched probe rows with NA
+    size_t matched = 0;
+    size_t unmatched = 0;
+    size_t skipped = 0;
+    FILE *out = nullptr;
+};
+
+// The other columns of a build row, joined by commas
+void payload_of(const Side &build, const vector<string_view> &fields, string &payload, size_t &cols)
+{
+    payload.clear();
+    size_t n = 0;
+    for (size_t c = 1; c <= fields.size(); ++c)
+    {
+        if (build.isKey(c))
+            continue;
+        payload += ',';
+        payload.append(fields[c - 1]);
+        ++n;
+    }
+    cols = std::max(cols, n);
+}
+
+// What's in a build file with a key: how many rows, and whether they all have the same key (key is the first row's)
+struct BuildStats
+{
+    size_t rows = 0;
+    bool oneKey = true;
+    string key;
+};
+
+// Load a build file into the table. Returns false if it doesn't fit in the budget, but reads the file to the end
+// either way, to find its stats
+bool load_build(const string &filename, Join &join, BuildTable &table, BuildStats &stats)
+{
+    size_t skipped = 0;
+    File file = open_file(filename, "rb");
+    io::LineReader in(filename, file.release());
+    vector<string_view> fields;
+    string key, payload;
+    bool fits = true;
+    while (char *line = in.next_line())
+    {
+        if (!join.build.split(line, fields, key))
+        {
+            ++skipped;
+            continue;
+        }
+        if (stats.rows++ == 0)
+            stats.key = key;
+        else if (stats.oneKey && key != stats.key)
+            stats.oneKey = false;
+        if (!fits)
+            continue;
+        payload_of(join.build, fields, payload, join.buildCols);
+        fits = table.add(key, payload);
+    }
+    if (fits)
+        join.skipped += skipped;
+    return fits;
+}
+
+// Stream a probe file past the table, writing each probe row once per build row with its key
+void probe_file(const string &filename, Join &join, const BuildTable &table)
+{
+    File file = open_file(filename, "rb");
+    io::LineReader in(filename, file.release());
+    vector<string_view> fields;
+    string key;
+    while (char *line = in.next_line())
+    {
+        string_view row(line);
+        if (!join.probe.split(line, fields, key))
+        {
+            ++join.skipped;
+            continue;
+        }
+        size_t n = table.match(key, [&](string_view payload)
+        {
+            std::fwrite(row.data(), 1, row.size(), join.out);
+            std::fwrite(payload.data(), 1, payload.size(), join.out);
+            std::fputc('\n', join.out);
+        });
+        join.matched += n;
+        if (n == 0)
+        {
+            ++join.unmatched;
+            if (join.keepUnmatched)
+            {
+                std::fwrite(row.data(), 1, row.size(), join.out);
+                for (size_t c = 0; c < join.buildCols; ++c)
+                    std::fputs(",NA", join.out);
+                std::fputc('\n', join.out);
+            }
+        }
+    }
+}
+
+// Split a file into partitions by the hash of each row's key. Rows without a key go to none of them.
+// For the build side, also finds the most non-key columns on a row
+vector<string> partition_file(const string &filename, const Side &side, const string &prefix, size_t parts, uint64_t level,
+                              size_t &skipped, size_t *cols = nullptr)
+{
+    vector<string> names;
+    vector<File> outs;
+    for (size_t p = 0; p < parts; ++p)
+    {
+        names.push_back(prefix + std::to_string(p));
+        outs.push_back(open_file(names.back(), "wb"));
+    }
+
+    File file = open_file(filename, "rb");
+    io::LineReader in(filename, file.release());
+    vector<string_view> fields;
+    string key;
+    while (char *line = in.next_line())
+    {
+        string_view row(line);
+        if (!side.split(line, fields, key))
+        {
+            ++skipped;
+            continue;
+        }
+        if (cols)
+            *cols = std::max(*cols, fields.size() - side.keyCols.size());
+        FILE *out = outs[mix(std::hash<string_view>()(key), level) % parts].get();
+        std::fwrite(row.data(), 1, row.size(), out);
+        std::fputc('\n', out);
+    }
+    for (size_t p = 0; p < parts; ++p)
+        if (std::fflush(outs[p].get()) != 0)
+            throw std::runtime_error("Failed writing to " + names[p] + ": is the temporary directory full?");
+    return names;
+}
+
+// Join in memory if the build side fits in the budget. If not, partition both sides by key hash so each build
+// partition fits (a grace hash join), and join the partitions pair by pair, splitting any that are still too big
+void join_files(const string &probeFile, const string &buildFile, Join &join, size_t budget, const string &tmpPrefix,
+                uint64_t level, bool verbose)
+{
+    BuildStats stats;
+    {
+        BuildTable table(budget);
+        if (load_build(buildFile, join, table, stats))
+        {
+            probe_file(probeFile, join, table);
+            return;
+        }
+    }
+    // Splitting can't separate rows with the same key
+    if (stats.oneKey)
+        throw std::runtime_error("The " + std::to_string(stats.rows) + " build rows with the key " + stats.key
+                                 + " don't fit in the memory budget. Try a bigger budget (-M)");
+    if (level >= MAX_DEPTH)
+        throw std::runtime_error("Couldn't split the build file into pieces that fit in the memory budget. "
+                                 "Try a bigger budget (-M)");
+
+    // Enough partitions for each to fit in about half the budget, going by what a table of its rows takes
+    size_t bytes = fs::file_size(buildFile);
+    size_t parts = std::min<size_t>(std::max<size_t>(2, 1 + 2 * BuildTable::estimate(stats.rows, bytes) / budget), 512);
+    if (verbose)
+        std::cerr << buildFile << " (" << stats.rows << " rows, " << bytes << " bytes) doesn't fit in the memory budget, "
+                  << "splitting both sides into " << parts << " partitions" << endl;
+
+    vector<string> builds = partition_file(buildFile, join.build, tmpPrefix + "b" + std::to_string(level) + "_", parts,
+                                           level, join.skipped, &join.buildCols);
+    vector<string> probes = partition_file(probeFile, join.probe, tmpPrefix + "p" + std::to_string(level) + "_", parts,
+                                           level, join.skipped);
+    for (size_t p = 0; p < parts; ++p)
+    {
+        join_files(probes[p], builds[p], join, budget, tmpPrefix + std::to_string(p) + "_", level + 1, verbose);
+        fs::remove(builds[p]);
+        fs::remove(probes[p]);
+    }
+}
+
+vector<size_t> parse_columns(const string &list)
+{
+    vector<size_t> cols;
+    for (const string &item : splitList(list))
+    {
+        size_t col = std::stoul(item);
+        if (col < 1)
+            throw std::invalid_argument("Columns are numbered from 1");
+        cols.push_back(col);
+    }
+    if (cols.empty())
+        throw std::invalid_argument("No key columns given");
+    return cols;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "SLiM Join\n"
+    "\n"
+    "This program joins two headerless SLiM outputs on key columns, e.g. seed and modelindex, writing each row of the\n"
+    "probe file with the other columns of every build file row that has the same key. The build file (usually the\n"
+    "smaller) is loaded into a hash table and the probe file is streamed past it. If the build file doesn't fit in the\n"
+    "memory budget, both files are split by key into partitions on disk that do fit, and joined partition by partition.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./out_slim1T_means.csv -j ./out_slim1T_opt.csv -K 1,2 -d ./means_opt.csv\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i FILEPATH    The probe file, streamed. Its rows keep their columns and order (unless it's partitioned).\n"
+    "               Defaults to ./out_slim1T_means.csv.\n"
+    "\n"
+    "-j FILEPATH    The build file, held in memory. Its non-key columns are added to each matching probe row.\n"
+    "               Defaults to ./out_slim1T_opt.csv.\n"
+    "\n"
+    "-k LIST        Key columns of the probe file (1-based), delimited by commas. Defaults to 2,3 (seed,modelindex),\n"
+    "               as in the means and mutations outputs. Add 1 to join on generation too: -k 2,3,1.\n"
+    "\n"
+    "-K LIST        Key columns of the build file, in the same order as -k. Defaults to 1,2, as in the optimum\n"
+    "               output (seed,modelindex). Use 2,3 for the means or mutations, and 2,1 for the positions\n"
+    "               (modelindex,seed).\n"
+    "\n"
+    "-u             Keep probe rows with no match, with NA for the build file's columns.\n"
+    "\n"
+    "-d FILEPATH    Where to write the joined rows. Defaults to the standard output.\n"
+    "\n"
+    "-M SIZE        Memory budget for the build side, e.g. 500M or 8G. Defaults to 1G.\n"
+    "\n"
+    "-t DIRECTORY   Where to write partitions if the build side doesn't fit. Defaults to $TMPDIR, or /tmp.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "join",           required_argument,  0,  'j' },
+        { "keys",           required_argument,  0,  'k' },
+        { "join-keys",      required_argument,  0,  'K' },
+        { "unmatched",      no_argument,        0,  'u' },
+        { "destination",    required_argument,  0,  'd' },
+        { "memory",         required_argument,  0,  'M' },
+        { "tmpdir",         required_argument,  0,  't' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    Join join;
+    join.probe.filename = "./out_slim1T_means.csv";
+    join.build.filename = "./out_slim1T_opt.csv";
+    string probeKeys = "2,3";
+    string buildKeys = "1,2";
+    string outFile;
+    string memory = "1G";
+    string tmpDir = std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp";
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:j:k:K:ud:M:t:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                join.probe.filename = optarg;
+                continue;
+
+            case 'j':
+                join.build.filename = optarg;
+                continue;
+
+            case 'k':
+                probeKeys = optarg;
+                continue;
+
+            case 'K':
+                buildKeys = optarg;
+                continue;
+
+            case 'u':
+                join.keepUnmatched = true;
+                continue;
+
+            case 'd':
+                outFile = optarg;
+                continue;
+
+            case 'M':
+                memory = optarg;
+                continue;
+
+            case 't':
+                tmpDir = optarg;
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    fs::path workDir;
+    try
+    {
+        join.probe.keyCols = parse_columns(probeKeys);
+        join.build.keyCols = parse_columns(buildKeys);
+        if (join.probe.keyCols.size() != join.build.keyCols.size())
+            throw std::invalid_argument("The probe and build files need the same number of key columns (-k and -K)");
+        join.probe.maxKeyCol = *std::max_element(join.probe.keyCols.begin(), join.probe.keyCols.end());
+        join.build.maxKeyCol = *std::max_element(join.build.keyCols.begin(), join.build.keyCols.end());
+        size_t budget = parseSize(memory);
+
+        File out(outFile.empty() ? stdout : std::fopen(outFile.c_str(), "wb"), outFile.empty() ? [](FILE*) { return 0; } : std::fclose);
+        if (!out)
+            throw std::runtime_error("Can't open " + outFile + " for writing");
+        std::setvbuf(out.get(), nullptr, _IOFBF, BUFFER_SIZE);
+        join.out = out.get();
+
+        workDir = fs::path(tmpDir) / ("slimjoin_" + std::to_string(getpid()));
+        fs::create_directories(workDir);
+        join_files(join.probe.filename, join.build.filename, join, budget, (workDir / "").string(), 0, debug);
+        fs::remove_all(workDir);
+
+        if (std::fflush(join.out) != 0)
+            throw std::runtime_error("Failed writing to " + (outFile.empty() ? string("the standard output") : outFile));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        if (!workDir.empty())
+            fs::remove_all(workDir);
+        return 1;
+    }
+
+    // Rows to join but not one match: the key columns are almost certainly wrong, so don't pass it off as a join
+    if (join.matched == 0 && join.unmatched > 0)
+    {
+        std::cerr << "None of the " << join.unmatched << " probe rows matched a build row on keys " << probeKeys
+                  << " (-k) and " << buildKeys << " (-K): check they're the same columns in both files" << endl;
+        if (!join.keepUnmatched)
+            return 1;
+    }
+
+    if (debug)
+    {
+        std::cerr << "Wrote " << join.matched << " joined rows";
+        if (join.keepUnmatched)
+            std::cerr << " and " << join.unmatched << " unmatched rows";
+        else
+            std::cerr << ", dropping " << join.unmatched << " unmatched rows";
+        if (join.skipped)
+            std::cerr << ", skipping " << join.skipped << " rows without every key column";
+        std::cerr << endl;
+    }
+    return 0;
+}
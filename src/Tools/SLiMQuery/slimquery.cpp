@@ -0,0 +1,838 @@
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "../../Parallelisation/Cpp/includes/csv.h"
+#include "../../Parallelisation/Cpp/includes/moments.h"
+#include "../../Parallelisation/Cpp/includes/parse.h"
+#include "../../Parallelisation/Cpp/includes/slimcol.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+namespace fs = std::filesystem;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+#define BUFFER_SIZE (4 << 20)
+
+// Range indexes of csv shards are saved next to them, as SHARD.range
+#define RANGE_SUFFIX ".range"
+
+
+bool parse_double(std::string_view field, double &value)
+{
+    auto res = std::from_chars(field.data(), field.data() + field.size(), value);
+    return res.ec == std::errc() && res.ptr == field.data() + field.size();
+}
+
+// Group keys are compared as text, so the same number is written the same way whatever it came from: 1.0 in a csv,
+// or 1 in a columnar file
+void append_key(string &key, double value)
+{
+    char buf[32];
+    std::to_chars_result res;
+    if (std::isnan(value))
+    {
+        key += "NA";
+        return;
+    }
+    if (value == std::trunc(value) && std::fabs(value) < 9.2e18)
+        res = std::to_chars(buf, buf + sizeof(buf), int64_t(value));
+    else
+        res = std::to_chars(buf, buf + sizeof(buf), value);
+    key.append(buf, res.ptr - buf);
+}
+
+void append_key(string &key, std::string_view field)
+{
+    int64_t i;
+    double d;
+    auto res = std::from_chars(field.data(), field.data() + field.size(), i);
+    if (res.ec == std::errc() && res.ptr == field.data() + field.size())
+        key.append(field.data(), field.size());
+    else if (parse_double(field, d))
+        append_key(key, d);
+    else
+        key.append(field.data(), field.size());
+}
+
+// Order group keys by each value, as numbers where both are
+bool key_less(const vector<string> &a, const vector<string> &b)
+{
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        double x, y;
+        if (parse_double(a[i], x) && parse_double(b[i], y))
+        {
+            if (x != y)
+                return x < y;
+        }
+        else if (a[i] != b[i])
+        {
+            return a[i] < b[i];
+        }
+    }
+    return false;
+}
+
+struct KeyLess
+{
+    bool operator()(const vector<string> &a, const vector<string> &b) const { return key_less(a, b); }
+};
+
+typedef std::map<vector<string>, vector<Moments>, KeyLess> Groups;
+
+enum AggKind { COUNT, N, SUM, MEAN, VAR, SD, SE, MIN, MAX };
+
+struct Aggregate
+{
+    AggKind kind;
+    string column;      // Empty for count
+    string label;
+};
+
+// A range predicate from -w: rows where column is in [lo, hi]
+struct Range
+{
+    string column;
+    double lo;
+    double hi;
+};
+
+struct Query
+{
+    vector<string> select;
+    vector<Range> where;
+    vector<string> groupBy;
+    vector<Aggregate> aggregates;
+    string names;       // -n, for headerless csv shards
+    bool header = false;
+    bool index = false;
+
+    bool aggregating() const { return !aggregates.empty(); }
+};
+
+Aggregate parse_aggregate(const string &spec)
+{
+    static const vector<std::pair<string, AggKind>> kinds =
+    {
+        { "n", N }, { "sum", SUM }, { "mean", MEAN }, { "var", VAR }, { "sd", SD }, { "se", SE }, { "min", MIN }, { "max", MAX }
+    };
+    if (spec == "count")
+        return { COUNT, "", spec };
+    size_t open = spec.find('(');
+    if (open == string::npos || spec.back() != ')')
+        throw std::invalid_argument("Can't read the aggregate " + spec + ", expected e.g. mean(phenomean) or count");
+    string fn = spec.substr(0, open);
+    for (const auto &kind : kinds)
+        if (kind.first == fn)
+            return { kind.second, spec.substr(open + 1, spec.size() - open - 2), spec };
+    throw std::invalid_argument("No aggregate called " + fn);
+}
+
+Range parse_range(const string &spec)
+{
+    size_t eq = spec.find('=');
+    size_t colon = spec.find(':', eq);
+    if (eq == string::npos || colon == string::npos)
+        throw std::invalid_argument("Can't read the range " + spec + ", expected COL=LO:HI");
+    string lo = spec.substr(eq + 1, colon - eq - 1), hi = spec.substr(colon + 1);
+    return { spec.substr(0, eq), lo.empty() ? -INFINITY : std::stod(lo), hi.empty() ? INFINITY : std::stod(hi) };
+}
+
+double aggregate_value(const Aggregate &agg, const Moments &m)
+{
+    switch (agg.kind)
+    {
+        case COUNT: case N: return m.n;
+        case SUM: return m.n ? m.mean * m.n : 0.0;
+        case MEAN: return m.n ? m.mean : NAN;
+        case VAR: return m.variance();
+        case SD: return m.sd();
+        case SE: return m.se();
+        case MIN: return m.n ? m.min : NAN;
+        case MAX: return m.n ? m.max : NAN;
+    }
+    return NAN;
+}
+
+// Columns of a csv shard: its header, -n, the output named in its filename, or c1, c2, ... The model's outputs are
+// laid out by each row's width, as slimcol does, so every row of the means output has its columns where they're named,
+// whichever phase wrote it. Other shards' rows are read by position
+slimformat::Layout shard_layout(const Query &query, const string &filename, const vector<std::string_view> &first)
+{
+    if (query.header)
+        return slimformat::plainLayout(vector<string>(first.begin(), first.end()));
+    if (const slimformat::Preset *preset = slimformat::findPreset(query.names, fs::path(filename).filename().string()))
+    {
+        slimformat::Layout layout = slimformat::presetLayout(*preset);
+        if (!query.names.empty() || layout.fields.count(first.size()))
+            return layout;
+    }
+    vector<string> names = splitList(query.names);
+    names.resize(std::max(names.size(), first.size()));
+    for (size_t c = 0; c < names.size(); ++c)
+        if (names[c].empty())
+            names[c] = "c" + std::to_string(c + 1);
+    slimformat::Layout layout;
+    layout.columns = names;
+    return layout;
+}
+
+// The index of a named column in a shard; any column can also be called c1, c2, ...
+size_t find_column(const vector<string> &names, const string &name, const string &shard)
+{
+    for (size_t c = 0; c < names.size(); ++c)
+        if (names[c] == name)
+            return c;
+    if (name.size() > 1 && name[0] == 'c' && std::all_of(name.begin() + 1, name.end(), ::isdigit))
+    {
+        size_t c = std::stoul(name.substr(1));
+        if (c >= 1 && c <= names.size())
+            return c - 1;
+    }
+    throw std::runtime_error(shard + " has no column called " + name);
+}
+
+// The query's columns, as indices into one shard
+struct Plan
+{
+    vector<size_t> select;
+    vector<size_t> group;
+    vector<size_t> where;
+    vector<long> aggregates;    // -1 for count
+    size_t width = 0;           // Columns needed from each row
+
+    Plan(const Query &query, const vector<string> &names, const string &shard)
+    {
+        for (const string &name : query.select)
+            select.push_back(find_column(names, name, shard));
+        if (!query.aggregating() && query.select.empty())
+            for (size_t c = 0; c < names.size(); ++c)
+                select.push_back(c);
+        for (const string &name : query.groupBy)
+            group.push_back(find_column(names, name, shard));
+        for (const Range &range : query.where)
+            where.push_back(find_column(names, range.column, shard));
+        for (const Aggregate &agg : query.aggregates)
+            aggregates.push_back(agg.kind == COUNT ? -1 : long(find_column(names, agg.column, shard)));
+        for (const vector<size_t> *cols : { &select, &group, &where })
+            for (size_t c : *cols)
+                width = std::max(width, c + 1);
+        for (long c : aggregates)
+            width = std::max(width, size_t(c + 1));
+    }
+};
+
+// What one shard gives the query
+struct ShardResult
+{
+    vector<string> names;       // Of the columns selected
+    string rows;
+    Groups groups;
+    size_t scanned = 0;
+    size_t unfit = 0;           // Rows skipped for having none of the shard's layouts, or too few columns
+    size_t matched = 0;
+    size_t chunksSkipped = 0;
+    bool skipped = false;
+    string error;
+};
+
+void add_to_group(Groups &groups, vector<string> &key, const vector<double> &values)
+{
+    auto it = groups.find(key);
+    if (it == groups.end())
+        it = groups.emplace(key, vector<Moments>(values.size())).first;
+    for (size_t a = 0; a < values.size(); ++a)
+        if (!std::isnan(values[a]))
+            it->second[a].add(values[a]);
+}
+
+// A csv shard's range index: the smallest and largest number in each column, valid while the shard is the same size
+// and age as when it was indexed, and is read with the same columns
+struct RangeIndex
+{
+    vector<double> min, max;
+
+    // The index's version comes first, so indexes from before the model's rows were laid out by width are rebuilt.
+    // Columns are kept by position, so the stamp has what the positions mean: whether the shard has a header, whether
+    // its rows are laid out by width, and the columns' names
+    static string stamp(const string &shard, const slimformat::Layout &layout, bool header)
+    {
+        auto time = fs::last_write_time(shard).time_since_epoch().count();
+        string text = "3," + std::to_string(fs::file_size(shard)) + "," + std::to_string(time) + ","
+                      + (header ? "header" : "noheader") + "," + (layout.fields.empty() ? "fields" : "laidout");
+        for (const string &name : layout.columns)
+            text += "," + name;
+        return text;
+    }
+
+    bool load(const string &shard, const slimformat::Layout &layout, bool header)
+    {
+        std::ifstream in(shard + RANGE_SUFFIX);
+        string line;
+        if (!in || !std::getline(in, line) || line != stamp(shard, layout, header))
+            return false;
+        double lo, hi;
+        char comma;
+        while (in >> lo >> comma >> hi)
+        {
+            min.push_back(lo);
+            max.push_back(hi);
+        }
+        return true;
+    }
+
+    void save(const string &shard, const slimformat::Layout &layout, bool header) const
+    {
+        std::ofstream out(shard + RANGE_SUFFIX);
+        out.precision(17);
+        out << stamp(shard, layout, header) << "\n";
+        for (size_t c = 0; c < min.size(); ++c)
+            out << min[c] << "," << max[c] << "\n";
+    }
+
+    void add(size_t col, double value)
+    {
+        if (col >= min.size())
+        {
+            min.resize(col + 1, NAN);
+            max.resize(col + 1, NAN);
+        }
+        if (std::isnan(value))
+            return;
+        min[col] = std::isnan(min[col]) ? value : std::min(min[col], value);
+        max[col] = std::isnan(max[col]) ? value : std::max(max[col], value);
+    }
+
+    // Whether the column may have a value in [lo, hi]. A column that's never a number can't
+    bool mayContain(size_t col, double lo, double hi) const
+    {
+        if (col >= min.size())
+            return true;
+        return !std::isnan(min[col]) && !(max[col] < lo || min[col] > hi);
+    }
+};
+
+void query_csv(const Query &query, const string &shard, ShardResult &result)
+{
+    io::LineReader in(shard);
+    vector<std::string_view> fields;
+    char *line = in.next_line();
+    while (line && !*line)
+        line = in.next_line();
+    if (!line)
+        return;
+    splitFields(line, fields);
+    const slimformat::Layout layout = shard_layout(query, shard, fields);
+    const vector<string> &names = layout.columns;
+    Plan plan(query, names, shard);
+    for (size_t c : plan.select)
+        result.names.push_back(names[c]);
+    if (query.header)
+        line = in.next_line();
+
+    RangeIndex stored;
+    const bool indexed = stored.load(shard, layout, query.header);
+    if (indexed)
+    {
+        for (size_t p = 0; p < plan.where.size(); ++p)
+        {
+            if (!stored.mayContain(plan.where[p], query.where[p].lo, query.where[p].hi))
+            {
+                result.skipped = true;
+                return;
+            }
+        }
+    }
+
+    RangeIndex building;
+    const bool indexing = query.index && !indexed;
+    vector<double> values(plan.aggregates.size());
+    vector<string> key(plan.group.size());
+    vector<std::string_view> laidOut(names.size());
+    string width;
+    for (; line; line = in.next_line())
+    {
+        if (!*line)
+            continue;
+        splitFields(line, fields);
+        ++result.scanned;
+
+        // A row of one of the model's layouts is put in its columns, with NA for the ones it doesn't have
+        if (!layout.fields.empty())
+        {
+            auto cols = layout.fields.find(fields.size());
+            if (cols == layout.fields.end())
+            {
+                ++result.unfit;
+                continue;
+            }
+            std::fill(laidOut.begin(), laidOut.end(), std::string_view("NA"));
+            for (size_t f = 0; f < fields.size(); ++f)
+                laidOut[cols->second[f]] = fields[f];
+            if (layout.mixed())
+            {
+                width = std::to_string(fields.size());
+                laidOut.back() = width;
+            }
+        }
+        const vector<std::string_view> &row = layout.fields.empty() ? fields : laidOut;
+
+        if (indexing)
+        {
+            for (size_t c = 0; c < row.size(); ++c)
+            {
+                double v;
+                building.add(c, parse_double(row[c], v) ? v : NAN);
+            }
+        }
+        if (row.size() < plan.width)
+        {
+            ++result.unfit;
+            continue;
+        }
+
+        bool keep = true;
+        for (size_t p = 0; p < plan.where.size() && keep; ++p)
+        {
+            double v;
+            keep = parse_double(row[plan.where[p]], v) && v >= query.where[p].lo && v <= query.where[p].hi;
+        }
+        if (!keep)
+            continue;
+        ++result.matched;
+
+        if (query.aggregating())
+        {
+            for (size_t g = 0; g < plan.group.size(); ++g)
+            {
+                key[g].clear();
+                append_key(key[g], row[plan.group[g]]);
+            }
+            for (size_t a = 0; a < plan.aggregates.size(); ++a)
+            {
+                double v = 0.0;
+                if (plan.aggregates[a] >= 0 && !parse_double(row[plan.aggregates[a]], v))
+                    v = NAN;
+                values[a] = v;
+            }
+            add_to_group(result.groups, key, values);
+        }
+        else
+        {
+            for (size_t s = 0; s < plan.select.size(); ++s)
+            {
+                if (s)
+                    result.rows += ',';
+                result.rows.append(row[plan.select[s]].data(), row[plan.select[s]].size());
+            }
+            result.rows += '\n';
+        }
+    }
+    if (indexing)
+        building.save(shard, layout, query.header);
+}
+
+void query_columnar(const Query &query, const string &shard, ShardResult &result)
+{
+    slimcol::Reader in(shard);
+    vector<string> names;
+    for (size_t c = 0; c < in.cols(); ++c)
+        names.push_back(in.name(c));
+    Plan plan(query, names, shard);
+    for (size_t c : plan.select)
+        result.names.push_back(names[c]);
+
+    vector<slimcol::Chunk> chunks(in.cols());
+    vector<char> decoded(in.cols());
+    vector<char> keep;
+    vector<double> values(plan.aggregates.size());
+    vector<string> key(plan.group.size());
+    size_t chunksRead = 0;
+    for (size_t k = 0; k < in.chunks(); ++k)
+    {
+        bool may = true;
+        for (size_t p = 0; p < plan.where.size() && may; ++p)
+            may = in.mayContain(plan.where[p], k, query.where[p].lo, query.where[p].hi);
+        if (!may)
+        {
+            ++result.chunksSkipped;
+            continue;
+        }
+        ++chunksRead;
+
+        const size_t rows = in.chunkRows(k);
+        result.scanned += rows;
+        std::fill(decoded.begin(), decoded.end(), 0);
+        auto column = [&](size_t c) -> const slimcol::Chunk & {
+            if (!decoded[c])
+            {
+                in.read(c, k, chunks[c]);
+                decoded[c] = 1;
+            }
+            return chunks[c];
+        };
+
+        keep.assign(rows, 1);
+        for (size_t p = 0; p < plan.where.size(); ++p)
+        {
+            const slimcol::Chunk &chunk = column(plan.where[p]);
+            for (size_t r = 0; r < rows; ++r)
+            {
+                double v = chunk.number(r);
+                keep[r] = keep[r] && v >= query.where[p].lo && v <= query.where[p].hi;
+            }
+        }
+
+        for (size_t r = 0; r < rows; ++r)
+        {
+            if (!keep[r])
+                continue;
+            ++result.matched;
+            if (query.aggregating())
+            {
+                for (size_t g = 0; g < plan.group.size(); ++g)
+                {
+                    const slimcol::Chunk &chunk = column(plan.group[g]);
+                    key[g].clear();
+                    if (chunk.numeric())
+                        append_key(key[g], chunk.number(r));
+                    else
+                        append_key(key[g], chunk.dict[chunk.codes[r]]);
+                }
+                for (size_t a = 0; a < plan.aggregates.size(); ++a)
+                    values[a] = plan.aggregates[a] < 0 ? 0.0 : column(plan.aggregates[a]).number(r);
+                add_to_group(result.groups, key, values);
+            }
+            else
+            {
+                for (size_t s = 0; s < plan.select.size(); ++s)
+                {
+                    if (s)
+                        result.rows += ',';
+                    column(plan.select[s]).format(r, result.rows);
+                }
+                result.rows += '\n';
+            }
+        }
+    }
+    result.skipped = chunksRead == 0 && in.chunks() > 0;
+}
+
+// Shards from -i: files, or directories of them
+vector<string> list_shards(const string &inputs)
+{
+    vector<string> shards;
+    for (const string &input : splitList(inputs))
+    {
+        if (!fs::is_directory(input))
+        {
+            shards.push_back(input);
+            continue;
+        }
+        vector<string> files;
+        for (const auto &entry : fs::directory_iterator(input))
+        {
+            string path = entry.path().string();
+            if (entry.is_regular_file() && !(path.size() > 6 && path.compare(path.size() - 6, 6, RANGE_SUFFIX) == 0))
+                files.push_back(path);
+        }
+        std::sort(files.begin(), files.end());
+        shards.insert(shards.end(), files.begin(), files.end());
+    }
+    return shards;
+}
+
+void write_number(FILE *out, double value, bool first)
+{
+    char buf[32];
+    if (!first)
+        std::fputc(',', out);
+    if (std::isnan(value))
+    {
+        std::fputs("NA", out);
+        return;
+    }
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    std::fwrite(buf, 1, res.ptr - buf, out);
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "SLiM Query\n"
+    "\n"
+    "This program answers queries over SLiM output shards without loading them: it selects columns of the rows in\n"
+    "ranges, or groups them and aggregates. Shards are queried in parallel, and can be .csv or columnar files from\n"
+    "slimcol. A shard or chunk whose range of a column can't match is skipped without being read: columnar files keep\n"
+    "ranges for every chunk, and .csv shards can be given a range index with -I.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./shards -w generation=10000:10000 -w modelindex=200:300 -g modelindex -a \"mean(phenomean),count\"\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i LIST        Shards to query, delimited by commas: files, or directories of them. Defaults to ./out_slim1T_means.csv.\n"
+    "\n"
+    "-d FILEPATH    Where to write the result. Defaults to the standard output.\n"
+    "\n"
+    "-s LIST        Columns to write for each row that matches, delimited by commas. Defaults to all of them.\n"
+    "\n"
+    "-w COL=LO:HI   Only use rows where COL is between LO and HI, inclusive. Either bound can be left out.\n"
+    "               Can be given more than once.\n"
+    "\n"
+    "-g LIST        Columns to group the rows by, delimited by commas.\n"
+    "\n"
+    "-a LIST        Aggregates to write for each group, delimited by commas: count, n(COL), sum(COL), mean(COL),\n"
+    "               var(COL), sd(COL), se(COL), min(COL) or max(COL). n counts the rows where COL is a number.\n"
+    "               Defaults to count if -g is given.\n"
+    "\n"
+    "-n LIST        Column names of .csv shards, delimited by commas, or the name of one of the model's outputs: means,\n"
+    "               burnin, burnend, opt or muts. Defaults to the output named in each shard's filename, e.g.\n"
+    "               out_slim1T_means.csv.3, or c1, c2, ... for anything else. Any column can be called c1, c2, ...\n"
+    "               The model's outputs are read by each row's width, so the means output's phases line up.\n"
+    "\n"
+    "-H             The .csv shards have a header row to take the column names from.\n"
+    "\n"
+    "-I             Save a range index next to each .csv shard that's read in full (SHARD.range), so later queries\n"
+    "               can skip it. An index is ignored once its shard changes.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "destination",    required_argument,  0,  'd' },
+        { "select",         required_argument,  0,  's' },
+        { "where",          required_argument,  0,  'w' },
+        { "group",          required_argument,  0,  'g' },
+        { "aggregate",      required_argument,  0,  'a' },
+        { "names",          required_argument,  0,  'n' },
+        { "header",         no_argument,        0,  'H' },
+        { "index",          no_argument,        0,  'I' },
+        { "threads",        required_argument,  0,  'T' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string inputs = "./out_slim1T_means.csv";
+    string outFile;
+    string select;
+    string group;
+    string aggregates;
+    vector<string> ranges;
+    Query query;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:d:s:w:g:a:n:HIT:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                inputs = optarg;
+                continue;
+
+            case 'd':
+                outFile = optarg;
+                continue;
+
+            case 's':
+                select = optarg;
+                continue;
+
+            case 'w':
+                ranges.push_back(optarg);
+                continue;
+
+            case 'g':
+                group = optarg;
+                continue;
+
+            case 'a':
+                aggregates = optarg;
+                continue;
+
+            case 'n':
+                query.names = optarg;
+                continue;
+
+            case 'H':
+                query.header = true;
+                continue;
+
+            case 'I':
+                query.index = true;
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        for (const string &spec : ranges)
+            query.where.push_back(parse_range(spec));
+        query.groupBy = splitList(group);
+        for (const string &spec : splitList(aggregates))
+            query.aggregates.push_back(parse_aggregate(spec));
+        if (!query.groupBy.empty() && query.aggregates.empty())
+            query.aggregates.push_back({ COUNT, "", "count" });
+        query.select = splitList(select);
+        if (query.aggregating() && !query.select.empty())
+            throw std::invalid_argument("Select columns (-s) or aggregate them (-g, -a), not both");
+
+        vector<string> shards = list_shards(inputs);
+        vector<ShardResult> results(shards.size());
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(outFile.empty() ? stdout : std::fopen(outFile.c_str(), "w"),
+                                                  outFile.empty() ? [](FILE*) { return 0; } : std::fclose);
+        if (!file)
+            throw std::runtime_error("Can't open " + outFile + " for writing");
+        FILE *out = file.get();
+        std::setvbuf(out, nullptr, _IOFBF, BUFFER_SIZE);
+
+        // Each shard is queried on its own thread. Selected rows are written in shard order, a batch of shards at a
+        // time, so only a batch's rows are held at once; groups are merged as each batch finishes
+        vector<string> header = query.aggregating() ? query.groupBy : query.select;
+        for (const Aggregate &agg : query.aggregates)
+            header.push_back(agg.label);
+        bool headerWritten = false;
+        auto write_header = [&]()
+        {
+            for (size_t c = 0; c < header.size(); ++c)
+                std::fprintf(out, "%s%s", c ? "," : "", header[c].c_str());
+            std::fputc('\n', out);
+            headerWritten = true;
+        };
+        if (!header.empty())
+            write_header();
+
+        Groups groups;
+        size_t scanned = 0, unfit = 0, matched = 0, skipped = 0, chunksSkipped = 0;
+        const size_t batch = 4 * omp_get_max_threads();
+        for (size_t first = 0; first < shards.size(); first += batch)
+        {
+            size_t n = std::min(batch, shards.size() - first);
+            #pragma omp parallel for schedule(dynamic)
+            for (size_t k = first; k < first + n; ++k)
+            {
+                try
+                {
+                    if (slimcol::isColumnar(shards[k]))
+                        query_columnar(query, shards[k], results[k]);
+                    else
+                        query_csv(query, shards[k], results[k]);
+                }
+                catch (const std::exception &e)
+                {
+                    results[k].error = e.what();
+                }
+            }
+            for (size_t k = first; k < first + n; ++k)
+            {
+                ShardResult &result = results[k];
+                if (!result.error.empty())
+                    throw std::runtime_error(result.error);
+                if (!headerWritten && !result.names.empty())
+                {
+                    header = result.names;  // All the columns, named after the first shard read
+                    write_header();
+                }
+                std::fwrite(result.rows.data(), 1, result.rows.size(), out);
+                for (auto &entry : result.groups)
+                {
+                    auto it = groups.find(entry.first);
+                    if (it == groups.end())
+                    {
+                        groups.emplace(entry.first, std::move(entry.second));
+                        continue;
+                    }
+                    for (size_t a = 0; a < entry.second.size(); ++a)
+                        it->second[a].merge(entry.second[a]);
+                }
+                scanned += result.scanned;
+                unfit += result.unfit;
+                matched += result.matched;
+                skipped += result.skipped;
+                chunksSkipped += result.chunksSkipped;
+                result = ShardResult();
+            }
+        }
+
+        // Without groups, the aggregates are over every row that matched, even if none did
+        if (query.aggregating() && query.groupBy.empty() && groups.empty())
+            groups.emplace(vector<string>(), vector<Moments>(query.aggregates.size()));
+        for (const auto &entry : groups)
+        {
+            for (size_t g = 0; g < entry.first.size(); ++g)
+                std::fprintf(out, "%s%s", g ? "," : "", entry.first[g].c_str());
+            for (size_t a = 0; a < query.aggregates.size(); ++a)
+                write_number(out, aggregate_value(query.aggregates[a], entry.second[a]), entry.first.empty() && a == 0);
+            std::fputc('\n', out);
+        }
+        if (std::fflush(out) != 0)
+            throw std::runtime_error("Failed writing to " + (outFile.empty() ? string("the standard output") : outFile));
+
+        if (unfit > 0)
+            std::cerr << "Skipped " << unfit << " of " << scanned << " rows that don't have the query's columns" << endl;
+        if (debug)
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "Matched " << matched << " of " << scanned << " rows read from " << shards.size() - skipped
+                      << " of " << shards.size() << " shards (" << chunksSkipped << " chunks skipped) in " << seconds
+                      << "s" << endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
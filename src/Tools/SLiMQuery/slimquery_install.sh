@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ -std=c++17 -O2 -fopenmp -pthread -o slimquery ./slimquery.cpp
@@ -0,0 +1,62 @@
+// Group the combos of a sweep by their burn-in, for burn-in -> branch jobs
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include "burnin.hpp"
+#include "tables.hpp"
+#include "parse.h"
+
+using std::vector;
+
+void PlanBurnins(FileGenerator &FG)
+{
+  CsvTable combos = ReadTable(FG._combos_dir);
+  if (combos.rows.empty())
+    throw std::runtime_error(FG._combos_dir + " has no combos to plan burn-ins for");
+
+  vector<string> names;
+  vector<int> cols;
+  for (const string &name : splitList(FG._burnin_params))
+  {
+    int col = combos.Column(name);
+    if (col < 0)
+      throw std::runtime_error(FG._combos_dir + " has no column named " + name + " for the burn-in");
+    names.push_back(name);
+    cols.push_back(col);
+  }
+
+  // Burn-ins are numbered in order of their first combo
+  std::map<vector<string>, size_t> burnins;
+  vector<size_t> comboBurnin;
+  comboBurnin.reserve(combos.rows.size());
+  for (const vector<string> &row : combos.rows)
+  {
+    vector<string> key;
+    for (int col : cols)
+      key.push_back(row.at(col));
+    comboBurnin.push_back(burnins.emplace(key, burnins.size() + 1).first->second);
+  }
+
+  // Read by the job after it moves to $TMPDIR, so the path is absolute
+  FG._burnin_plan = std::filesystem::absolute(FG._filename + "_burnins.csv").string();
+  FG._burnin_dir = FG._output_dir + "/" + FG._filename.substr(FG._filename.find_last_of('/') + 1) + "_burnins";
+  FG._nburnins = burnins.size();
+
+  std::ofstream plan(FG._burnin_plan);
+  plan << "combo,burnin";
+  for (const string &n : names)
+    plan << "," << n;
+  plan << "\n";
+  for (size_t j = 0; j < combos.rows.size(); ++j)
+  {
+    plan << j + 1 << "," << comboBurnin[j];
+    for (int col : cols)
+      plan << "," << combos.rows[j][col];
+    plan << "\n";
+  }
+
+  if (FG._verbose)
+    std::cout << combos.rows.size() << " combos branch from " << FG._nburnins << " burn-ins per seed" << std::endl;
+}
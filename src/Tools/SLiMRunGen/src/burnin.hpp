@@ -0,0 +1,12 @@
+#include <string>
+#include <vector>
+#include "generators.hpp"
+
+using std::string;
+#pragma once
+
+// Two-stage sweeps: the burn-in only depends on some of the parameters, so combos that share them can branch from
+// the same burn-in instead of each running their own. Groups the combos by their values of FG._burnin_params,
+// writes the plan (combo,burnin rows, 1-based, followed by the burn-in parameters) for run_slim -B,
+// and sets the plan, the directory for the saved burn-ins and the number of burn-ins on the generator options
+void PlanBurnins(FileGenerator &FG);
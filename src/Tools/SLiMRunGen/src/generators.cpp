@@ -5,12 +5,185 @@
 #include <vector>
 #include <random>
 #include <sstream>
+#include <memory>
 #include "getopt.h"
 #include "generators.hpp"
+#include "template.hpp"
+#include "manifest.hpp"
 
 using std::string;
 using std::vector;
 
+// The name of a file without its directory
+static string BaseName(const string &path)
+{
+  size_t slash = path.find_last_of('/');
+  return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// Script templates: see template.hpp for the syntax. They're compiled once, the first time they're used
+namespace
+{
+  const vector<string> SCRIPT_VARS = {"bashreq", "jobname", "walltime", "nodes", "cores", "mem", "jobarray",
+                                      "native", "launcher", "payload", "filename", "sharddir", "stage", "nbatches",
+                                      "outputdir", "mergetool", "mergename", "mergecores", "seeds", "combos",
+                                      "script", "threads", "parameters", "manifest", "task", "dir", "output",
+                                      "shardid", "mpinodes", "outputs", "param", "slimparams", "rparams",
+                                      "burninplan", "burnindir", "burninjob", "checkpoint", "checkpointdir"};
+
+  const char *ADVERT = "# This code was generated by SLiM Runner: https://github.com/nobrien97/PolygenicSLiMBook/tree/main/src/Tools";
+
+  const char *PBS_TEMPLATE = R"({{bashreq}}
+
+{{advert}}
+
+{{jobname}}
+
+#PBS -l walltime={{walltime}}
+#PBS -l select=1:ncpus={{cores}}:mem={{mem}}
+{{#jobarray}}#PBS -J {{jobarray}}
+{{/jobarray}}
+cd $TMPDIR
+{{^native}}module load R/3.5.0
+{{/native}}SECONDS=0
+
+
+{{#native}}{{launcher}}{{/native}}{{^native}}R --file={{filename}}.R{{/native}}
+
+
+mkdir -p {{sharddir}}
+{{stage}}
+DURATION=$SECONDS
+echo "$(($DURATION / 3600)) hours, $((($DURATION / 60) % 60)) minutes, and $(($DURATION % 60)) seconds elapsed."
+)";
+
+  const char *NIMROD_TEMPLATE = R"({{bashreq}}
+{{jobname}}
+
+#PBS -l walltime={{walltime}}
+#PBS -l select={{nodes}}:ncpus={{cores}}:mem={{mem}}:ompthreads=1
+#NIM shebang /bin/bash
+#NIM parameter BATCH integer range from 1 to {{nbatches}} step 1
+
+if [ -z "${NIMROD_VAR_BATCH}" ]; then
+				echo "\$NIMROD_VAR_BATCH isn't set, cannot continue..."
+				exit 2
+fi
+WORKDIR=${TMPDIR}/batch_${NIMROD_VAR_BATCH}
+mkdir -p ${WORKDIR} && cd ${WORKDIR}
+RUNNAME="{{filename}}"
+OUTFILE="${PBS_O_WORKDIR}/Outputs/${RUNNAME##*/}_${NIMROD_VAR_BATCH}.done"
+echo "${OUTFILE}"
+if [ -f ${OUTFILE} ]; then
+	echo "Output file ${OUTFILE} already exists. Skipping batch ${NIMROD_VAR_BATCH}"
+	exit 0
+fi
+{{launcher}} || exit 1
+
+mkdir -p {{sharddir}}
+{{stage}}cd ${TMPDIR} && rm -rf ${WORKDIR}
+mkdir -p ${PBS_O_WORKDIR}/Outputs && touch ${OUTFILE}
+)";
+
+  const char *MPI_TEMPLATE = R"({{bashreq}}
+
+{{advert}}
+
+{{jobname}}
+
+#PBS -l walltime={{walltime}}
+#PBS -l select={{mpinodes}}:ncpus={{cores}}:mpiprocs=1:ompthreads={{cores}}:mem={{mem}}
+
+cd $TMPDIR
+module load openmpi
+SECONDS=0
+
+
+mpiexec -n {{mpinodes}} --map-by ppr:1:node {{launcher}} -s {{seeds}} -c {{combos}} -x {{script}} -t {{cores}} -S /home/$USER/SLiM/slim{{#parameters}} -p "{{parameters}}"{{/parameters}} -o {{sharddir}} -f "{{outputs}}"
+
+
+DURATION=$SECONDS
+echo "$(($DURATION / 3600)) hours, $((($DURATION / 60) % 60)) minutes, and $(($DURATION % 60)) seconds elapsed."
+)";
+
+  const char *LAUNCHER_TEMPLATE = "{{launcher}} -s {{seeds}} -c {{combos}} -x {{script}} -t {{threads}} -S /home/$USER/SLiM/slim"
+                                  "{{#parameters}} -p \"{{parameters}}\"{{/parameters}}{{#manifest}} -m {{manifest}} -k {{task}}{{/manifest}}"
+                                  "{{#burninplan}} -B {{burninplan}} -D {{burnindir}}{{#burninjob}} -I{{/burninjob}}{{/burninplan}}"
+                                  "{{#checkpoint}} -C {{checkpointdir}} -G {{checkpoint}} -L $TMPDIR{{/checkpoint}}";
+
+  const char *STAGE_TEMPLATE = "if [ -f {{dir}}/{{output}} ]; then cp {{dir}}/{{output}} {{sharddir}}/{{output}}.shard{{shardid}}; fi\n";
+
+  const char *MERGE_TEMPLATE = R"({{bashreq}}
+
+{{advert}}
+
+#PBS -N {{mergename}}
+#PBS -l walltime=1:00:00
+#PBS -l select=1:ncpus={{mergecores}}:mem=8GB
+
+{{mergetool}} -i {{sharddir}} -d {{outputdir}} -r -v
+)";
+
+  const char *SUBMIT_TEMPLATE = R"(#!/bin/bash
+# Submit the job, then the merge to run once it has finished successfully
+{{#burninjob}}BURNIN=$(qsub {{filename}}_burnin.pbs)
+JOBID=$(qsub -W depend=afterok:$BURNIN {{filename}}.pbs)
+{{/burninjob}}{{^burninjob}}JOBID=$(qsub {{filename}}.pbs)
+{{/burninjob}}qsub -W depend=afterok:$JOBID {{filename}}_merge.pbs
+)";
+
+  const char *R_TEMPLATE = R"(# Code generated by SLiM Runner: https://github.com/nobrien97/PolygenicSLiMBook/tree/main/src/Tools/SLiMRunGen
+USER <- Sys.getenv('USER')
+
+library(foreach)
+library(doParallel)
+library(future)
+
+cl <- makeCluster(future::availableCores())
+
+registerDoParallel(cl)
+seeds <- read.csv("{{seeds}}", header = T)
+combos <- read.csv("{{combos}}", header = T)
+{{#manifest}}manifest <- read.csv("{{manifest}}", header = T)
+task <- as.integer(Sys.getenv("PBS_ARRAY_INDEX", "1"))
+runs <- manifest[manifest$task == task, ]
+
+foreach(r=1:nrow(runs)) %dopar% {
+		i <- runs$combo[r]
+		j <- seeds$Seed[runs$seed[r]]
+{{/manifest}}{{^manifest}}foreach(i=1:nrow(combos)) %:%
+	foreach(j=seeds$Seed) %dopar% {
+{{/manifest}}		slim_out <- system(sprintf("/home/$USER/SLiM/slim -s %s {{slimparams}}{{script}}", as.character(j){{rparams}}), intern=T)
+  }
+stopCluster(cl)
+)";
+
+  // Every template is compiled against one set of variables, and the advert is the same everywhere.
+  // Each script takes a copy to fill in, as the values are views of its own locals
+  const TemplateVars &ScriptVars()
+  {
+    static TemplateVars vars = []()
+    {
+      vector<string> names = SCRIPT_VARS;
+      names.emplace_back("advert");
+      TemplateVars v(names);
+      v.Set("advert", ADVERT);
+      return v;
+    }();
+    return vars;
+  }
+
+  const Template &Compiled(const char *source)
+  {
+    static std::vector<std::pair<const char*, std::unique_ptr<Template>>> cache;
+    for (const auto &entry : cache)
+      if (entry.first == source)
+        return *entry.second;
+    cache.emplace_back(source, std::make_unique<Template>(source, ScriptVars()));
+    return *cache.back().second;
+  }
+}
+
 // Define class member functions
 
 void FileGenerator::FileGenerate() {}
@@ -32,170 +205,203 @@ string FileGenerator::MemG(const char *input)
 }
 
 
-void FileGenerator::file_save(const vector<string> &file, const string filename)
+void FileGenerator::file_save(const string &contents, const string filename)
 {
-  std::ofstream outfile(filename);
-
-  for (int i = 0; i < file.size(); ++i)
-  {
-    outfile << file[i] << "\n";
-  }
+  std::ofstream outfile(filename, std::ios::binary);
+  outfile.write(contents.data(), contents.size());
 }
 
-PBSGenerator::PBSGenerator(const FileGenerator &FG)
+PBSGenerator::PBSGenerator(const FileGenerator &FG) : FileGenerator(FG)
 {
-  PBS_SetVars(FG);
+  // If we're nimrod, set a few values differently
+  if (FG._nimrod)
+  {
+    NSH_SetVars();
+  }
 }
 
 void PBSGenerator::FileGenerate()
 {
-  _jobname += "\n";
-  _walltime = "#PBS -l walltime=" + _walltime;
+  TemplateVars vars = ScriptVars();
+  string cores = std::to_string(_cores);
+  string sharddir = ShardDir();
+  vars.Set("bashreq", _bashreq);
+  vars.Set("jobname", _jobname);
+  vars.Set("walltime", _walltime);
+  vars.Set("cores", cores);
+  vars.Set("mem", _mem);
+  vars.Set("filename", _filename);
+  vars.Set("sharddir", sharddir);
 
   if (_nimrod == false)
   {
-    // Add \n to options
-
-    // Set up the script with the first few necessary parts of the script
-    vector<string> scriptLines = {_bashreq, _jobname, _walltime};
-    // Add the cores and memory
-    string coresMem = "#PBS -l select=1:ncpus=" + std::to_string(_cores) + ":mem=" + _mem;
-    scriptLines.emplace_back(coresMem);
-
-    if (_jobarray.size())
-    {
-      string jobArrString = "#PBS -J " + _jobarray;
-      scriptLines.emplace_back(jobArrString);
-    }
-
-    string scriptSetup = "\ncd $TMPDIR\nmodule load R/3.5.0\nSECONDS=0\n";
-    scriptLines.emplace_back(scriptSetup);
-
-    string sublaunchR = "\nR --file=" + _filename + ".R\n";
-    scriptLines.emplace_back(sublaunchR);
-
-    vector<string> outputStrings = {"out_stabsel_means.csv",
-                                    "out_stabsel_muts.csv",
-                                    "out_stabsel_burnin.csv",
-                                    "out_stabsel_opt.csv",
-                                    "out_stabsel_dict.csv",
-                                    "out_stabsel_pos.csv"};
-
-    for (const string &str : outputStrings)
-    {
-      scriptLines.emplace_back("cat /$TMPDIR/" + str + " >> /30days/$USER/" + str);
-    }
-
-    string timer = "\nDURATION=$SECONDS";
-    scriptLines.emplace_back(timer);
-    string timeLine = "echo \"$(($DURATION / 3600)) hours, $((($DURATION / 60) % 60)) minutes, and $(($DURATION % 60)) seconds elapsed.\"";
-    scriptLines.emplace_back(timeLine);
-
-    // Add a cool(tm) advertisement
-    scriptLines.insert(scriptLines.begin()+1, "\n# This code was generated by SLiM Runner: https://github.com/nobrien97/PolygenicSLiMBook/tree/main/src/Tools\n");
-
-    file_save(scriptLines, _filename + ".pbs");
+    string launcher = _native ? LauncherCall("${PBS_ARRAY_INDEX:-1}", _cores) : "";
+    string stage = StageOutputs("$TMPDIR", "${PBS_ARRAY_INDEX:-0}");
+    vars.Set("jobarray", _jobarray);
+    vars.Set("native", _native ? "1" : "");
+    vars.Set("launcher", launcher);
+    vars.Set("stage", stage);
+    file_save(Compiled(PBS_TEMPLATE).Render(vars), _filename + ".pbs");
+
+    if (!_burnin_plan.empty())
+      BurninGenerate();
   }
   else {
-    // Write a Nimrod script instead
-    vector<string> scriptLines = {_bashreq, _jobname, _walltime};
-    // Attach ompthreads and nodes to cores/memory info as well
-    string coresMem = "#PBS -l select=" + std::to_string(_nodes) + ":ncpus=" + std::to_string(_cores) + ":mem=" + _mem +":ompthreads=1";
-    scriptLines.emplace_back(coresMem);
-    // Add this line because it needs to be there for nimrod to work
-    scriptLines.emplace_back("#NIM shebang /bin/bash");
-
-  // Add parameters
-    string nimPars =  "#NIM parameter LS integer range from 1 to "+ std::to_string(_comboSize) + " step 1\n#NIM parameter SEED integer range from 1 to 50 step 1\n"; 
-    scriptLines.emplace_back(nimPars);
-
-    scriptLines.emplace_back("if [ -z \"${NIMROD_VAR_LS}\" ]; then\n"
-                              "\t\t\t\techo \"\\$NIMROD_VAR_LS isn't set, cannot continue...\"\n"
-                              "\t\t\t\texit 2\n"
-                              "fi");
-
-    scriptLines.emplace_back("if [ -z \"${NIMROD_VAR_SEED}\" ]; then\n"
-                              "\t\t\t\techo \"\\$NIMROD_VAR_SEED isn't set, cannot continue...\"\n"
-                              "\t\t\t\texit 2\n"
-                              "fi");
-
-  // Now we can actually write the script!
-
-  scriptLines.emplace_back("cd ${TMPDIR}");
-  scriptLines.emplace_back("RUNNAME=\"" + _filename + "\"");
-  scriptLines.emplace_back("OUTFILE=\"${PBS_O_WORKDIR}/Outputs/TEST_${NIMROD_VAR_LS}_${NIMROD_VAR_SEED}.txt\"\necho \"${OUTFILE}\"");
+    // Write a Nimrod script instead: one job per batch of runs from the manifest, rather than one per seed and combo.
+    // Nimrod runs several batches at once on a node, so each gets its own directory for its outputs, and the
+    // whole batch runs in-process, one run at a time on the job's core
+    string nodes = std::to_string(_nodes);
+    string nbatches = std::to_string(_nbatches);
+    string launcher = LauncherCall("${NIMROD_VAR_BATCH}", 1);
+    string stage = StageOutputs("${WORKDIR}", "${NIMROD_VAR_BATCH}");
+    vars.Set("nodes", nodes);
+    vars.Set("nbatches", nbatches);
+    vars.Set("launcher", launcher);
+    vars.Set("stage", stage);
+    file_save(Compiled(NIMROD_TEMPLATE).Render(vars), _filename + ".pbs");
+  }
 
-  scriptLines.emplace_back("if [ -f ${OUTFILE} ]; then\n"
-                              "\techo \"Output file ${OUTFILE} already exists. Skipping this index value ${NIMROD_VAR_LS} ${NIMROD_VAR_SEED}\"\n"
-                              "\texit 0\n"
-                              "fi");  
+  MergeGenerate();
+}
 
+// Each task copies its outputs from its node-local directory into shards of its own, named OUTPUT.shardID, in one
+// sequential write per file. Nothing appends to the shared outputs while the tasks run: the merge job does that
+string PBSGenerator::StageOutputs(const string &dir, const string &shardId) const
+{
+  TemplateVars vars = ScriptVars();
+  string sharddir = ShardDir();
+  vars.Set("dir", dir);
+  vars.Set("shardid", shardId);
+  vars.Set("sharddir", sharddir);
+
+  const Template &line = Compiled(STAGE_TEMPLATE);
+  string stage;
+  for (const string &str : _outputs)
+  {
+    vars.Set("output", str);
+    line.Render(vars, stage);
+  }
+  return stage;
+}
 
-  scriptLines.emplace_back("RSCRIPTNAME=\"${PBS_O_WORKDIR}/R/${RUNNAME}.R\"");
+// The run_slim call for a task: the whole sweep, or with packing just the task's rows of the manifest.
+// Two-stage jobs branch from their saved burn-ins, or run every burn-in
+string PBSGenerator::LauncherCall(const string &task, int threads, bool burnins) const
+{
+  TemplateVars vars = ScriptVars();
+  string nthreads = std::to_string(threads);
+  string manifest = burnins ? "" : _manifest_dir.empty() ? _manifest : TaskManifest(_manifest_dir, task);
+  vars.Set("launcher", _launcher);
+  vars.Set("seeds", _seeds_dir);
+  vars.Set("combos", _combos_dir);
+  vars.Set("script", _slim_path);
+  vars.Set("threads", nthreads);
+  vars.Set("parameters", _parameters);
+  vars.Set("manifest", manifest);
+  vars.Set("task", task);
+  vars.Set("burninplan", _burnin_plan);
+  vars.Set("burnindir", _burnin_dir);
+  vars.Set("burninjob", burnins ? "1" : "");
+
+  // Checkpoints are kept with the outputs, so resubmitting the job picks up where it was cut off
+  string checkpoint = _checkpoint_every > 0 && !burnins ? std::to_string(_checkpoint_every) : "";
+  string checkpointdir = _output_dir + "/" + BaseName(_filename) + "_checkpoints";
+  vars.Set("checkpoint", checkpoint);
+  vars.Set("checkpointdir", checkpointdir);
+  return Compiled(LAUNCHER_TEMPLATE).Render(vars);
+}
 
-  scriptLines.emplace_back("module purge\nmodule load R/3.5.0-gnu");
+string PBSGenerator::ShardDir() const
+{
+  return _output_dir + "/" + BaseName(_filename) + "_shards";
+}
 
-  scriptLines.emplace_back("Rscript $RSCRIPTNAME ${NIMROD_VAR_SEED} ${NIMROD_VAR_LS}");
+// A job to merge the shards into the shared outputs once every task has succeeded, and a script to submit both
+void PBSGenerator::MergeGenerate()
+{
+  TemplateVars vars = ScriptVars();
+  string mergename = BaseName(_filename) + "_merge";
+  string mergecores = std::to_string(_outputs.size());
+  string sharddir = ShardDir();
+  string bashreq = _nimrod ? "#!/bin/bash -l\n#PBS -q workq\n#PBS -A qris-uq" : _bashreq;
+  vars.Set("bashreq", bashreq);
+  vars.Set("mergename", mergename);
+  vars.Set("mergecores", mergecores);
+  vars.Set("mergetool", _merge_tool);
+  vars.Set("sharddir", sharddir);
+  vars.Set("outputdir", _output_dir);
+  vars.Set("filename", _filename);
+  vars.Set("burninjob", _burnin_plan.empty() ? "" : "1");
+  file_save(Compiled(MERGE_TEMPLATE).Render(vars), _filename + "_merge.pbs");
+  file_save(Compiled(SUBMIT_TEMPLATE).Render(vars), _filename + "_submit.sh");
+}
 
-  vector<string> outputStrings = {"out_stabsel_means.csv",
-                                    "out_stabsel_muts.csv",
-                                    "out_stabsel_burnin.csv",
-                                    "out_stabsel_opt.csv",
-                                    "out_stabsel_dict.csv",
-                                    "out_stabsel_pos.csv"};
+// A single job that runs every burn-in with run_slim -I, for the branch job to wait on. Burn-in outputs are staged to
+// a shard of their own, so the merge job picks them up with the rest
+void PBSGenerator::BurninGenerate()
+{
+  TemplateVars vars = ScriptVars();
+  string jobname = NameWrap((BaseName(_filename) + "_burnin").c_str());
+  string cores = std::to_string(_cores);
+  string sharddir = ShardDir();
+  string launcher = LauncherCall("", _cores, true);
+  string stage = StageOutputs("$TMPDIR", "burnin");
+  vars.Set("bashreq", _bashreq);
+  vars.Set("jobname", jobname);
+  vars.Set("walltime", _walltime);
+  vars.Set("cores", cores);
+  vars.Set("mem", _mem);
+  vars.Set("filename", _filename);
+  vars.Set("sharddir", sharddir);
+  vars.Set("native", "1");
+  vars.Set("launcher", launcher);
+  vars.Set("stage", stage);
+  file_save(Compiled(PBS_TEMPLATE).Render(vars), _filename + "_burnin.pbs");
+}
 
-    for (const string &str : outputStrings)
+    void PBSGenerator::NSH_SetVars()
     {
-      scriptLines.emplace_back("cat /$TMPDIR/" + str + " >> /30days/$USER/" + str);
+      this->_bashreq = "#!/sw7/RCC/NimrodG/embedded-1.9.0/bin/nimexec\n#PBS -A qris-uq\n#PBS -q workq";
     }
 
+    MPIGenerator::MPIGenerator(const FileGenerator &FG) : PBSGenerator(FG) {}
 
-  }
-}
-    void PBSGenerator::PBS_SetVars(const FileGenerator &FG)
+    void MPIGenerator::FileGenerate()
     {
-      this->_filename = FG._filename;
-      this->_bashreq = FG._bashreq;
-      this->_jobname = FG._jobname;
-      this->_jobarray = FG._jobarray;
-      this->_walltime = FG._walltime;
-      this->_cores = FG._cores;
-      this->_mem = FG._mem;
-      this->_parameters = FG._parameters;
-      this->_verbose = FG._verbose;
-      this->_nimrod = FG._nimrod;
-      this->_r_only = FG._r_only;
-      this->_pbs_only = FG._pbs_only;
-    // If we're nimrod, set a few values differently
-      if (FG._nimrod) {
-        NSH_SetVars(FG);
+      // One MPI rank per node, which runs SLiM on every core of its node. Each node's $TMPDIR is its own,
+      // so every rank copies its outputs to a shard of its own when it's done
+      TemplateVars vars = ScriptVars();
+      string cores = std::to_string(_cores);
+      string mpinodes = std::to_string(_mpi_nodes);
+      string sharddir = ShardDir();
+      string outputs;
+      for (const string &str : _outputs)
+      {
+        outputs += (outputs.size() ? "," : "") + str;
       }
+      vars.Set("bashreq", _bashreq);
+      vars.Set("jobname", _jobname);
+      vars.Set("walltime", _walltime);
+      vars.Set("mpinodes", mpinodes);
+      vars.Set("cores", cores);
+      vars.Set("mem", _mem);
+      vars.Set("launcher", _mpi_launcher);
+      vars.Set("seeds", _seeds_dir);
+      vars.Set("combos", _combos_dir);
+      vars.Set("script", _slim_path);
+      vars.Set("parameters", _parameters);
+      vars.Set("sharddir", sharddir);
+      vars.Set("outputs", outputs);
+      file_save(Compiled(MPI_TEMPLATE).Render(vars), _filename + ".pbs");
+      MergeGenerate();
     }
 
-    void PBSGenerator::NSH_SetVars(const FileGenerator &FG)
-    {
-      this->_bashreq = "#!/sw7/RCC/NimrodG/embedded-1.9.0/bin/nimexec\n#PBS -A qris-uq\n#PBS -q workq";
-      this->_comboSize = FG._comboSize;
-
-    }
-
-    RGenerator::RGenerator(const FileGenerator &FG)
-    {
-      R_SetVars(FG);
-    }
+    RGenerator::RGenerator(const FileGenerator &FG) : FileGenerator(FG) {}
 
     void RGenerator::FileGenerate()
     {
       if (_nimrod == false)
       {
-        vector<string> RScriptLines = {"# Code generated by SLiM Runner: https://github.com/nobrien97/PolygenicSLiMBook/tree/main/src/Tools/SLiMRunGen\n"
-                                       "USER <- Sys.getenv('USER')\n",
-                                       "library(foreach)\nlibrary(doParallel)\nlibrary(future)\n",
-                                       "cl <- makeCluster(future::availableCores())\n",
-                                       "registerDoParallel(cl)"};
-
-        RScriptLines.emplace_back("seeds <- read.csv(\"" + _seeds_dir + "\", header = T)");
-        RScriptLines.emplace_back("combos <- read.csv(\"" + _combos_dir + "\", header = T)");
         std::stringstream ss(_parameters);
         vector<string> params;
 
@@ -203,49 +409,31 @@ void PBSGenerator::FileGenerate()
         {
           string substr;
           std::getline(ss, substr, ',');
-          params.emplace_back(substr);
+          if (substr.size())
+            params.emplace_back(substr);
         }
 
-        RScriptLines.emplace_back("foreach(i=1:nrow(combos)) %:%\n"
-                               "\tforeach(j=seeds$Seed) %dopar% {\n"
-                               "\t\tslim_out <- system(sprintf(\"/home/$USER/SLiM/slim -s %s "
-                               );
-
         /* Add SLiM parameter list into a single command line string: 
     treating all variables as strings for feeding into sprintf, should be fine */
-        string slimParamList;
+        TemplateVars vars = ScriptVars();
+        const Template &slimParam = Compiled("-d {{param}}=%s ");
+        const Template &rParam = Compiled(", combos[i,]${{param}}");
+        string slimParamList, rParamList;
 
-        for (string param : params)
+        for (const string &param : params)
         {
-          slimParamList += "-d " + param + "=%s ";
+          vars.Set("param", param);
+          slimParam.Render(vars, slimParamList);
+          rParam.Render(vars, rParamList);
         }
-        slimParamList = slimParamList + _slim_path + "\"";
-        string rParamList;
 
-        for (int i = 0; i < params.size(); ++i)
-        {
-          rParamList += "combos[i,]$" + params[i] + ", ";
-        }
-
-        // Attach the parameter list to the end, as well as the slim directory
-        *(RScriptLines.end() - 1) += slimParamList + ", " + "as.character(j), " + rParamList + "intern=T))";
-        RScriptLines.emplace_back("  }\n"
-                               "stopCluster(cl)");
-        file_save(RScriptLines, _filename + ".R");
+        // Packed jobs: each array task only runs its own rows of the manifest
+        vars.Set("seeds", _seeds_dir);
+        vars.Set("combos", _combos_dir);
+        vars.Set("manifest", _manifest);
+        vars.Set("script", _slim_path);
+        vars.Set("slimparams", slimParamList);
+        vars.Set("rparams", rParamList);
+        file_save(Compiled(R_TEMPLATE).Render(vars), _filename + ".R");
       }
     }
-
-    void RGenerator::R_SetVars(const FileGenerator &FG)
-    {
-      this->_filename = FG._filename;
-      this->_LHC = FG._LHC;
-      this->_LHC_dir = FG._LHC_dir;
-      this->_seeds_dir = FG._seeds_dir;
-      this->_parameters = FG._parameters;
-      this->_verbose = FG._verbose;
-      this->_nimrod = FG._nimrod;
-      this->_slim_path = FG._slim_path;
-      this->_r_only = FG._r_only;
-      this->_pbs_only = FG._pbs_only;
-      this->_combos_dir = FG._combos_dir;
-    }
@@ -40,7 +40,39 @@ public:
     int _cores = 24;
     string _mem = "120G";
     int _nodes = 0;
-    int _comboSize = 100;
+    int _comboSize = 0; // Number of combos to run with Nimrod, or 0 for all of them
+    int _batch = 1; // Runs per Nimrod job
+    size_t _nbatches = 0;
+    string _output_dir = "/30days/$USER";
+    string _merge_tool = "shardmerge";
+    bool _native = false;
+    string _launcher = "run_slim";
+    int _mpi_nodes = 0;
+    string _mpi_launcher = "mpi_run_slim";
+
+    // Work packing variables
+    bool _pack = false;
+    string _costs_dir;
+    double _run_cost = 3600; // Estimated seconds per run when there are no per-combo costs
+    string _manifest;
+    bool _split_manifests = false; // Also write a manifest per task, to _manifest_dir
+    string _manifest_dir;
+
+    // Burn-in -> branch variables
+    string _burnin_params; // Combos columns the burn-in depends on
+    string _burnin_plan;
+    string _burnin_dir;
+    size_t _nburnins = 0;
+
+    // Checkpoint variables
+    long _checkpoint_every = 0; // Generations between checkpoints in run_slim, or 0 for none
+
+    // Resource prediction variables
+    string _history_dir;
+    double _margin = 1.2; // Safety margin on predicted walltime and memory
+    bool _walltime_set = false;
+    bool _mem_set = false;
+    std::vector<double> _run_costs; // Predicted seconds per run of each combo
 
     // R Variables
     bool _LHC = false;
@@ -52,7 +84,7 @@ public:
 
 protected:
     // Basic function to save the file once it has been constructed
-    void file_save(const std::vector<std::string> &file, const std::string filename);
+    void file_save(const std::string &contents, const std::string filename);
 };
 
 class PBSGenerator : public FileGenerator
@@ -64,8 +96,35 @@ public:
     void FileGenerate() override;
 
 protected:
-    void PBS_SetVars(const FileGenerator &FG);
-    void NSH_SetVars(const FileGenerator &FG);
+    void NSH_SetVars();
+
+    // Stage outputs through per-task shards, and merge them in a dependent job
+    string StageOutputs(const string &dir, const string &shardId) const;
+    string ShardDir() const;
+
+    // Command line for the native launcher, run_slim
+    string LauncherCall(const string &task, int threads, bool burnins = false) const;
+    void MergeGenerate();
+
+    // The first stage of a two-stage job: every burn-in, saved for the branch runs to start from
+    void BurninGenerate();
+
+    // The outputs of src/SLiM/Chp5-1_1T.slim
+    std::vector<string> _outputs = {"out_slim1T_means.csv",
+                                    "out_slim1T_muts.csv",
+                                    "out_slim1T_burnin.csv",
+                                    "out_slim1T_burnend.csv",
+                                    "out_slim1T_opt.csv",
+                                    "out_slim1T_pos.csv"};
+};
+
+// One PBS job spread over many nodes by mpi_run_slim, which hands out runs to every node from a shared queue
+class MPIGenerator : public PBSGenerator
+{
+public:
+    MPIGenerator(const FileGenerator &FG);
+
+    void FileGenerate() override;
 };
 
 class RGenerator : public FileGenerator
@@ -75,7 +134,4 @@ public:
     RGenerator(const FileGenerator &FG);
 
     void FileGenerate() override;
-
-protected:
-    void R_SetVars(const FileGenerator &FG);
 };
\ No newline at end of file
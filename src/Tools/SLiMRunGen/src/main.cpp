@@ -8,7 +8,10 @@
 #include <vector>
 #include <random>
 #include "getopt.h"
-#include "generators.cpp"
+#include "generators.hpp"
+#include "packing.hpp"
+#include "predict.hpp"
+#include "burnin.hpp"
 #include "main.hpp"
 #include "string.h"
 
@@ -40,6 +43,22 @@ using std::string;
         { "PBS-only",       no_argument,        0,  'P' },
         { "combo-dir",      required_argument,  0,  'l' },
         { "seed-dir",       required_argument,  0,  'S' },
+        { "pack",           no_argument,        0,  'k' },
+        { "costs",          required_argument,  0,  'C' },
+        { "run-estimate",   required_argument,  0,  'e' },
+        { "script",         required_argument,  0,  'x' },
+        { "native",         no_argument,        0,  'X' },
+        { "launcher",       required_argument,  0,  'L' },
+        { "batch",          required_argument,  0,  'b' },
+        { "mpi",            required_argument,  0,  'I' },
+        { "mpi-launcher",   required_argument,  0,  'B' },
+        { "output-dir",     required_argument,  0,  'O' },
+        { "merge-tool",     required_argument,  0,  'G' },
+        { "history",        required_argument,  0,  'H' },
+        { "margin",         required_argument,  0,  'M' },
+        { "split-manifests",no_argument,        0,  'K' },
+        { "burnin",         required_argument,  0,  'D' },
+        { "checkpoint",     required_argument,  0,  'Q' },
         {0,0,0,0}
     };
 
@@ -75,7 +94,11 @@ void doHelp(char* appname) {
     "-p LIST        Provide a list of SLiM parameters to vary, delimited by commas.\n"
     "               Example: -p \"nloci,Ne,param1,param2\"\n"
     "\n"
-    "-n             Specify if you would like to generate a Nimrod script.\n"
+    "-n[N]          Specify if you would like to generate a Nimrod script, optionally for only the first N combos.\n"
+    "               Each Nimrod job runs a batch of seed x combo runs from FILEPATH_manifest.csv with run_slim (see -L),\n"
+    "               and the number of seeds comes from the seeds file.\n"
+    "\n"
+    "-b N           Specify the number of runs in each Nimrod job. Defaults to 1.\n"
     "\n"
     "-o N           Specify the number of nodes to use in your Nimrod script.\n"
     "               Example: -o 10\n"
@@ -89,6 +112,57 @@ void doHelp(char* appname) {
     "\n"
     "-S             Specify the filepath of the seeds file.\n"
     "               Example: -S ~/Seeds.csv\n"
+    "\n"
+    "-k             Pack every seed x combo run into a job array, with each task filling a node for the walltime.\n"
+    "               Writes the runs for each task to FILEPATH_manifest.csv and sets -J to match. Each task reads\n"
+    "               only its own rows, through the index in FILEPATH_manifest.csv.idx.\n"
+    "\n"
+    "-K             Also write a manifest of its own for every task or Nimrod job, to FILEPATH_manifests/task_N.csv,\n"
+    "               and have each task read that instead of the shared manifest.\n"
+    "\n"
+    "-C FILEPATH    Specify a .csv with a cost column of estimated run times in seconds, one row per combo, for -k.\n"
+    "               Defaults to a cost column in the combos file if there is one.\n"
+    "\n"
+    "-e HH:MM:SS    Specify the estimated time for a single run, for combos without a cost. Defaults to 1:00:00.\n"
+    "\n"
+    "-x FILEPATH    Specify the filepath of the SLiM script to run. Defaults to ~/Desktop/slimrun.slim.\n"
+    "\n"
+    "-X             Launch SLiM with the native run_slim launcher instead of an R script, so no R is needed on the nodes.\n"
+    "               Only a .PBS file is generated. Nimrod scripts always use run_slim.\n"
+    "\n"
+    "-L FILEPATH    Specify the filepath of run_slim for -X. Defaults to run_slim.\n"
+    "\n"
+    "-I N           Generate a single .PBS job over N nodes, with mpi_run_slim handing out runs to every node from\n"
+    "               a shared queue, instead of an array or Nimrod. No .R file is needed.\n"
+    "               Example: -I 20\n"
+    "\n"
+    "-B FILEPATH    Specify the filepath of mpi_run_slim for -I. Defaults to mpi_run_slim.\n"
+    "\n"
+    "-O DIRECTORY   Specify the shared directory for outputs. Defaults to /30days/$USER.\n"
+    "               Each task copies its outputs from $TMPDIR to its own shard in DIRECTORY/NAME_shards, and a merge job\n"
+    "               (FILEPATH_merge.pbs) appends them to the outputs in DIRECTORY once every task has finished.\n"
+    "               Submit both with FILEPATH_submit.sh.\n"
+    "\n"
+    "-G FILEPATH    Specify the filepath of the shardmerge tool used by the merge job. Defaults to shardmerge.\n"
+    "\n"
+    "-H FILEPATH    Specify a .csv of past runs to predict walltime and memory from, instead of the defaults.\n"
+    "               Needs the combo parameters of each run, walltime (seconds or HH:MM:SS) and maxrss (kilobytes),\n"
+    "               and optionally model (the SLiM script name) to only use runs of the same model.\n"
+    "               Example: -H ~/history.csv\n"
+    "\n"
+    "-M X           Specify the safety margin to multiply predicted walltime and memory by. Defaults to 1.2.\n"
+    "\n"
+    "-D LIST        Split the job in two: burn-ins, then branches. Give the parameters the burn-in depends on,\n"
+    "               delimited by commas. One burn-in per seed runs for each set of their values in a job of its own\n"
+    "               (FILEPATH_burnin.pbs), saving its population to DIRECTORY/NAME_burnins (see -O), and every run\n"
+    "               of the main job starts from its burn-in. Combos map to burn-ins in FILEPATH_burnins.csv.\n"
+    "               Implies -X, and needs a SLiM script with burninOnly and burninFile (e.g. Chp5-1_1T.slim).\n"
+    "               Example: -D \"Ne,mu,rwide,nloci,burnTime\"\n"
+    "\n"
+    "-Q N           Have run_slim checkpoint every run every N generations, to DIRECTORY/NAME_checkpoints (see -O).\n"
+    "               If the job is cut off by the walltime, submit it again to resume each run from its last checkpoint.\n"
+    "               Only applies with -X, and needs a SLiM script with checkpointEvery and checkpointFile\n"
+    "               (e.g. Chp5-1_1T.slim).\n"
     "\n",
     appname,
     appname
@@ -114,18 +188,34 @@ int main(int argc, char* argv[]) {
         { "PBS-Only",       no_argument,        0,  'P' },
         { "combo-dir",      required_argument,  0,  'l' },
         { "seed-dir",       required_argument,  0,  'S' },
+        { "pack",           no_argument,        0,  'k' },
+        { "costs",          required_argument,  0,  'C' },
+        { "run-estimate",   required_argument,  0,  'e' },
+        { "script",         required_argument,  0,  'x' },
+        { "native",         no_argument,        0,  'X' },
+        { "launcher",       required_argument,  0,  'L' },
+        { "batch",          required_argument,  0,  'b' },
+        { "mpi",            required_argument,  0,  'I' },
+        { "mpi-launcher",   required_argument,  0,  'B' },
+        { "output-dir",     required_argument,  0,  'O' },
+        { "merge-tool",     required_argument,  0,  'G' },
+        { "history",        required_argument,  0,  'H' },
+        { "margin",         required_argument,  0,  'M' },
+        { "split-manifests",no_argument,        0,  'K' },
+        { "burnin",         required_argument,  0,  'D' },
+        { "checkpoint",     required_argument,  0,  'Q' },
         {0,0,0,0}
     };
 
     int optionindex = 0;
-    int options;
+    int options = 0;
     FileGenerator fileinit; // Initialiser for PBSGen and RGen
 
 
     while (options != -1) {
 
 
-        options = getopt_long(argc, argv, "N:d:hvJ:w:nc:m:s:RPS:l:", voptions, &optionindex);
+        options = getopt_long(argc, argv, "N:d:hvJ:w:n::c:m:p:o:RPS:l:kC:e:x:XL:b:I:B:O:G:H:M:KD:Q:", voptions, &optionindex);
 
         switch (options) {
             case 'N':
@@ -150,12 +240,13 @@ int main(int argc, char* argv[]) {
 
             case 'w':
                 fileinit._walltime = optarg; // job walltime in hh:mm:ss
+                fileinit._walltime_set = true;
                 continue;
 
             case 'n':
             {
                 fileinit._nimrod = true; // nimrod yes or no
-                fileinit._comboSize = strlen(optarg) ? std::stoi(optarg) : 100; // set combosize to the argument if it is given
+                fileinit._comboSize = optarg ? std::stoi(optarg) : 0; // set combosize to the argument if it is given
                 continue;
             }
             case 'c':
@@ -164,6 +255,7 @@ int main(int argc, char* argv[]) {
 
             case 'm':
                 fileinit._mem = fileinit.MemG(optarg); // how much memory to use
+                fileinit._mem_set = true;
                 continue;
 
             case 'p':
@@ -188,14 +280,104 @@ int main(int argc, char* argv[]) {
             
             case 'S':
                 fileinit._seeds_dir = optarg; // path to seeds file
+                continue;
+
+            case 'k':
+                fileinit._pack = true; // pack seed x combo runs into array tasks
+                continue;
+
+            case 'C':
+                fileinit._costs_dir = optarg; // path to per-combo cost estimates
+                continue;
+
+            case 'e':
+                fileinit._run_cost = WalltimeSeconds(optarg); // estimated time per run
+                continue;
+
+            case 'x':
+                fileinit._slim_path = optarg; // path to the SLiM script
+                continue;
+
+            case 'X':
+                fileinit._native = true; // launch SLiM with run_slim instead of R
+                continue;
+
+            case 'L':
+                fileinit._launcher = optarg; // path to run_slim
+                continue;
+
+            case 'b':
+                fileinit._batch = std::stoi(optarg); // runs per Nimrod job
+                continue;
+
+            case 'I':
+                fileinit._mpi_nodes = std::stoi(optarg); // number of nodes for an MPI job
+                continue;
+
+            case 'B':
+                fileinit._mpi_launcher = optarg; // path to mpi_run_slim
+                continue;
+
+            case 'O':
+                fileinit._output_dir = optarg; // shared directory for the merged outputs
+                continue;
+
+            case 'G':
+                fileinit._merge_tool = optarg; // path to shardmerge
+                continue;
+
+            case 'H':
+                fileinit._history_dir = optarg; // path to telemetry of past runs
+                continue;
+
+            case 'M':
+                fileinit._margin = std::stod(optarg); // safety margin on predicted resources
+                continue;
+
+            case 'K':
+                fileinit._split_manifests = true; // a manifest file per task as well
+                continue;
+
+            case 'D':
+                fileinit._burnin_params = optarg; // parameters the burn-in depends on
+                continue;
+
+            case 'Q':
+                fileinit._checkpoint_every = std::stol(optarg); // generations between checkpoints
+                continue;
 
             case -1:
                 break;
             }
         }
 
+    // Plan the resources and array tasks before generating anything, so both scripts agree on them
+    try {
+        if ( !fileinit._burnin_params.empty() ) {
+            if ( fileinit._nimrod == true || fileinit._mpi_nodes > 0 )
+                throw std::invalid_argument("Burn-in -> branch jobs (-D) can't be generated for Nimrod or MPI yet");
+            fileinit._native = true;
+            PlanBurnins(fileinit);
+        }
+        if ( !fileinit._history_dir.empty() )
+            ApplyPrediction(fileinit);
+        if ( fileinit._pack == true && fileinit._nimrod == false && fileinit._mpi_nodes == 0 )
+            PackWork(fileinit);
+        if ( fileinit._nimrod == true )
+            BatchWork(fileinit);
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if ( fileinit._mpi_nodes > 0 ) {
+        MPIGenerator MPI(fileinit);
+        MPI.FileGenerate();
+        return 0;
+    }
 
-    if ( fileinit._pbs_only == true ) {
+    if ( fileinit._pbs_only == true || fileinit._native == true || fileinit._nimrod == true ) {
         PBSGenerator PBS(fileinit);
         PBS.FileGenerate();
         return 0;
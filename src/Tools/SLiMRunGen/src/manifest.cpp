@@ -0,0 +1,135 @@
+// Write the manifests that tell each array task or Nimrod job which runs are its own
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#include "manifest.hpp"
+#include "slimbin.h"
+
+using std::vector;
+
+namespace
+{
+  const char *HEADER = "task,combo,seed\n";
+
+  // Append a task's rows to out
+  void FormatTask(size_t task, const Task &runs, string &out)
+  {
+    char buf[64];
+    for (const Run &run : runs.runs)
+    {
+      char *p = std::to_chars(buf, buf + sizeof(buf), task).ptr;
+      *p++ = ',';
+      p = std::to_chars(p, buf + sizeof(buf), run.combo + 1).ptr;
+      *p++ = ',';
+      p = std::to_chars(p, buf + sizeof(buf), run.seed + 1).ptr;
+      *p++ = '\n';
+      out.append(buf, p - buf);
+    }
+  }
+
+  void WriteAll(int fd, const string &data, off_t offset, const string &filename)
+  {
+    size_t done = 0;
+    while (done < data.size())
+    {
+      ssize_t n = pwrite(fd, data.data() + done, data.size() - done, offset + done);
+      if (n < 0)
+        throw std::runtime_error("Couldn't write to " + filename);
+      done += n;
+    }
+  }
+}
+
+void WriteManifest(const string &filename, const vector<Task> &tasks)
+{
+  // Format each thread's share of the tasks into a buffer of its own, then lay the buffers out one after another
+  int nThreads = omp_get_max_threads();
+  vector<string> chunks(nThreads);
+  vector<vector<size_t>> starts(nThreads); // Where each task begins within its chunk
+  vector<size_t> chunkOffsets(nThreads + 1, std::char_traits<char>::length(HEADER));
+
+  #pragma omp parallel num_threads(nThreads)
+  {
+    int t = omp_get_thread_num();
+    size_t begin = tasks.size() * t / nThreads;
+    size_t end = tasks.size() * (t + 1) / nThreads;
+    for (size_t i = begin; i < end; ++i)
+    {
+      starts[t].push_back(chunks[t].size());
+      FormatTask(i + 1, tasks[i], chunks[t]);
+    }
+  }
+  for (int t = 0; t < nThreads; ++t)
+    chunkOffsets[t + 1] = chunkOffsets[t] + chunks[t].size();
+
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Couldn't open " + filename + " for writing");
+  bool failed = false;
+  #pragma omp parallel for num_threads(nThreads) reduction(||:failed)
+  for (int t = 0; t <= nThreads; ++t)
+  {
+    try
+    {
+      if (t == nThreads)
+        WriteAll(fd, HEADER, 0, filename);
+      else
+        WriteAll(fd, chunks[t], chunkOffsets[t], filename);
+    }
+    catch (const std::exception &)
+    {
+      failed = true;
+    }
+  }
+  close(fd);
+  if (failed)
+    throw std::runtime_error("Couldn't write to " + filename);
+
+  slimbin::Writer index(filename + ".idx", {{"task", slimbin::U64}, {"offset", slimbin::U64}, {"rows", slimbin::U64}});
+  for (int t = 0; t < nThreads; ++t)
+  {
+    size_t begin = tasks.size() * t / nThreads;
+    for (size_t i = 0; i < starts[t].size(); ++i)
+    {
+      index.set(0, uint64_t(begin + i + 1));
+      index.set(1, uint64_t(chunkOffsets[t] + starts[t][i]));
+      index.set(2, uint64_t(tasks[begin + i].runs.size()));
+      index.endRow();
+    }
+  }
+  index.close();
+}
+
+void WriteTaskManifests(const string &directory, const vector<Task> &tasks)
+{
+  std::filesystem::create_directories(directory);
+
+  bool failed = false;
+  #pragma omp parallel reduction(||:failed)
+  {
+    string buffer;
+    #pragma omp for schedule(dynamic, 64)
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+      buffer.assign(HEADER);
+      FormatTask(i + 1, tasks[i], buffer);
+      string filename = TaskManifest(directory, std::to_string(i + 1));
+      FILE *file = std::fopen(filename.c_str(), "wb");
+      if (!file || std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+        failed = true;
+      if (file)
+        std::fclose(file);
+    }
+  }
+  if (failed)
+    throw std::runtime_error("Couldn't write every task manifest to " + directory);
+}
+
+string TaskManifest(const string &directory, const string &task)
+{
+  return directory + "/task_" + task + ".csv";
+}
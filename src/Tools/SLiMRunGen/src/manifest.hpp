@@ -0,0 +1,18 @@
+#include <string>
+#include <vector>
+#include "packing.hpp"
+
+using std::string;
+#pragma once
+
+// Write the runs of every task to one packed manifest (task,combo,seed rows, 1-based, grouped by task), along with an
+// index of where each task's rows start: a binary table (see slimbin.h) of task, offset and rows, at FILENAME.idx.
+// run_slim and mpi_run_slim use the index to read just their own task's rows instead of scanning the whole manifest.
+// Tasks are formatted in parallel and written straight to their place in the file
+void WriteManifest(const string &filename, const std::vector<Task> &tasks);
+
+// Write each task's runs to a manifest of its own, DIRECTORY/task_N.csv, in parallel with one buffered write per file
+void WriteTaskManifests(const string &directory, const std::vector<Task> &tasks);
+
+// Where a task's own manifest is, for -K. The task can be a shell variable, like ${PBS_ARRAY_INDEX}
+string TaskManifest(const string &directory, const string &task);
@@ -0,0 +1,194 @@
+// Pack seed x combo runs into right-sized PBS array tasks
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <stdexcept>
+#include "packing.hpp"
+#include "manifest.hpp"
+#include "tables.hpp"
+
+using std::vector;
+
+double WalltimeSeconds(const string &walltime)
+{
+  // Accepts HH:MM:SS, MM:SS or plain seconds
+  double seconds = 0.0;
+  size_t start = 0;
+  while (start <= walltime.size())
+  {
+    size_t colon = walltime.find(':', start);
+    string part = walltime.substr(start, colon == string::npos ? string::npos : colon - start);
+    seconds = seconds * 60 + std::stod(part);
+    if (colon == string::npos)
+      break;
+    start = colon + 1;
+  }
+  return seconds;
+}
+
+string WalltimeString(double seconds)
+{
+  long total = std::ceil(seconds);
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%ld:%02ld:%02ld", total / 3600, (total / 60) % 60, total % 60);
+  return buf;
+}
+
+WorkPacker::WorkPacker(int cores, double walltime) : _cores(cores), _walltime(walltime) {}
+
+vector<Task> WorkPacker::Pack(vector<Run> runs) const
+{
+  std::stable_sort(runs.begin(), runs.end(), [](const Run &a, const Run &b) { return a.cost > b.cost; });
+
+  // Each task's cores, as a min-heap of the times they next become free
+  using Cores = std::priority_queue<double, vector<double>, std::greater<double>>;
+  vector<Task> tasks;
+  vector<Cores> cores;
+  size_t firstOpen = 0; // Tasks before this can't fit even the smallest run left
+
+  for (const Run &run : runs)
+  {
+    size_t t = firstOpen;
+    for (; t < tasks.size(); ++t)
+    {
+      if (cores[t].top() + run.cost <= _walltime)
+        break;
+    }
+
+    if (t == tasks.size())
+    {
+      if (run.cost > _walltime)
+        std::cerr << "Warning: a run of combo " << run.combo + 1 << " is estimated to take " << WalltimeString(run.cost)
+                  << ", longer than the walltime, so it gets a task of its own" << std::endl;
+      tasks.emplace_back();
+      cores.emplace_back();
+      for (int c = 0; c < _cores; ++c)
+        cores.back().push(0.0);
+    }
+
+    double finish = cores[t].top() + run.cost;
+    cores[t].pop();
+    cores[t].push(finish);
+    tasks[t].runs.push_back(run);
+    tasks[t].makespan = std::max(tasks[t].makespan, finish);
+
+    // Runs only get smaller, so a task that can't fit this one may still fit the next: only skip tasks that are full
+    while (firstOpen < tasks.size() && cores[firstOpen].top() >= _walltime)
+      ++firstOpen;
+  }
+  return tasks;
+}
+
+vector<double> ComboCosts(const string &combosFile, const string &costsFile, const vector<double> &predicted,
+                          double defaultCost)
+{
+  CsvTable combos = ReadTable(combosFile);
+  vector<double> costs(combos.rows.size(), defaultCost);
+  if (predicted.size() == costs.size())
+    costs = predicted;
+
+  const CsvTable *source = &combos;
+  CsvTable costTable;
+  if (!costsFile.empty())
+  {
+    costTable = ReadTable(costsFile);
+    source = &costTable;
+    if (costTable.rows.size() != combos.rows.size())
+      throw std::runtime_error(costsFile + " needs one row per combo in " + combosFile);
+  }
+
+  int col = source->Column("cost");
+  if (col < 0)
+  {
+    if (!costsFile.empty())
+      throw std::runtime_error(costsFile + " has no cost column");
+    return costs;
+  }
+
+  for (size_t i = 0; i < costs.size(); ++i)
+    costs[i] = std::stod(source->rows[i].at(col));
+  return costs;
+}
+
+// The job reads the manifests after moving to $TMPDIR, so their paths are absolute
+void SaveManifests(FileGenerator &FG, const vector<Task> &tasks)
+{
+  const string base = std::filesystem::absolute(FG._filename).string();
+  FG._manifest = base + "_manifest.csv";
+  WriteManifest(FG._manifest, tasks);
+  if (FG._split_manifests)
+  {
+    FG._manifest_dir = base + "_manifests";
+    WriteTaskManifests(FG._manifest_dir, tasks);
+  }
+}
+
+void PackWork(FileGenerator &FG)
+{
+  vector<double> costs = ComboCosts(FG._combos_dir, FG._costs_dir, FG._run_costs, FG._run_cost);
+  size_t nSeeds = CountRows(FG._seeds_dir);
+
+  if (costs.empty() || nSeeds == 0)
+    throw std::runtime_error("Nothing to pack: " + FG._combos_dir + " has " + std::to_string(costs.size()) + " combos and "
+                             + FG._seeds_dir + " has " + std::to_string(nSeeds) + " seeds");
+
+  vector<Run> runs;
+  runs.reserve(costs.size() * nSeeds);
+  for (size_t c = 0; c < costs.size(); ++c)
+    for (size_t s = 0; s < nSeeds; ++s)
+      runs.push_back({c, s, costs[c]});
+
+  bool predicted = !FG._run_costs.empty();
+  double walltime = WalltimeSeconds(FG._walltime);
+  if (predicted)
+    walltime /= FG._margin;
+  vector<Task> tasks = WorkPacker(FG._cores, walltime).Pack(runs);
+
+  SaveManifests(FG, tasks);
+
+  FG._jobarray = tasks.size() > 1 ? "1-" + std::to_string(tasks.size()) : "";
+
+  double longest = 0.0;
+  for (const Task &task : tasks)
+    longest = std::max(longest, task.makespan);
+  if (predicted)
+    FG._walltime = WalltimeString(longest * FG._margin);
+
+  if (FG._verbose)
+  {
+    double used = 0.0;
+    for (const Task &task : tasks)
+      for (const Run &run : task.runs)
+        used += run.cost;
+    double available = tasks.size() * FG._cores * WalltimeSeconds(FG._walltime);
+    std::cout << "Packed " << runs.size() << " runs into " << tasks.size() << " array tasks of " << FG._cores
+              << " cores, longest task " << WalltimeString(longest) << " with walltime " << FG._walltime
+              << ", " << std::round(100 * used / available) << "% core utilisation" << std::endl;
+  }
+}
+
+void BatchWork(FileGenerator &FG)
+{
+  size_t nCombos = CountRows(FG._combos_dir);
+  if (FG._comboSize > 0)
+    nCombos = std::min(nCombos, size_t(FG._comboSize));
+  size_t nSeeds = CountRows(FG._seeds_dir);
+  size_t batch = std::max(FG._batch, 1);
+  if (nCombos == 0 || nSeeds == 0)
+    throw std::runtime_error("Nothing to batch: " + FG._combos_dir + " has " + std::to_string(nCombos) + " combos and "
+                             + FG._seeds_dir + " has " + std::to_string(nSeeds) + " seeds");
+
+  FG._nbatches = (nCombos * nSeeds + batch - 1) / batch;
+  vector<Task> tasks(FG._nbatches);
+  for (size_t r = 0; r < nCombos * nSeeds; ++r)
+    tasks[r / batch].runs.push_back({r / nSeeds, r % nSeeds, 0.0});
+  SaveManifests(FG, tasks);
+
+  if (FG._verbose)
+    std::cout << "Split " << nCombos * nSeeds << " runs (" << nCombos << " combos x " << nSeeds << " seeds) into "
+              << FG._nbatches << " Nimrod jobs of up to " << batch << " runs" << std::endl;
+}
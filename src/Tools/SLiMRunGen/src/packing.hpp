@@ -0,0 +1,59 @@
+#include <string>
+#include <vector>
+#include "generators.hpp"
+
+using std::string;
+#pragma once
+
+// A single SLiM run: one combo (row of combos.csv) with one seed (row of seeds.csv), both 0-based,
+// and its estimated cost in seconds on one core
+struct Run
+{
+    size_t combo;
+    size_t seed;
+    double cost;
+};
+
+// An array task: the runs one node works through within its walltime, in launch order (longest first)
+struct Task
+{
+    std::vector<Run> runs;
+    double makespan = 0.0; // Predicted time until the node's last core finishes
+};
+
+// Convert between PBS walltimes (HH:MM:SS) and seconds
+double WalltimeSeconds(const string &walltime);
+string WalltimeString(double seconds);
+
+// Bin-packs runs into array tasks that each fill a node of the given number of cores for the walltime
+class WorkPacker
+{
+public:
+    WorkPacker(int cores, double walltime);
+
+    // First fit decreasing: runs are taken longest first, and each goes into the first task where a core frees up
+    // early enough to finish it within the walltime. Runs within a task start in the same order on whichever core is
+    // free first, so this tracks each task's real schedule and keeps idle cores at the end of a task to a minimum
+    std::vector<Task> Pack(std::vector<Run> runs) const;
+
+private:
+    int _cores;
+    double _walltime;
+};
+
+// Estimated cost of each combo: from a cost column in the costs file (or in combos.csv itself, if no costs file
+// is given), otherwise the predicted costs if there are any, otherwise defaultCost for every combo
+std::vector<double> ComboCosts(const string &combosFile, const string &costsFile, const std::vector<double> &predicted,
+                               double defaultCost);
+
+// Write the manifest of every task's runs, with its index, and with -K a manifest per task as well
+void SaveManifests(FileGenerator &FG, const std::vector<Task> &tasks);
+
+// Plan the whole sweep: pack every seed x combo run into array tasks, write the per-task manifest
+// (task,combo,seed rows, 1-based), and set the job array and manifest on the generator options.
+// With predicted costs, tasks are packed to the walltime less the safety margin, and the walltime is cut to what they need
+void PackWork(FileGenerator &FG);
+
+// Split the sweep into Nimrod jobs of FG._batch runs each: a combo's seeds go in the same batches, so their run times
+// are alike. Writes the manifest (with batches as tasks) and sets the number of batches
+void BatchWork(FileGenerator &FG);
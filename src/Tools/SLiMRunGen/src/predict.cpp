@@ -0,0 +1,192 @@
+// Predict walltime and memory for a sweep from the telemetry of past runs
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include "predict.hpp"
+#include "packing.hpp"
+#include "tables.hpp"
+
+using std::vector;
+
+namespace
+{
+  bool ToNumber(const string &value, double &number)
+  {
+    char *end = nullptr;
+    number = std::strtod(value.c_str(), &end);
+    return !value.empty() && *end == '\0';
+  }
+
+  // Name of a SLiM script without its directory, to match the history's model column
+  string ScriptName(const string &path)
+  {
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+  }
+}
+
+void LinearModel::Fit(const vector<vector<double>> &x, const vector<double> &y)
+{
+  if (y.empty())
+    throw std::invalid_argument("Can't fit a model to an empty history");
+  _min = *std::min_element(y.begin(), y.end());
+  _max = *std::max_element(y.begin(), y.end());
+
+  size_t p = x.empty() ? 1 : x[0].size() + 1;
+  double mean = 0.0;
+  for (double v : y)
+    mean += v;
+  mean /= y.size();
+  _coef.assign(p, 0.0);
+  _coef[0] = mean;
+  if (y.size() <= p)
+    return;
+
+  // Normal equations (X'X)b = X'y, solved by Gaussian elimination with partial pivoting. A tiny ridge keeps
+  // predictors that never vary in the history (every run had the same value) from making the system singular
+  vector<vector<double>> a(p, vector<double>(p + 1, 0.0));
+  for (size_t r = 0; r < y.size(); ++r)
+  {
+    for (size_t i = 0; i < p; ++i)
+    {
+      double xi = i ? x[r][i - 1] : 1.0;
+      for (size_t j = 0; j < p; ++j)
+        a[i][j] += xi * (j ? x[r][j - 1] : 1.0);
+      a[i][p] += xi * y[r];
+    }
+  }
+  for (size_t i = 1; i < p; ++i)
+    a[i][i] += 1e-9 * (a[i][i] + 1.0);
+
+  for (size_t c = 0; c < p; ++c)
+  {
+    size_t pivot = c;
+    for (size_t r = c + 1; r < p; ++r)
+      if (std::abs(a[r][c]) > std::abs(a[pivot][c]))
+        pivot = r;
+    std::swap(a[c], a[pivot]);
+    if (a[c][c] == 0.0)
+      return; // Leave the mean
+    for (size_t r = 0; r < p; ++r)
+    {
+      if (r == c)
+        continue;
+      double f = a[r][c] / a[c][c];
+      for (size_t k = c; k <= p; ++k)
+        a[r][k] -= f * a[c][k];
+    }
+  }
+  for (size_t i = 0; i < p; ++i)
+    _coef[i] = a[i][p] / a[i][i];
+}
+
+double LinearModel::Predict(const vector<double> &x) const
+{
+  double y = _coef[0];
+  for (size_t i = 1; i < _coef.size(); ++i)
+    y += _coef[i] * x[i - 1];
+  return std::min(std::max(y, _min), _max * 2);
+}
+
+ResourcePrediction PredictResources(const string &combosFile, const string &historyFile, const string &model)
+{
+  CsvTable combos = ReadTable(combosFile);
+  CsvTable history = ReadTable(historyFile);
+
+  int timeCol = history.Column("walltime");
+  int rssCol = history.Column("maxrss");
+  if (timeCol < 0 || rssCol < 0)
+    throw std::runtime_error(historyFile + " needs walltime and maxrss columns");
+  int modelCol = history.Column("model");
+
+  // Predictors are the numeric combo parameters that were also recorded in the history
+  ResourcePrediction pred;
+  vector<int> comboCols, historyCols;
+  for (size_t c = 0; c < combos.header.size(); ++c)
+  {
+    int h = history.Column(combos.header[c]);
+    double v;
+    if (h < 0 || combos.header[c] == "cost" || combos.rows.empty() || !ToNumber(combos.rows[0][c], v))
+      continue;
+    comboCols.push_back(c);
+    historyCols.push_back(h);
+    pred.predictors.push_back(combos.header[c]);
+  }
+
+  vector<vector<double>> x;
+  vector<double> runtime, rss;
+  for (const vector<string> &row : history.rows)
+  {
+    if (modelCol >= 0 && ScriptName(row.at(modelCol)) != ScriptName(model))
+      continue;
+    vector<double> features(historyCols.size());
+    bool ok = true;
+    for (size_t i = 0; i < historyCols.size(); ++i)
+      ok = ok && ToNumber(row.at(historyCols[i]), features[i]);
+    double kb;
+    if (!ok || !ToNumber(row.at(rssCol), kb))
+      continue; // Runs that failed before reporting are no use here
+    x.emplace_back(std::move(features));
+    runtime.push_back(WalltimeSeconds(row.at(timeCol)));
+    rss.push_back(kb);
+  }
+  if (runtime.empty())
+    throw std::runtime_error(historyFile + " has no complete runs of " + ScriptName(model));
+  pred.history = runtime.size();
+
+  LinearModel timeModel, rssModel;
+  timeModel.Fit(x, runtime);
+  rssModel.Fit(x, rss);
+
+  vector<double> features(comboCols.size());
+  for (const vector<string> &row : combos.rows)
+  {
+    for (size_t i = 0; i < comboCols.size(); ++i)
+      if (!ToNumber(row.at(comboCols[i]), features[i]))
+        throw std::runtime_error(combosFile + ": " + combos.header[comboCols[i]] + " isn't numeric in every row");
+    pred.runtime.push_back(timeModel.Predict(features));
+    pred.rss.push_back(rssModel.Predict(features));
+  }
+  return pred;
+}
+
+void ApplyPrediction(FileGenerator &FG)
+{
+  ResourcePrediction pred = PredictResources(FG._combos_dir, FG._history_dir, FG._slim_path);
+  FG._run_costs = pred.runtime;
+  if (pred.runtime.empty())
+    return;
+
+  // Every core on the node can be running the hungriest combo at once
+  double rss = *std::max_element(pred.rss.begin(), pred.rss.end());
+  if (!FG._mem_set)
+  {
+    double gb = std::ceil(rss * FG._cores * FG._margin / (1024.0 * 1024.0));
+    FG._mem = FG.MemG(std::to_string(std::max(long(gb), 1L)).c_str());
+  }
+
+  // Packed jobs get their walltime from the packing, which knows what each task actually holds
+  if (!FG._walltime_set && !FG._pack)
+  {
+    size_t nSeeds = CountRows(FG._seeds_dir);
+    double total = 0.0;
+    for (double t : pred.runtime)
+      total += t * nSeeds;
+    double longest = *std::max_element(pred.runtime.begin(), pred.runtime.end());
+    // Greedy scheduling finishes within the average load per core (on every node of an MPI job) plus one run
+    FG._walltime = WalltimeString((total / (FG._cores * std::max(FG._mpi_nodes, 1)) + longest) * FG._margin);
+  }
+
+  if (FG._verbose)
+  {
+    std::cout << "Fitted walltime and memory to " << pred.history << " past runs";
+    if (pred.predictors.size())
+    {
+      std::cout << " on";
+      for (const string &p : pred.predictors)
+        std::cout << " " << p;
+    }
+    std::cout << ": requesting " << FG._mem << " and " << (FG._pack ? "packed tasks" : FG._walltime) << std::endl;
+  }
+}
@@ -0,0 +1,40 @@
+#include <string>
+#include <vector>
+#include "generators.hpp"
+
+using std::string;
+#pragma once
+
+// Ordinary least squares on an intercept plus any number of numeric predictors
+class LinearModel
+{
+public:
+    // Rows of x are observations. Falls back to the mean of y when there are too few rows to fit every predictor
+    void Fit(const std::vector<std::vector<double>> &x, const std::vector<double> &y);
+    double Predict(const std::vector<double> &x) const;
+
+    // Predictions are kept between the smallest and twice the largest value in the history, so a straight line can't
+    // go negative or run away outside the parameter space it was fitted to
+    double _min = 0.0;
+    double _max = 0.0;
+
+private:
+    std::vector<double> _coef; // Intercept first
+};
+
+// Predicted time (seconds) and peak memory (kilobytes) of a single run of each combo, fitted from a history of past runs.
+// The history is a .csv with the combo parameters of each run, its walltime (seconds or HH:MM:SS) and maxrss in kilobytes,
+// as reported by /usr/bin/time -v. If it has a model column, only runs of the same SLiM script are used
+struct ResourcePrediction
+{
+    std::vector<double> runtime;
+    std::vector<double> rss;
+    std::vector<string> predictors; // Parameters the regression used
+    size_t history = 0;             // Number of past runs it was fitted to
+};
+
+ResourcePrediction PredictResources(const string &combosFile, const string &historyFile, const string &model);
+
+// Predict the resources for the generator's combos and set the PBS walltime and memory from them, with the safety margin.
+// Without packing, the walltime covers every run on one node, or every node of an MPI job. Explicit -w and -m are left alone
+void ApplyPrediction(FileGenerator &FG);
@@ -0,0 +1,60 @@
+// Read the combos, seeds and cost files that slimrungen plans jobs from
+#include <algorithm>
+#include <stdexcept>
+#include "tables.hpp"
+#include "csv.h"
+#include "parse.h"
+#include "slimbin.h"
+
+using std::vector;
+
+int CsvTable::Column(const string &name) const
+{
+  auto it = std::find(header.begin(), header.end(), name);
+  return it == header.end() ? -1 : it - header.begin();
+}
+
+CsvTable ReadTable(const string &filename)
+{
+  CsvTable table;
+  if (slimbin::isBinary(filename))
+  {
+    slimbin::Reader in(filename);
+    for (size_t c = 0; c < in.cols(); ++c)
+      table.header.push_back(in.column(c).name);
+    table.rows.resize(in.rows());
+    for (size_t r = 0; r < in.rows(); ++r)
+      for (size_t c = 0; c < in.cols(); ++c)
+        table.rows[r].push_back(in.toString(r, c));
+    return table;
+  }
+
+  io::LineReader in(filename);
+  char *line = in.next_line();
+  if (!line)
+    throw std::runtime_error(filename + " is empty");
+  table.header = splitLine(line);
+
+  while ((line = in.next_line()))
+  {
+    if (*line)
+      table.rows.emplace_back(splitLine(line));
+  }
+  return table;
+}
+
+size_t CountRows(const string &filename)
+{
+  if (slimbin::isBinary(filename))
+    return slimbin::Reader(filename).rows();
+
+  io::LineReader in(filename);
+  size_t rows = 0;
+  in.next_line(); // header
+  while (char *line = in.next_line())
+  {
+    if (*line)
+      ++rows;
+  }
+  return rows;
+}
@@ -0,0 +1,22 @@
+#include <string>
+#include <vector>
+
+using std::string;
+#pragma once
+
+// Minimal reader for the combos, seeds and cost files slimrungen plans jobs from:
+// a header and rows of string fields, with double quotes stripped. Binary tables (see slimbin.h) are read the same way,
+// with their values formatted as run_slim would pass them to SLiM
+struct CsvTable
+{
+    std::vector<string> header;
+    std::vector<std::vector<string>> rows;
+
+    // Index of a named column, or -1 if it doesn't exist
+    int Column(const string &name) const;
+};
+
+CsvTable ReadTable(const string &filename);
+
+// Number of data rows in a .csv (not counting the header) or a binary table from the seed generators
+size_t CountRows(const string &filename);
@@ -0,0 +1,110 @@
+// A small precompiled template engine for the scripts slimrungen writes
+#include <algorithm>
+#include <stdexcept>
+#include "template.hpp"
+
+using std::vector;
+
+TemplateVars::TemplateVars(vector<string> names) : _names(std::move(names)), _values(_names.size()) {}
+
+size_t TemplateVars::Index(const string &name) const
+{
+  auto it = std::find(_names.begin(), _names.end(), name);
+  if (it == _names.end())
+    throw std::invalid_argument("Unknown template variable '" + name + "'");
+  return it - _names.begin();
+}
+
+Template::Template(string source, const TemplateVars &vars) : _source(std::move(source))
+{
+  vector<std::pair<size_t, size_t>> open; // Sections waiting for their end tag: (op, variable)
+  size_t pos = 0;
+
+  while (pos < _source.size())
+  {
+    size_t tag = _source.find("{{", pos);
+    if (tag == string::npos)
+      tag = _source.size();
+    if (tag > pos)
+    {
+      Op text{TEXT, pos, tag - pos};
+      _ops.push_back(text);
+      _textSize += text.length;
+    }
+    if (tag == _source.size())
+      break;
+
+    size_t close = _source.find("}}", tag + 2);
+    if (close == string::npos)
+      throw std::invalid_argument("Unclosed {{ in template at offset " + std::to_string(tag));
+    string name = _source.substr(tag + 2, close - tag - 2);
+    pos = close + 2;
+    if (name.empty())
+      throw std::invalid_argument("Empty {{}} in template at offset " + std::to_string(tag));
+
+    char kind = name[0];
+    if (kind == '#' || kind == '^')
+    {
+      Op section{kind == '#' ? SECTION : INVERTED};
+      section.var = vars.Index(name.substr(1));
+      open.emplace_back(_ops.size(), section.var);
+      _ops.push_back(section);
+    }
+    else if (kind == '/')
+    {
+      if (open.empty() || open.back().second != vars.Index(name.substr(1)))
+        throw std::invalid_argument("Unmatched {{" + name + "}} in template");
+      _ops[open.back().first].end = _ops.size();
+      open.pop_back();
+    }
+    else
+    {
+      Op var{VAR};
+      var.var = vars.Index(name);
+      _ops.push_back(var);
+    }
+  }
+  if (!open.empty())
+    throw std::invalid_argument("Unclosed section in template");
+}
+
+void Template::Render(const TemplateVars &vars, string &out) const
+{
+  out.reserve(out.size() + _textSize);
+  size_t i = 0;
+  while (i < _ops.size())
+  {
+    const Op &op = _ops[i];
+    switch (op.type)
+    {
+      case TEXT:
+        out.append(_source, op.begin, op.length);
+        break;
+      case VAR:
+        out.append(vars.Get(op.var));
+        break;
+      case SECTION:
+        if (vars.Get(op.var).empty())
+        {
+          i = op.end;
+          continue;
+        }
+        break;
+      case INVERTED:
+        if (!vars.Get(op.var).empty())
+        {
+          i = op.end;
+          continue;
+        }
+        break;
+    }
+    ++i;
+  }
+}
+
+string Template::Render(const TemplateVars &vars) const
+{
+  string out;
+  Render(vars, out);
+  return out;
+}
@@ -0,0 +1,56 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+#pragma once
+
+// The variables a family of templates can use: looked up by name when a template is compiled, and by index when it's
+// rendered. Values are views, so whatever they point to has to outlive the render
+class TemplateVars
+{
+public:
+    explicit TemplateVars(std::vector<string> names);
+
+    // Index of a variable, for setting it without a name lookup in a loop
+    size_t Index(const string &name) const;
+
+    void Set(size_t index, std::string_view value) { _values[index] = value; }
+    void Set(const string &name, std::string_view value) { _values[Index(name)] = value; }
+    std::string_view Get(size_t index) const { return _values[index]; }
+
+private:
+    std::vector<string> _names;
+    std::vector<std::string_view> _values;
+};
+
+// A script template, parsed once and rendered as many times as needed. Supports a small subset of mustache:
+//   {{name}}               the value of a variable
+//   {{#name}}...{{/name}}  a section, only rendered if the variable isn't empty
+//   {{^name}}...{{/name}}  an inverted section, only rendered if the variable is empty
+// Rendering walks a flat list of ops over slices of the source, appending to a single output buffer
+class Template
+{
+public:
+    Template(string source, const TemplateVars &vars);
+
+    // Append the rendered template to out
+    void Render(const TemplateVars &vars, string &out) const;
+    string Render(const TemplateVars &vars) const;
+
+private:
+    enum OpType { TEXT, VAR, SECTION, INVERTED };
+
+    struct Op
+    {
+        OpType type;
+        size_t begin = 0;   // Slice of the source, for text
+        size_t length = 0;
+        size_t var = 0;     // Variable, for values and sections
+        size_t end = 0;     // Op after the end of a section
+    };
+
+    string _source;
+    std::vector<Op> _ops;
+    size_t _textSize = 0;   // Total length of the text, to size the buffer up front
+};
@@ -0,0 +1,579 @@
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include <parallel/algorithm>
+#include <unistd.h>
+#include "../../Parallelisation/Cpp/includes/csv.h"
+#include "../../Parallelisation/Cpp/includes/parse.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+namespace fs = std::filesystem;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+#define BUFFER_SIZE (4 << 20)
+
+// Input is read into a run in pieces of this size, and each piece's keys are extracted in parallel
+#define PIECE_SIZE (64 << 20)
+
+// Sort keys are up to this many integer columns
+#define MAX_KEYS 4
+
+// Each run being merged has a LineReader with a 3 MB buffer, so runs are merged at most this many at a time
+#define MAX_FAN_IN 256
+
+
+typedef std::unique_ptr<FILE, int(*)(FILE*)> File;
+
+File open_file(const string &filename, const char *mode)
+{
+    File file(std::fopen(filename.c_str(), mode), std::fclose);
+    if (!file)
+        throw std::runtime_error("Can't open " + filename);
+    std::setvbuf(file.get(), nullptr, _IOFBF, BUFFER_SIZE);
+    return file;
+}
+
+// The sort key of a row: its key columns as integers, in order. A key column that's missing or not an integer sorts
+// after every number, so rows are never dropped
+struct Keys
+{
+    vector<size_t> cols;        // 1-based
+
+    void extract(const char *line, const char *end, int64_t *key) const
+    {
+        std::fill(key, key + MAX_KEYS, 0);
+        size_t col = 1;
+        const char *field = line;
+        size_t found = 0;
+        while (found < cols.size())
+        {
+            const char *comma = static_cast<const char*>(std::memchr(field, ',', end - field));
+            const char *fieldEnd = comma ? comma : end;
+            for (size_t k = 0; k < cols.size(); ++k)
+            {
+                if (cols[k] != col)
+                    continue;
+                auto res = std::from_chars(field, fieldEnd, key[k]);
+                if (res.ec != std::errc() || res.ptr != fieldEnd)
+                    key[k] = INT64_MAX;
+                ++found;
+            }
+            if (!comma)
+                break;
+            field = comma + 1;
+            ++col;
+        }
+        for (size_t k = 0; k < cols.size(); ++k)
+            if (cols[k] > col)
+                key[k] = INT64_MAX;
+    }
+};
+
+// A row in a run: its key, and where its text is in the run's arena. Sorting these moves 40 bytes per row, never the text
+struct Record
+{
+    int64_t key[MAX_KEYS];
+    uint64_t place;             // Offset << 24 | length
+
+    uint64_t offset() const { return place >> 24; }
+    uint64_t length() const { return place & 0xffffff; }
+};
+
+// By key, then by place in the input, so rows with equal keys keep their input order
+bool record_less(const Record &a, const Record &b)
+{
+    for (int k = 0; k < MAX_KEYS; ++k)
+        if (a.key[k] != b.key[k])
+            return a.key[k] < b.key[k];
+    return a.place < b.place;
+}
+
+// One memory-budgeted arena per run: row text grows up from the start, and the rows' records grow down from the end,
+// so a run is as big as the budget allows however long its rows are
+class RunBuilder
+{
+public:
+    RunBuilder(size_t budget, const Keys &keys) : _size(budget), _arena(new char[budget]), _keys(keys)
+    {
+        _recordsBegin = (_size / sizeof(Record)) * sizeof(Record);
+        _recordsEnd = _recordsBegin;
+    }
+
+    // Fill the arena from in. Returns false once the input is done and nothing was read
+    bool fill(FILE *in)
+    {
+        // Carry over the partial row left at the end of the last run's text
+        std::memmove(_arena.get(), _arena.get() + _carryBegin, _carry);
+        _text = _carry;
+        _pending = _carry;
+        _added = 0;
+        _carry = 0;
+        _recordsBegin = _recordsEnd;
+
+        while (!std::feof(in) || _pending > 0)
+        {
+            size_t space = _recordsBegin - _text;
+            size_t want = std::feof(in) ? 0 : std::min<size_t>(PIECE_SIZE, space / 2);
+            if (want < 4096 && !std::feof(in))
+                break;
+            size_t pieceStart = _text - _pending;
+            size_t n = want > 0 ? std::fread(_arena.get() + _text, 1, want, in) : 0;
+            if (std::ferror(in))
+                throw std::runtime_error("Failed reading the input");
+            _text += n;
+
+            // Only whole rows, unless this is the end of the input, where a last row may not end in a newline
+            const char *base = _arena.get();
+            size_t end = _text;
+            if (!std::feof(in))
+            {
+                const char *nl = static_cast<const char*>(memrchr(base + pieceStart, '\n', _text - pieceStart));
+                end = nl ? nl - base + 1 : pieceStart;
+            }
+            bool fits = add_rows(pieceStart, end);
+            _pending = _text - _added;
+            if (!fits)
+                break;
+        }
+
+        // Whatever didn't make it into a record goes to the next run
+        _carryBegin = _added;
+        _carry = _text - _added;
+        _text = _added;
+        if (records() == 0 && _carry > 0)
+            throw std::runtime_error("A row doesn't fit in the memory budget: raise it with -M");
+        return records() > 0;
+    }
+
+    size_t records() const { return (_recordsEnd - _recordsBegin) / sizeof(Record); }
+
+    void sort()
+    {
+        Record *begin = reinterpret_cast<Record*>(_arena.get() + _recordsBegin);
+        __gnu_parallel::sort(begin, begin + records(), record_less);
+    }
+
+    // Write the rows in sorted order, each ending in a newline
+    void write(FILE *out) const
+    {
+        const Record *begin = reinterpret_cast<const Record*>(_arena.get() + _recordsBegin);
+        for (size_t r = 0; r < records(); ++r)
+        {
+            std::fwrite(_arena.get() + begin[r].offset(), 1, begin[r].length(), out);
+            std::fputc('\n', out);
+        }
+    }
+
+    bool leftover() const { return _carry > 0; }
+
+private:
+    // Extract the keys of the rows in [from, to) of the text into records, in parallel: each thread counts its rows,
+    // then fills its own stretch of records. If they don't all fit, as many as fit are added and false is returned
+    bool add_rows(size_t from, size_t to)
+    {
+        if (from == to)
+            return true;
+        _added = from;
+        const char *base = _arena.get();
+        const int nThreads = omp_get_max_threads();
+        vector<size_t> bounds(nThreads + 1, to);
+        bounds[0] = from;
+        for (int t = 1; t < nThreads; ++t)
+        {
+            size_t p = std::max(from + (to - from) * t / nThreads, bounds[t - 1]);
+            const char *nl = p < to ? static_cast<const char*>(std::memchr(base + p, '\n', to - p)) : nullptr;
+            bounds[t] = nl ? nl - base + 1 : to;
+        }
+
+        vector<size_t> counts(nThreads + 1, 0);
+        #pragma omp parallel for num_threads(nThreads)
+        for (int t = 0; t < nThreads; ++t)
+        {
+            size_t n = 0;
+            for (const char *p = base + bounds[t]; p < base + bounds[t + 1]; ++n)
+            {
+                const char *nl = static_cast<const char*>(std::memchr(p, '\n', base + bounds[t + 1] - p));
+                p = nl ? nl + 1 : base + bounds[t + 1];
+            }
+            counts[t + 1] = n;
+        }
+        for (int t = 0; t < nThreads; ++t)
+            counts[t + 1] += counts[t];
+
+        size_t needed = counts[nThreads] * sizeof(Record);
+        if (_recordsBegin < _text + needed)
+        {
+            // Cut the rows at the last that fits
+            size_t fit = (_recordsBegin - _text) / sizeof(Record);
+            if (fit == 0)
+                return false;
+            int t = 0;
+            while (counts[t + 1] <= fit)
+                ++t;
+            const char *p = base + bounds[t];
+            for (size_t r = counts[t]; r < fit; ++r)
+                p = static_cast<const char*>(std::memchr(p, '\n', base + bounds[t + 1] - p)) + 1;
+            add_rows(from, p - base);
+            return false;
+        }
+        _recordsBegin -= needed;
+
+        Record *records = reinterpret_cast<Record*>(_arena.get() + _recordsBegin);
+        bool tooLong = false;
+        #pragma omp parallel for num_threads(nThreads)
+        for (int t = 0; t < nThreads; ++t)
+        {
+            size_t r = counts[t];
+            for (const char *p = base + bounds[t]; p < base + bounds[t + 1]; ++r)
+            {
+                const char *nl = static_cast<const char*>(std::memchr(p, '\n', base + bounds[t + 1] - p));
+                const char *end = nl ? nl : base + bounds[t + 1];
+                const char *lineEnd = (end > p && end[-1] == '\r') ? end - 1 : end;
+                if (lineEnd - p > 0xffffff)
+                    tooLong = true;
+                _keys.extract(p, lineEnd, records[r].key);
+                records[r].place = uint64_t(p - base) << 24 | uint64_t(lineEnd - p);
+                p = end + 1;
+            }
+        }
+        if (tooLong)
+            throw std::runtime_error("A row is longer than 16 MB");
+        _added = to;
+        return true;
+    }
+
+    size_t _size;
+    std::unique_ptr<char[]> _arena;
+    const Keys &_keys;
+    size_t _text = 0;           // End of the text read in
+    size_t _added = 0;          // End of the text with records
+    size_t _pending = 0;        // Text at the end of the last piece that isn't a whole row yet
+    size_t _carry = 0;
+    size_t _carryBegin = 0;
+    size_t _recordsBegin;
+    size_t _recordsEnd;
+};
+
+// A sorted run being merged: its current row and that row's key
+struct RunReader
+{
+    std::unique_ptr<io::LineReader> in;
+    char *line = nullptr;
+    size_t length = 0;
+    int64_t key[MAX_KEYS];
+
+    bool next(const Keys &keys)
+    {
+        line = in->next_line();
+        if (!line)
+            return false;
+        length = std::strlen(line);
+        keys.extract(line, line + length, key);
+        return true;
+    }
+};
+
+// A tournament tree of losers for a k-way merge: each internal node holds the run that lost the match there, and
+// the overall winner is kept apart. Replacing the winner's row replays only the matches on its path to the root, so
+// each row merged costs log2(k) comparisons, with no swaps up and down a heap
+class LoserTree
+{
+public:
+    explicit LoserTree(vector<RunReader> &runs) : _runs(runs), _k(runs.size()), _tree(runs.size(), -1)
+    {
+        _winner = build(1);
+    }
+
+    // The run with the smallest row, or -1 once every run is done
+    int winner() const { return _runs[_winner].line ? _winner : -1; }
+
+    // After the winner has moved on to its next row
+    void replay()
+    {
+        int w = _winner;
+        for (size_t n = (w + _k) / 2; n >= 1; n /= 2)
+            if (less(_tree[n], w))
+                std::swap(_tree[n], w);
+        _winner = w;
+    }
+
+private:
+    // Runs that are done sort last, and ties go to the earlier run, so the merge is stable
+    bool less(int a, int b) const
+    {
+        const RunReader &ra = _runs[a], &rb = _runs[b];
+        if (!ra.line || !rb.line)
+            return ra.line && !rb.line ? true : (!ra.line && !rb.line ? a < b : false);
+        for (int k = 0; k < MAX_KEYS; ++k)
+            if (ra.key[k] != rb.key[k])
+                return ra.key[k] < rb.key[k];
+        return a < b;
+    }
+
+    // The winner of the subtree at node n, in heap order: nodes 1 to k - 1 are matches, and k to 2k - 1 are the runs
+    int build(size_t n)
+    {
+        if (n >= _k)
+            return n - _k;
+        int a = build(2 * n), b = build(2 * n + 1);
+        if (less(a, b))
+        {
+            _tree[n] = b;
+            return a;
+        }
+        _tree[n] = a;
+        return b;
+    }
+
+    vector<RunReader> &_runs;
+    size_t _k;
+    vector<int> _tree;
+    int _winner;
+};
+
+// Merge sorted runs into out
+void merge_runs(const vector<string> &runs, const Keys &keys, FILE *out)
+{
+    vector<RunReader> readers(runs.size());
+    for (size_t r = 0; r < runs.size(); ++r)
+    {
+        readers[r].in = std::make_unique<io::LineReader>(runs[r]);
+        readers[r].next(keys);
+    }
+    if (runs.size() == 1)
+    {
+        for (RunReader &run = readers[0]; run.line; run.next(keys))
+        {
+            std::fwrite(run.line, 1, run.length, out);
+            std::fputc('\n', out);
+        }
+        return;
+    }
+
+    LoserTree tree(readers);
+    for (int w; (w = tree.winner()) >= 0; tree.replay())
+    {
+        std::fwrite(readers[w].line, 1, readers[w].length, out);
+        std::fputc('\n', out);
+        readers[w].next(keys);
+    }
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "SLiM Sort\n"
+    "\n"
+    "This program sorts a headerless SLiM output by integer key columns, by default the mutations output by modelindex,\n"
+    "seed, generation and position, in a fixed amount of memory however large the file. The file is read in runs that\n"
+    "fill the memory budget, each run is sorted in parallel and written to a temporary file, and the runs are merged.\n"
+    "Rows with equal keys keep their input order.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./out_slim1T_muts.csv -d ./muts_sorted.csv -M 16G -T 24\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i FILEPATH    The file to sort. Defaults to ./out_slim1T_muts.csv.\n"
+    "\n"
+    "-d FILEPATH    Where to write the sorted file. Defaults to the standard output.\n"
+    "\n"
+    "-k LIST        Key columns (1-based) to sort by, most significant first, delimited by commas. Up to %d columns\n"
+    "               of whole numbers; anything else in a key column sorts last. Defaults to 3,2,1,6\n"
+    "               (modelindex, seed, generation, position in the mutations output).\n"
+    "\n"
+    "-M SIZE        Memory budget for each run, e.g. 500M or 16G. Defaults to 1G.\n"
+    "\n"
+    "-t DIRECTORY   Where to write the sorted runs. Needs about as much space as the file. Defaults to $TMPDIR, or /tmp.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n",
+    appname,
+    appname,
+    MAX_KEYS
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "destination",    required_argument,  0,  'd' },
+        { "keys",           required_argument,  0,  'k' },
+        { "memory",         required_argument,  0,  'M' },
+        { "tmpdir",         required_argument,  0,  't' },
+        { "threads",        required_argument,  0,  'T' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string inFile = "./out_slim1T_muts.csv";
+    string outFile;
+    string keyList = "3,2,1,6";
+    string memory = "1G";
+    string tmpDir = std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp";
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:d:k:M:t:T:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                inFile = optarg;
+                continue;
+
+            case 'd':
+                outFile = optarg;
+                continue;
+
+            case 'k':
+                keyList = optarg;
+                continue;
+
+            case 'M':
+                memory = optarg;
+                continue;
+
+            case 't':
+                tmpDir = optarg;
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    fs::path workDir;
+    try
+    {
+        Keys keys;
+        for (const string &item : splitList(keyList))
+        {
+            size_t col = std::stoul(item);
+            if (col < 1)
+                throw std::invalid_argument("Columns are numbered from 1");
+            keys.cols.push_back(col);
+        }
+        if (keys.cols.empty() || keys.cols.size() > MAX_KEYS)
+            throw std::invalid_argument("Sort by 1 to " + std::to_string(MAX_KEYS) + " key columns");
+        size_t budget = parseSize(memory);
+        if (budget < (16 << 20))
+            throw std::invalid_argument("The memory budget (-M) must be at least 16M");
+
+        File in = open_file(inFile, "rb");
+        File out = outFile.empty() ? File(stdout, [](FILE*) { return 0; }) : open_file(outFile, "wb");
+        if (outFile.empty())
+            std::setvbuf(stdout, nullptr, _IOFBF, BUFFER_SIZE);
+
+        // Sort the input in runs. If it all fits in one, it goes straight to the output
+        RunBuilder builder(budget, keys);
+        vector<string> runs;
+        size_t rows = 0;
+        while (builder.fill(in.get()))
+        {
+            builder.sort();
+            rows += builder.records();
+            if (runs.empty() && !builder.leftover() && std::feof(in.get()))
+            {
+                builder.write(out.get());
+                break;
+            }
+            if (workDir.empty())
+            {
+                workDir = fs::path(tmpDir) / ("slimsort_" + std::to_string(getpid()));
+                fs::create_directories(workDir);
+            }
+            runs.push_back((workDir / ("run" + std::to_string(runs.size()))).string());
+            File run = open_file(runs.back(), "wb");
+            builder.write(run.get());
+            if (std::fflush(run.get()) != 0)
+                throw std::runtime_error("Failed writing to " + runs.back() + ": is the temporary directory full?");
+            if (debug)
+                std::cerr << "Sorted run " << runs.size() << " (" << builder.records() << " rows)" << endl;
+        }
+        in.reset();
+
+        // Merge the runs, in rounds if there are too many to merge at once. Each round merges neighbouring runs, so
+        // the runs stay in input order and rows with equal keys keep theirs
+        const size_t sortedRuns = runs.size();
+        size_t runCount = sortedRuns;
+        while (runs.size() > MAX_FAN_IN)
+        {
+            vector<string> round;
+            for (size_t first = 0; first < runs.size(); first += MAX_FAN_IN)
+            {
+                vector<string> group(runs.begin() + first, runs.begin() + std::min(first + MAX_FAN_IN, runs.size()));
+                round.push_back((workDir / ("run" + std::to_string(runCount++))).string());
+                File run = open_file(round.back(), "wb");
+                merge_runs(group, keys, run.get());
+                if (std::fflush(run.get()) != 0)
+                    throw std::runtime_error("Failed writing to " + round.back() + ": is the temporary directory full?");
+                for (const string &r : group)
+                    fs::remove(r);
+            }
+            runs.swap(round);
+        }
+        if (!runs.empty())
+            merge_runs(runs, keys, out.get());
+
+        if (std::fflush(out.get()) != 0)
+            throw std::runtime_error("Failed writing to " + (outFile.empty() ? string("the standard output") : outFile));
+        if (!workDir.empty())
+            fs::remove_all(workDir);
+
+        if (debug)
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "Sorted " << rows << " rows in " << std::max<size_t>(sortedRuns, 1) << " runs in " << seconds
+                      << "s" << endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        if (!workDir.empty())
+            fs::remove_all(workDir);
+        return 1;
+    }
+    return 0;
+}
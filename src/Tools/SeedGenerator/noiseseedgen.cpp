@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <getopt.h>
+#include "../../Parallelisation/Cpp/includes/slimbin.h"
 
 using std::endl;
 using std::cout;
@@ -82,6 +83,23 @@ void write_csv(std::string filename, std::vector<T> values, std::string header)
     outfile.close();
 }
 
+// Function to write the seeds as a single-column binary table (see slimbin.h), which run_slim can mmap directly
+void write_bin(std::string filename, std::vector<uint64_t> values, std::string header, bool bit64)
+{
+    if (header.size() && header[0] == '=')
+        header.erase(header.begin());
+    if (header == "")
+        header = "Seed";
+
+    slimbin::Writer outfile(filename, {{header, bit64 ? slimbin::U64 : slimbin::U32}});
+    for (uint64_t value : values)
+    {
+        outfile.set(0, value);
+        outfile.endRow();
+    }
+    outfile.close();
+}
+
 // Help function for displaying options
 void doHelp(char* appname) 
 {
@@ -100,6 +118,9 @@ void doHelp(char* appname)
     "\n"
     "-l             Generate 64-bit numbers instead of 32-bit.\n"            
     "\n"
+    "-b             Write a binary seed table instead of a .csv, for fast loading by run_slim.\n"
+    "               Defaults to ./seeds.bin unless -d is given.\n"
+    "\n"
     "-t NAME        Choose a header name. Defaults to 'Seed'. Enter nothing to have no header.\n"
     "               Example: -t=Number OR -tNumber\n"
     "\n"
@@ -124,6 +145,7 @@ int main(int argc, char* argv[])
         { "long",           no_argument,        0,  'l' },
         { "verbose",        no_argument,        0,  'v' },
         { "top",            optional_argument,  0,  't' },
+        { "binary",         no_argument,        0,  'b' },
         {0,0,0,0}
     };
 
@@ -134,13 +156,14 @@ int main(int argc, char* argv[])
     std::string headername = "Seed";
     int optionindex = 0;
     int options;
-    bool bit64 = false; 
+    bool bit64 = false;
+    bool binary = false; 
 
     // Get commandline options and set variables to their associated entries
     while (options != -1) 
     {
 
-        options = getopt_long(argc, argv, "n:d:hlvt::", longopts, &optionindex);
+        options = getopt_long(argc, argv, "n:d:hlvbt::", longopts, &optionindex);
 
         switch (options) {
             case 'n':
@@ -163,6 +186,10 @@ int main(int argc, char* argv[])
                 debug = true;
                 continue;
 
+            case 'b':
+                binary = true;
+                continue;
+
             case 't':
                 if (optarg)
                     headername = optarg;
@@ -175,6 +202,9 @@ int main(int argc, char* argv[])
             }
         }
 
+    if (binary && filename == "./seeds.csv")
+        filename = "./seeds.bin";
+
     // Use /dev/random to generate a seed for the noise function
     std::random_device mersseed;
 
@@ -209,7 +239,10 @@ int main(int argc, char* argv[])
             seeds.emplace_back(gen);
         }
     }
-    write_csv(filename, seeds, headername);
+    if (binary)
+        write_bin(filename, seeds, headername, bit64);
+    else
+        write_csv(filename, seeds, headername);
 
     return 0;
 }
\ No newline at end of file
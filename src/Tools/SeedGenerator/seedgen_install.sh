@@ -1,4 +1,4 @@
 #!/bin/bash
 
-g++ -o seedgenerator ./seedgen.cpp
-g++ -o noiseseedgenerator ./noiseseedgen.cpp
\ No newline at end of file
+g++ -std=c++17 -o seedgenerator ./seedgen.cpp
+g++ -std=c++17 -o noiseseedgenerator ./noiseseedgen.cpp
\ No newline at end of file
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+namespace fs = std::filesystem;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+#define BUFFER_SIZE (16 << 20)
+
+
+// Shards are named <output>.shard<id>, where the id is the array index (and/or Nimrod parameters) of the task that wrote it
+const string SHARD_TAG = ".shard";
+
+// Compare shard ids with runs of digits as numbers, so shard10 comes after shard9 and the merged rows keep task order
+bool natural_less(const string &a, const string &b)
+{
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        if (std::isdigit(a[i]) && std::isdigit(b[j]))
+        {
+            size_t ei = i, ej = j;
+            while (ei < a.size() && std::isdigit(a[ei]))
+                ++ei;
+            while (ej < b.size() && std::isdigit(b[ej]))
+                ++ej;
+            unsigned long long na = std::stoull(a.substr(i, ei - i));
+            unsigned long long nb = std::stoull(b.substr(j, ej - j));
+            if (na != nb)
+                return na < nb;
+            i = ei;
+            j = ej;
+        }
+        else
+        {
+            if (a[i] != b[j])
+                return a[i] < b[j];
+            ++i;
+            ++j;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+// Shards in the directory, grouped by the output file they belong to
+std::map<string, vector<fs::path>> find_shards(const string &dir)
+{
+    std::map<string, vector<fs::path>> groups;
+    for (const fs::directory_entry &entry : fs::directory_iterator(dir))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        string name = entry.path().filename().string();
+        size_t tag = name.rfind(SHARD_TAG);
+        if (tag == string::npos || tag == 0)
+            continue;
+        groups[name.substr(0, tag)].push_back(entry.path());
+    }
+
+    for (auto &group : groups)
+        std::sort(group.second.begin(), group.second.end(), [](const fs::path &a, const fs::path &b)
+        {
+            string sa = a.filename().string(), sb = b.filename().string();
+            return natural_less(sa.substr(sa.rfind(SHARD_TAG)), sb.substr(sb.rfind(SHARD_TAG)));
+        });
+    return groups;
+}
+
+// A merge in progress is recorded next to its output as OUTPUT.merging, holding the output's size before the merge
+const string MERGING_TAG = ".merging";
+
+// Where the output has to be cut back to before merging: its size when an earlier merge of the same shards started, if
+// that merge didn't finish, so its rows aren't appended twice. Otherwise the output's size now, which is recorded
+// until the merge is done
+uintmax_t merge_start(const fs::path &outfile)
+{
+    const fs::path marker = outfile.string() + MERGING_TAG;
+    std::error_code ec;
+    if (fs::exists(marker))
+    {
+        std::unique_ptr<FILE, int(*)(FILE*)> in(std::fopen(marker.c_str(), "rb"), std::fclose);
+        unsigned long long offset;
+        if (!in || std::fscanf(in.get(), "%llu", &offset) != 1)
+            throw std::runtime_error("Can't read where the last merge into " + outfile.string() + " started from "
+                                     + marker.string());
+        return offset;
+    }
+
+    uintmax_t size = fs::exists(outfile) ? fs::file_size(outfile) : 0;
+    const fs::path part = marker.string() + ".part";
+    {
+        std::unique_ptr<FILE, int(*)(FILE*)> out(std::fopen(part.c_str(), "wb"), std::fclose);
+        if (!out || std::fprintf(out.get(), "%llu\n", (unsigned long long)size) < 0 || std::fflush(out.get()) != 0)
+            throw std::runtime_error("Can't write " + part.string());
+    }
+    fs::rename(part, marker);
+    return size;
+}
+
+// Append every shard to the output in order, through one large buffer, so the shared filesystem sees a few big
+// sequential writes from one process instead of many small appends racing each other. A merge that's cut short is
+// undone by the next one, which cuts the output back to where it started. Returns the bytes written
+size_t merge_group(const vector<fs::path> &shards, const fs::path &outfile, vector<char> &buffer)
+{
+    const uintmax_t start = merge_start(outfile);
+    const uintmax_t size = fs::exists(outfile) ? fs::file_size(outfile) : 0;
+    if (size < start)
+        throw std::runtime_error(outfile.string() + " is shorter than when the last merge into it started: remove "
+                                 + outfile.string() + MERGING_TAG + " to merge into it as it is");
+    if (size > start)
+        fs::resize_file(outfile, start);
+
+    std::unique_ptr<FILE, int(*)(FILE*)> out(std::fopen(outfile.c_str(), "ab"), std::fclose);
+    if (!out)
+        throw std::runtime_error("Can't open " + outfile.string() + " for writing");
+    std::setvbuf(out.get(), nullptr, _IONBF, 0);
+
+    size_t used = 0, written = 0;
+    auto flush = [&]()
+    {
+        if (used && std::fwrite(buffer.data(), 1, used, out.get()) != used)
+            throw std::runtime_error("Failed writing to " + outfile.string());
+        written += used;
+        used = 0;
+    };
+
+    for (const fs::path &shard : shards)
+    {
+        std::unique_ptr<FILE, int(*)(FILE*)> in(std::fopen(shard.c_str(), "rb"), std::fclose);
+        if (!in)
+            throw std::runtime_error("Can't open " + shard.string());
+        size_t n;
+        char last = '\n';
+        while ((n = std::fread(buffer.data() + used, 1, buffer.size() - used, in.get())) > 0)
+        {
+            used += n;
+            last = buffer[used - 1];
+            if (used == buffer.size())
+                flush();
+        }
+        if (std::ferror(in.get()))
+            throw std::runtime_error("Failed reading " + shard.string());
+
+        // A task killed mid-write can leave a partial last line: end it so it doesn't run into the next shard
+        if (last != '\n')
+        {
+            if (used == buffer.size())
+                flush();
+            buffer[used++] = '\n';
+        }
+    }
+    flush();
+    if (std::fflush(out.get()) != 0 || std::fclose(out.release()) != 0)
+        throw std::runtime_error("Failed writing to " + outfile.string());
+    fs::remove(outfile.string() + MERGING_TAG);
+    return written;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "Shard Merge\n"
+    "\n"
+    "This program merges the output shards written by each task of a SLiM Runner job into the final output files.\n"
+    "Every file named OUTPUT.shardID in the shard directory is appended to OUTPUT in the destination, in order of ID.\n"
+    "A merge that's cut short can be run again: OUTPUT is cut back to its size before the merge first.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i /30days/$USER/slim_job_shards -d /30days/$USER -r\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i DIRECTORY   The directory holding the shards. Defaults to ./shards.\n"
+    "\n"
+    "-d DIRECTORY   The directory to write the merged outputs to. Defaults to the current directory.\n"
+    "\n"
+    "-r             Remove each output's shards once they have all been merged.\n"
+    "\n"
+    "-T N           Number of outputs to merge at once. Defaults to all available threads.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "destination",    required_argument,  0,  'd' },
+        { "remove",         no_argument,        0,  'r' },
+        { "threads",        required_argument,  0,  'T' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string shardDir = "./shards";
+    string destDir = ".";
+    bool remove = false;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:d:rT:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                shardDir = optarg;
+                continue;
+
+            case 'd':
+                destDir = optarg;
+                continue;
+
+            case 'r':
+                remove = true;
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    std::map<string, vector<fs::path>> groups;
+    try
+    {
+        groups = find_shards(shardDir);
+        fs::create_directories(destDir);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    // Each output is merged by one thread, so they go in parallel but each file is still written sequentially
+    vector<std::pair<string, vector<fs::path>>> work(groups.begin(), groups.end());
+    bool failed = false;
+
+    #pragma omp parallel
+    {
+        vector<char> buffer(BUFFER_SIZE);
+
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t g = 0; g < work.size(); ++g)
+        {
+            const fs::path outfile = fs::path(destDir) / work[g].first;
+            try
+            {
+                size_t bytes = merge_group(work[g].second, outfile, buffer);
+                if (remove)
+                    for (const fs::path &shard : work[g].second)
+                        fs::remove(shard);
+                if (debug)
+                {
+                    #pragma omp critical
+                    cout << "Merged " << work[g].second.size() << " shards (" << bytes << " bytes) into " << outfile.string() << endl;
+                }
+            }
+            catch (const std::exception &e)
+            {
+                #pragma omp critical
+                {
+                    std::cerr << e.what() << endl;
+                    failed = true;
+                }
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,489 @@
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <getopt.h>
+#include <omp.h>
+#include "../../Parallelisation/Cpp/includes/csv.h"
+#include "../../Parallelisation/Cpp/includes/slimtraj.h"
+
+using std::endl;
+using std::cout;
+using std::string;
+using std::vector;
+
+#define no_argument 0
+#define required_argument 1
+#define optional_argument 2
+
+#define BUFFER_SIZE (4 << 20)
+
+// Columns of the model's mutation output
+#define MUTS_COLS 12
+
+
+// One row of the mutation output
+struct MutsRow
+{
+    int64_t generation, seed, modelindex, type, id, position, originGen, count, fixGen;
+    double value, chi, freq;
+};
+
+bool parse_int(std::string_view field, int64_t &value)
+{
+    auto res = std::from_chars(field.data(), field.data() + field.size(), value);
+    return res.ec == std::errc() && res.ptr == field.data() + field.size();
+}
+
+bool parse_double(std::string_view field, double &value)
+{
+    auto res = std::from_chars(field.data(), field.data() + field.size(), value);
+    return res.ec == std::errc() && res.ptr == field.data() + field.size();
+}
+
+// Split and parse a mutation output row: generation, seed, modelindex, mutType, id, position, originGen, value, chi,
+// freq, count, fixGen
+bool parse_row(const char *line, MutsRow &row)
+{
+    std::string_view fields[MUTS_COLS];
+    size_t n = 0;
+    const char *start = line;
+    for (const char *c = line; ; ++c)
+    {
+        if (*c == ',' || *c == '\0' || *c == '\r')
+        {
+            if (n == MUTS_COLS)
+                return false;
+            fields[n++] = std::string_view(start, c - start);
+            if (*c != ',')
+                break;
+            start = c + 1;
+        }
+    }
+    if (n != MUTS_COLS)
+        return false;
+    row.fixGen = slimtraj::NA;
+    return parse_int(fields[0], row.generation) && parse_int(fields[1], row.seed) && parse_int(fields[2], row.modelindex)
+        && parse_int(fields[3], row.type) && parse_int(fields[4], row.id) && parse_int(fields[5], row.position)
+        && parse_int(fields[6], row.originGen) && parse_double(fields[7], row.value) && parse_double(fields[8], row.chi)
+        && parse_double(fields[9], row.freq) && parse_int(fields[10], row.count)
+        && (fields[11] == "NA" || parse_int(fields[11], row.fixGen));
+}
+
+// Collects one run's rows, then works out its mutation table, snapshots and counts
+class RunBuilder
+{
+public:
+    void start(int64_t seed, int64_t modelindex)
+    {
+        _run.seed = seed;
+        _run.modelindex = modelindex;
+        _mutations.clear();
+        _byId.clear();
+        _snapshots.clear();
+    }
+
+    bool empty() const { return _mutations.empty(); }
+
+    void add(const MutsRow &row, size_t line)
+    {
+        auto it = _byId.emplace(row.id, _mutations.size());
+        if (it.second)
+            _mutations.push_back({row.id, row.type, row.position, row.originGen, row.value, slimtraj::NA});
+        slimtraj::Mutation &mut = _mutations[it.first->second];
+        if (row.fixGen != slimtraj::NA)
+            mut.fixGen = row.fixGen;
+
+        Snapshot &snap = _snapshots[row.generation];
+        snap.rows.push_back({it.first->second, row.count, row.freq, line});
+        if (row.freq > 0 && row.count > snap.maxCount)
+        {
+            snap.maxCount = row.count;
+            snap.genomes = std::llround(row.count / row.freq);
+        }
+        if (std::fabs(row.value) > snap.maxValue)
+        {
+            snap.maxValue = std::fabs(row.value);
+            snap.chiScale = row.chi / row.value;
+        }
+    }
+
+    // The run, with mutations in id order. Every frequency has to be a count over the genomes sampled, or the counts
+    // wouldn't give it back
+    const slimtraj::Run &finish(const string &infile)
+    {
+        vector<size_t> order(_mutations.size());
+        for (size_t m = 0; m < order.size(); ++m)
+            order[m] = m;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return _mutations[a].id < _mutations[b].id; });
+        vector<size_t> rank(order.size());
+        _run.mutations.clear();
+        for (size_t r = 0; r < order.size(); ++r)
+        {
+            rank[order[r]] = r;
+            _run.mutations.push_back(_mutations[order[r]]);
+        }
+
+        const size_t nsnaps = _snapshots.size();
+        _run.snapshots.clear();
+        _run.counts.assign(_mutations.size() * nsnaps, -1);
+        size_t s = 0;
+        for (const auto &entry : _snapshots)
+        {
+            const Snapshot &snap = entry.second;
+            _run.snapshots.push_back({entry.first, uint32_t(snap.genomes), snap.chiScale});
+            for (const SnapshotRow &row : snap.rows)
+            {
+                double freq = snap.genomes > 0 ? double(row.count) / snap.genomes : 0.0;
+                if (row.count < 0 || row.count > snap.genomes || std::fabs(freq - row.freq) > 1e-5 * std::max(row.freq, 1e-3))
+                    throw std::runtime_error(infile + ":" + std::to_string(row.line) + " has a frequency of " + std::to_string(row.freq)
+                                             + ", which isn't its count of " + std::to_string(row.count) + " over "
+                                             + std::to_string(snap.genomes) + " genomes");
+                _run.counts[rank[row.mutation] * nsnaps + s] = row.count;
+            }
+            ++s;
+        }
+        return _run;
+    }
+
+private:
+    struct SnapshotRow
+    {
+        size_t mutation;
+        int64_t count;
+        double freq;
+        size_t line;
+    };
+
+    // The genomes sampled are worked out from the commonest mutation, and the chi scale from the largest effect, where
+    // the model's rounding matters least
+    struct Snapshot
+    {
+        vector<SnapshotRow> rows;
+        int64_t maxCount = 0;
+        int64_t genomes = 0;
+        double maxValue = 0.0;
+        double chiScale = 0.0;
+    };
+
+    slimtraj::Run _run;
+    vector<slimtraj::Mutation> _mutations;
+    std::unordered_map<int64_t, size_t> _byId;
+    std::map<int64_t, Snapshot> _snapshots;
+};
+
+// Convert a mutation output into a trajectory file, a run at a time. A run's rows have to be together, as slimsort
+// leaves them
+void muts_to_traj(const string &infile, const string &outfile, bool debug)
+{
+    io::LineReader in(infile);
+    slimtraj::Writer out(outfile);
+    RunBuilder builder;
+    std::set<std::pair<int64_t, int64_t>> done;
+    std::pair<int64_t, int64_t> current = {0, 0};
+    MutsRow row;
+    size_t inBytes = 0;
+
+    for (char *line; (line = in.next_line()); )
+    {
+        if (!*line)
+            continue;   // The model can leave blank lines between its mutation outputs
+        inBytes += std::strlen(line) + 1;
+        if (!parse_row(line, row))
+            throw std::runtime_error(infile + ":" + std::to_string(in.get_file_line()) + " isn't a row of the mutation output");
+
+        std::pair<int64_t, int64_t> key = {row.modelindex, row.seed};
+        if (key != current || builder.empty())
+        {
+            if (!builder.empty())
+            {
+                out.addRun(builder.finish(infile));
+                done.insert(current);
+            }
+            if (done.count(key))
+                throw std::runtime_error(infile + ":" + std::to_string(in.get_file_line()) + " goes back to modelindex "
+                                         + std::to_string(row.modelindex) + ", seed " + std::to_string(row.seed)
+                                         + ": sort the file by run first, e.g. slimsort -k 3,2,1");
+            builder.start(row.seed, row.modelindex);
+            current = key;
+        }
+        builder.add(row, in.get_file_line());
+    }
+    if (!builder.empty())
+        out.addRun(builder.finish(infile));
+    size_t rows = out.rows();
+    out.close();
+
+    if (debug)
+    {
+        slimtraj::Reader check(outfile);
+        std::FILE *f = std::fopen(outfile.c_str(), "rb");
+        std::fseek(f, 0, SEEK_END);
+        long outBytes = std::ftell(f);
+        std::fclose(f);
+        cout << "Converted " << rows << " rows of " << check.runs() << " runs from " << infile << " to " << outfile
+             << ": " << inBytes << " bytes to " << outBytes << "\n";
+    }
+}
+
+// Write a float the way the model does: six significant figures, and whole numbers with a .0
+size_t format_float(double value, char *buf, size_t len)
+{
+    int n = std::snprintf(buf, len, "%g", value);
+    if (std::isfinite(value) && !std::strpbrk(buf, ".e"))
+    {
+        std::memcpy(buf + n, ".0", 2);
+        n += 2;
+    }
+    return n;
+}
+
+void append_int(string &out, int64_t value)
+{
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr - buf);
+}
+
+// Write a run's rows in the mutation output's columns, snapshot by snapshot
+void run_to_csv(const slimtraj::Run &run, string &out)
+{
+    char buf[64];
+    for (size_t s = 0; s < run.snapshots.size(); ++s)
+    {
+        for (size_t m = 0; m < run.mutations.size(); ++m)
+        {
+            int32_t count = run.count(m, s);
+            if (count < 0)
+                continue;
+            const slimtraj::Mutation &mut = run.mutations[m];
+            append_int(out, run.snapshots[s].generation);
+            out += ',';
+            append_int(out, run.seed);
+            out += ',';
+            append_int(out, run.modelindex);
+            out += ',';
+            append_int(out, mut.type);
+            out += ',';
+            append_int(out, mut.id);
+            out += ',';
+            append_int(out, mut.position);
+            out += ',';
+            append_int(out, mut.originGen);
+            out += ',';
+            out.append(buf, format_float(mut.value, buf, sizeof(buf)));
+            out += ',';
+            out.append(buf, format_float(run.chi(m, s), buf, sizeof(buf)));
+            out += ',';
+            out.append(buf, format_float(run.freq(m, s), buf, sizeof(buf)));
+            out += ',';
+            append_int(out, count);
+            out += ',';
+            int64_t fixGen = run.fixGen(m, s);
+            if (fixGen == slimtraj::NA)
+                out += "NA";
+            else
+                append_int(out, fixGen);
+            out += '\n';
+        }
+    }
+}
+
+// Write a trajectory file back out as a mutation output, optionally only some modelindices. Runs are decoded in
+// parallel, a batch at a time, and written in order
+void traj_to_muts(const string &infile, const string &outfile, int64_t modelLo, int64_t modelHi, bool debug)
+{
+    slimtraj::Reader in(infile);
+    vector<size_t> runs;
+    for (size_t i = 0; i < in.runs(); ++i)
+        if (in.run(i).modelindex >= modelLo && in.run(i).modelindex <= modelHi)
+            runs.push_back(i);
+
+    FILE *out = outfile.empty() ? stdout : std::fopen(outfile.c_str(), "wb");
+    if (!out)
+        throw std::runtime_error("Can't open " + outfile + " for writing");
+    std::setvbuf(out, nullptr, _IOFBF, BUFFER_SIZE);
+
+    const size_t batch = 4 * omp_get_max_threads();
+    vector<string> texts(batch);
+    vector<string> errors(batch);
+    for (size_t first = 0; first < runs.size(); first += batch)
+    {
+        size_t n = std::min(batch, runs.size() - first);
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t k = 0; k < n; ++k)
+        {
+            texts[k].clear();
+            try
+            {
+                slimtraj::Run run;
+                in.read(runs[first + k], run);
+                run_to_csv(run, texts[k]);
+            }
+            catch (const std::exception &e)
+            {
+                errors[k] = e.what();
+            }
+        }
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (!errors[k].empty())
+                throw std::runtime_error(errors[k]);
+            std::fwrite(texts[k].data(), 1, texts[k].size(), out);
+        }
+    }
+
+    bool failed = std::fflush(out) != 0;
+    if (out != stdout)
+        std::fclose(out);
+    if (failed)
+        throw std::runtime_error("Failed writing to " + (outfile.empty() ? string("the standard output") : outfile));
+    if (debug)
+        std::cerr << "Wrote " << runs.size() << " of " << in.runs() << " runs from " << infile << endl;
+}
+
+// Help function for displaying options
+void doHelp(char* appname)
+{
+    std::fprintf(stdout,
+    "SLiM Trajectories\n"
+    "\n"
+    "This program converts the model's mutation output into a compact trajectory file, and back. Each run's mutations\n"
+    "are stored once, and each sampled generation only the change in each mutation's copy count, which is about a tenth\n"
+    "of the size. A run's rows have to be together in the input: sort a file written by parallel runs with\n"
+    "slimsort -k 3,2,1 first.\n"
+    "Usage: %s [OPTION]...\n"
+    "Example: %s -i ./out_slim1T_muts.csv -d ./out_slim1T_muts.traj\n"
+    "\n"
+    "-h             Print this help manual.\n"
+    "\n"
+    "-v             Turn on verbose mode.\n"
+    "\n"
+    "-i FILEPATH    The file to convert. Defaults to ./out_slim1T_muts.csv.\n"
+    "\n"
+    "-d FILEPATH    Specify a filepath and name for the converted file. Defaults to the input with a .traj extension,\n"
+    "               or the standard output with -r.\n"
+    "\n"
+    "-r             Reverse the conversion: read a trajectory file and write a mutation output .csv.\n"
+    "               Example: -r -i ./out_slim1T_muts.traj -m 200:300\n"
+    "\n"
+    "-m LO:HI       With -r, only write runs with modelindex between LO and HI, inclusive. Either bound can be left out.\n"
+    "\n"
+    "-T N           Number of threads to use. Defaults to all available.\n"
+    "\n",
+    appname,
+    appname
+    );
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option longopts[] =
+    {
+        { "input",          required_argument,  0,  'i' },
+        { "destination",    required_argument,  0,  'd' },
+        { "reverse",        no_argument,        0,  'r' },
+        { "modelindex",     required_argument,  0,  'm' },
+        { "threads",        required_argument,  0,  'T' },
+        { "help",           no_argument,        0,  'h' },
+        { "verbose",        no_argument,        0,  'v' },
+        {0,0,0,0}
+    };
+
+    // Initialise variables with defaults if values are not supplied
+    string infile = "./out_slim1T_muts.csv";
+    string outfile;
+    string models;
+    bool reverse = false;
+    bool debug = false;
+    int optionindex = 0;
+    int options = 0;
+
+    while (options != -1)
+    {
+        options = getopt_long(argc, argv, "i:d:rm:T:hv", longopts, &optionindex);
+
+        switch (options)
+        {
+            case 'i':
+                infile = optarg;
+                continue;
+
+            case 'd':
+                outfile = optarg;
+                continue;
+
+            case 'r':
+                reverse = true;
+                continue;
+
+            case 'm':
+                models = optarg;
+                continue;
+
+            case 'T':
+                omp_set_num_threads(std::stoi(optarg));
+                continue;
+
+            case 'h':
+                doHelp(argv[0]);
+                return 0;
+
+            case 'v':
+                debug = true;
+                continue;
+
+            case -1:
+                break;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        if (reverse)
+        {
+            int64_t lo = INT64_MIN, hi = INT64_MAX;
+            if (!models.empty())
+            {
+                size_t colon = models.find(':');
+                if (colon == string::npos)
+                    throw std::invalid_argument("Can't read the modelindex range " + models + ", expected LO:HI");
+                if (colon > 0)
+                    lo = std::stoll(models.substr(0, colon));
+                if (colon + 1 < models.size())
+                    hi = std::stoll(models.substr(colon + 1));
+            }
+            traj_to_muts(infile, outfile, lo, hi, debug);
+        }
+        else
+        {
+            if (outfile.empty())
+            {
+                size_t dot = infile.rfind('.');
+                size_t slash = infile.rfind('/');
+                bool extension = dot != string::npos && (slash == string::npos || dot > slash);
+                outfile = infile.substr(0, extension ? dot : infile.size()) + ".traj";
+            }
+            muts_to_traj(infile, outfile, debug);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << endl;
+        return 1;
+    }
+
+    if (debug)
+        std::cerr << "Done in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << endl;
+    return 0;
+}